@@ -1,310 +1,7923 @@
+// POSIX.1-2008 + extensões BSD (rwlock, getline, strdup, wait4, syscall)
+// também com -std=c11, que sozinho esconde tudo isso.
+#define _DEFAULT_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define MAX_NOME 64
 #define MAX_PISTA 128
-#define HASH_SIZE 101   // tamanho simples prime para tabela hash
+#define HASH_CAPACIDADE_INICIAL 16   // potência de 2 (múltiplo de HASH_GRUPO)
+#define HASH_GRUPO 16                // bytes de controle sondados por vez
+#define PISTAS_PARA_CONDENAR 2       // pistas contra o acusado para aceitar a acusação
+
+// Hash dos textos do pool, escolhido na compilação
+// (-DHASH_TEXTOS=1 volta ao djb2). Fica gravado no .dqm.
+#define HASH_TEXTOS_DJB2 1
+#define HASH_TEXTOS_PALAVRAS 2
+#ifndef HASH_TEXTOS
+#define HASH_TEXTOS HASH_TEXTOS_PALAVRAS
+#endif
+
+// -----------------------------
+// Arena de alocação
+// Blocos crescentes de onde saem salas e nós de pistas; tudo é
+// devolvido de uma vez em arenaLiberar(), sem percorrer os nós.
+// -----------------------------
+#define ARENA_BLOCO_INICIAL (4 * 1024)
+#define ARENA_BLOCO_MAXIMO (16 * 1024 * 1024)
+
+typedef struct BlocoArena {
+    struct BlocoArena *anterior;
+    size_t tamanho;
+    size_t usado;
+    max_align_t dados[];
+} BlocoArena;
+
+typedef struct Arena {
+    BlocoArena *atual;
+    size_t blocos;         // quantidade de malloc feitos pela arena
+    size_t bytes;          // bytes entregues aos chamadores
+} Arena;
+
+// -----------------------------
+// Índice de endereçamento aberto (estilo SwissTable)
+// ctrl[i] = CTRL_VAZIO ou os 7 bits altos do hash da entrada no
+// slot i; a sondagem compara HASH_GRUPO bytes de controle de uma
+// vez (SSE2 quando disponível) antes de tocar nas entradas.
+// Os slots guardam só um índice de 32 bits para um vetor denso,
+// então crescer o índice não move os dados.
+// -----------------------------
+typedef struct IndiceAberto {
+    int8_t *ctrl;          // capacidade + HASH_GRUPO bytes (cauda espelhada)
+    uint32_t *slots;
+    size_t capacidade;     // número de slots, potência de 2
+} IndiceAberto;
+
+// -----------------------------
+// Pool de textos internados
+// Cada texto distinto (nome de sala, pista, suspeito) é guardado
+// uma única vez e identificado por um id de 32 bits; estruturas
+// guardam só o id e comparam igualdade como inteiros. O id 0
+// (TEXTO_NENHUM) representa "sem texto".
+// Ao abrir uma mansão binária o pool vazio adota a tabela de
+// textos do arquivo (deslocamentos, hashes e índice) sem copiar
+// nada; só ao internar um texto novo ele passa a ter cópias próprias.
+// -----------------------------
+typedef uint32_t IdTexto;
+#define TEXTO_NENHUM 0u
+
+typedef struct PoolTextos {
+    Arena bytes;           // os textos em si (não mudam de endereço)
+    const char **textos;   // id -> texto
+    uint64_t *hashes;      // id -> hash do texto (usado ao crescer o índice)
+    uint32_t quantidade;   // ids em uso, incluindo o 0
+    uint32_t capIds;
+    IndiceAberto indice;   // texto -> id
+    const char *base;                 // textos do arquivo mapeado (ou NULL)
+    const uint32_t *deslocamentos;    // id -> deslocamento em 'base'
+    int emprestado;        // textos/hashes/indice apontam para o arquivo
+} PoolTextos;
 
 // -----------------------------
 // Estrutura da sala (árvore)
 // -----------------------------
 typedef struct Sala {
-    char nome[MAX_NOME];
-    char pista[MAX_PISTA];   // pista associada (pode ser string vazia)
+    IdTexto nome;
+    IdTexto pista;           // pista associada (TEXTO_NENHUM se não houver)
     struct Sala *esq;
     struct Sala *dir;
 } Sala;
 
 // -----------------------------
-// Nó da BST de pistas
+// Mapa da mansão achatado (estrutura de vetores)
+// A sala i é a posição i de cada vetor. Os filhos são posições
+// (SALA_NENHUMA se não houver) e ficam sozinhos em 'filhos', 8
+// bytes por sala: navegar e percorrer o mapa só lê esse vetor
+// quente. Pistas e nomes ficam em vetores à parte e só são lidos
+// ao coletar e ao exibir. As salas vêm em pré-ordem, então o
+// filho esquerdo costuma ser a posição seguinte.
+// Mesmo formato em memória e no arquivo binário. As sessões
+// navegam por aqui; Sala (com ponteiros) serve para montar mapas
+// no código e é convertida por compilarMapa().
+// -----------------------------
+#define SALA_NENHUMA UINT32_MAX
+
+typedef struct FilhosSala {
+    uint32_t esq;
+    uint32_t dir;
+} FilhosSala;
+
+typedef struct Mapa {
+    const FilhosSala *filhos;  // quente: navegação
+    const IdTexto *pistas;     // lido ao entrar na sala
+    const IdTexto *nomes;      // frio: só exibição
+    uint32_t nSalas;           // sempre >= 1
+    uint32_t raiz;             // sala inicial
+    void *memoria;             // bloco próprio de compilarMapa() (NULL se mapeado)
+} Mapa;
+
+// -----------------------------
+// Nó da BST de pistas (AVL)
+// altura mantém a árvore balanceada mesmo quando as pistas
+// chegam em ordem alfabética; tamanho (nós da subárvore) permite
+// achar a k-ésima pista e a posição de um texto em O(log n).
+// Com NOS_COMPACTOS (padrão) os nós ficam num vetor da árvore e
+// os filhos são posições de 32 bits nele; altura e tamanho
+// dividem 32 bits, então o nó tem 16 bytes em vez de 32 e uma
+// árvore cabe em até 2^26 - 1 pistas. A posição 0 é uma
+// sentinela com altura e tamanho 0 (filho ausente), o que
+// dispensa o teste de nulo ao rebalancear. -DNOS_COMPACTOS=0
+// volta aos nós com ponteiros alocados numa arena.
 // -----------------------------
+#ifndef NOS_COMPACTOS
+#define NOS_COMPACTOS 1
+#endif
+
+#if NOS_COMPACTOS
+typedef uint32_t RefPista;         // posição em ArvorePistas.nos
+#define PISTA_NULA 0u
+#define PISTAS_MAXIMAS ((1u << 26) - 1)
+
 typedef struct PistaNode {
-    char pista[MAX_PISTA];
+    IdTexto pista;
+    uint32_t tamanho : 26;
+    uint32_t altura : 6;       // AVL com 2^26 nós: altura < 40
+    RefPista esq;
+    RefPista dir;
+} PistaNode;
+
+typedef struct ArvorePistas {
+    PistaNode *nos;            // nos[0]: sentinela
+    uint32_t quantidade;       // incluindo a sentinela
+    uint32_t capacidade;
+    RefPista raiz;
+} ArvorePistas;
+
+#define NO_PISTA(arv, r) (&(arv)->nos[r])
+#else
+typedef struct PistaNode *RefPista;
+#define PISTA_NULA NULL
+
+typedef struct PistaNode {
+    IdTexto pista;
+    int altura;
+    uint32_t tamanho;
     struct PistaNode *esq;
     struct PistaNode *dir;
 } PistaNode;
 
+typedef struct ArvorePistas {
+    Arena nos;
+    RefPista raiz;
+} ArvorePistas;
+
+#define NO_PISTA(arv, r) ((void)(arv), (r))
+#endif
+
+// -----------------------------
+// Cursor em ordem sobre a BST de pistas
+// Pilha dos nós ainda por visitar (o topo é a próxima pista).
+// Pode ser guardado entre pedidos para continuar a paginação;
+// vale enquanto a árvore não mudar. A altura de uma AVL com
+// 2^32 nós fica abaixo de 64.
+// -----------------------------
+#define ALTURA_MAXIMA_PISTAS 64
+
+typedef struct CursorPistas {
+    const ArvorePistas *arvore;
+    RefPista pilha[ALTURA_MAXIMA_PISTAS];
+    int topo;
+} CursorPistas;
+
 // -----------------------------
-// Nó para tabela hash (separate chaining)
-// chave = pista, valor = suspeito
+// Quadro de evidências compartilhado (investigação cooperativa)
+// Conjunto ordenado de pistas em que vários detetives (threads)
+// incluem ao mesmo tempo enquanto outros leem: lista com saltos
+// (skip list) sem trava, só de inclusão. Um nó entra primeiro no
+// nível 0 com um CAS (a partir daí faz parte do conjunto) e depois
+// nos níveis de cima, que só aceleram a busca. Como nada é
+// removido, leitores percorrem o nível 0 sem trava nem cópia e
+// cada pista que encontram fica lá até o quadro ser destruído.
+// Os nós saem da arena de quem incluiu (DetetiveQuadro), então as
+// arenas dos detetives só podem ser liberadas junto com o quadro.
 // -----------------------------
+#define NIVEIS_QUADRO 16       // fator 1/4 por nível: ~4^16 pistas
+
+typedef struct NoQuadro {
+    IdTexto pista;
+    uint32_t niveis;
+    _Atomic(struct NoQuadro*) proximo[];   // um por nível
+} NoQuadro;
+
+typedef struct QuadroPistas {
+    NoQuadro *cabeca;          // sentinela com NIVEIS_QUADRO níveis
+    _Atomic uint64_t quantidade;
+} QuadroPistas;
+
+typedef struct DetetiveQuadro {
+    Arena arena;               // nós incluídos por este detetive
+    NoQuadro *sobra;           // nó que perdeu a corrida para uma pista igual
+    uint64_t aleatorio;        // sorteio da altura dos nós
+} DetetiveQuadro;
+
+// -----------------------------
+// Entrada da tabela hash
+// chave = pista (id do pool), valor = posição do suspeito
+// no vetor de suspeitos da tabela. Uma pista que aponta para
+// mais de um suspeito tem o bit SUSPEITOS_VARIOS ligado e o
+// resto é o início da sua lista em 'grupos' (quantos, seguido
+// das posições).
+// -----------------------------
+#define SUSPEITOS_VARIOS 0x80000000u
+
 typedef struct HashNode {
-    char pista[MAX_PISTA];
-    char suspeito[MAX_NOME];
-    struct HashNode *prox;
+    IdTexto pista;
+    uint32_t suspeito;
 } HashNode;
 
+// -----------------------------
+// Pistas de cada suspeito (índice invertido no estilo Roaring)
+// Os ids de pista são repartidos pelos 16 bits altos em blocos;
+// um bloco guarda os 16 bits baixos num vetor ordenado ou, com
+// mais de BLOCO_VETOR_MAXIMO ids, num mapa de 65536 bits (8 KiB,
+// o tamanho de 4096 ids no vetor). Os blocos de todos os
+// suspeitos ficam num só vetor, em ordem de suspeito, e os dados
+// num só vetor de uint16: o índice vai inteiro para o .dqm e
+// pontuar todos os suspeitos contra as pistas de uma sessão é uma
+// passada por 'blocos' (E e contagem de bits nos mapas).
+// Montado por congelarHash() com as associações daquele momento.
+// -----------------------------
+#define BLOCO_VETOR_MAXIMO 4096
+#define PALAVRAS_POR_BLOCO 1024    // 65536 bits
+
+typedef struct BlocoPistas {
+    uint16_t alto;         // 16 bits altos dos ids do bloco
+    uint16_t denso;        // 1: mapa de bits; 0: vetor ordenado
+    uint32_t n;            // ids no bloco
+    uint64_t inicio;       // posição em 'dados' (mapas alinhados a 8 bytes)
+} BlocoPistas;
+
+typedef struct IndiceInverso {
+    uint32_t nSuspeitos;       // suspeitos cobertos (os cadastrados ao congelar)
+    uint32_t nBlocos;
+    uint64_t tamDados;         // em uint16
+    uint32_t *primeiroBloco;   // suspeito k: blocos[primeiroBloco[k] .. primeiroBloco[k + 1])
+    BlocoPistas *blocos;
+    uint16_t *dados;
+} IndiceInverso;
+
+// -----------------------------
+// Filtro de Bloom em blocos na frente da tabela pista -> suspeitos.
+// Cada bloco tem 512 bits (uma linha de cache, 8 palavras); a pista
+// escolhe um bloco e marca um bit em cada palavra. Uma pista que não
+// está na tabela (texto de sala, pista falsa) é quase sempre
+// descartada lendo só essa linha, sem tocar pilotos, entradas e o
+// índice aberto. Só compensa quando a tabela não cabe na cache
+// (ver FILTRO_MINIMO_BYTES). Não remove: a tabela também não.
+// -----------------------------
+typedef struct FiltroPistas {
+    uint64_t *blocos;      // nBlocos * PALAVRAS_FILTRO, alinhado a 64 bytes
+    uint32_t nBlocos;      // 0: sem filtro (nada congelado ou tabela pequena)
+    uint32_t pistas;       // pistas marcadas
+} FiltroPistas;
+
+// -----------------------------
+// Tabela hash pista -> suspeitos sobre um IndiceAberto.
+// As entradas ficam densas em 'entradas'. Cada suspeito distinto
+// recebe uma posição densa (0, 1, 2, ...) em 'suspeitos', usada
+// pelos placares das sessões.
+// As associações do caso, conhecidas antes do jogo, são congeladas
+// num hash perfeito mínimo (congelarHash()): entradas[0..nFixas)
+// ficam cada uma na posição calculada a partir da pista e do
+// deslocamento do seu balde, então a busca é uma leitura em
+// 'pilotos' e uma em 'entradas', sem colisões. O índice aberto
+// fica só com as associações incluídas depois, durante o jogo.
+// No sentido contrário, 'inverso' tem as pistas de cada suspeito
+// no congelamento e 'posteriores' os pares incluídos desde então.
+// 'filtro' cobre todas as pistas, fixas e posteriores.
+// -----------------------------
+typedef struct TabelaHash {
+    IndiceAberto indice;   // entradas[nFixas..quantidade)
+    HashNode *entradas;
+    size_t quantidade;
+    size_t capEntradas;
+    uint32_t *pilotos;     // balde -> deslocamento do hash perfeito
+    uint32_t nBaldes;
+    uint32_t nFixas;       // entradas na parte perfeita
+    uint64_t semente;
+    IndiceAberto indiceSuspeitos;  // id do suspeito -> posição
+    IdTexto *suspeitos;
+    uint32_t nSuspeitos;
+    uint32_t capSuspeitos;
+    uint32_t *grupos;      // listas de suspeitos (ver SUSPEITOS_VARIOS)
+    uint32_t tamGrupos, capGrupos;
+    IndiceInverso inverso;         // suspeito -> pistas, congelado
+    HashNode *posteriores;         // pares pista -> suspeito fora de 'inverso'
+    uint32_t nPosteriores, capPosteriores;
+    FiltroPistas filtro;
+    int emprestada;        // vetores dentro de um arquivo mapeado (copiados ao alterar)
+} TabelaHash;
+
+// -----------------------------
+// Mansão pronta para jogar: mapa e tabela hash, montados a partir
+// do código (mansão embutida) ou mapeados de um arquivo binário.
+// -----------------------------
+typedef struct Mansao {
+    Mapa mapa;
+    TabelaHash tabela;
+    void *arquivo;                 // mapeamento do arquivo (NULL se embutida)
+    size_t tamArquivo;
+} Mansao;
+
+// -----------------------------
+// Parâmetros do gerador procedural de mansões (--gerar)
+// -----------------------------
+typedef enum { FORMA_EQUILIBRADA, FORMA_TORTA, FORMA_ALEATORIA } FormaMansao;
+
+typedef struct ConfigGerador {
+    uint32_t salas;
+    FormaMansao forma;
+    double inclinacao;           // torta: fração da subárvore que fica à esquerda
+    double densidade;            // fração das salas com pista
+    uint32_t pistas;             // textos de pista distintos
+    uint32_t suspeitos;
+    uint32_t suspeitosPorPista;  // cada pista aponta para 1..este tanto
+    int compMin, compMax;        // comprimento das pistas (uniforme)
+    uint64_t semente;
+    int threads;
+} ConfigGerador;
+
+typedef struct EstatisticasHash {
+    size_t quantidade;
+    size_t fixas;          // no hash perfeito (fora do índice aberto)
+    size_t capacidade;
+    double fatorCarga;
+    double sondagemMedia;  // grupos visitados por chave armazenada
+    size_t sondagemMaxima;
+    double sondagemMediaFalha;   // grupos até concluir uma busca sem sucesso
+    size_t bitsFiltro;           // 0: sem filtro
+    double bitsPorPista;
+    double falsoPositivoFiltro;  // estimado pelos bits marcados de cada bloco
+} EstatisticasHash;
+
+// -----------------------------
+// Placar de suspeitos
+// Contagem de pistas por suspeito mantida a cada coleta. 'ordem'
+// lista os suspeitos por contagem decrescente e primeiro[c] é o
+// número de suspeitos com contagem > c, ou seja, onde começa o
+// bloco dos que têm exatamente c. Incrementar é trocar o suspeito
+// com o primeiro do seu bloco e avançar primeiro[c]: O(1), e o
+// líder é sempre ordem[0].
+// -----------------------------
+typedef struct Placar {
+    uint32_t n;            // suspeitos
+    uint32_t *contagem;    // suspeito -> pistas coletadas contra ele
+    uint32_t *ordem;       // suspeitos por contagem decrescente
+    uint32_t *posicao;     // suspeito -> posição em 'ordem'
+    uint32_t *primeiro;    // contagem c -> suspeitos com contagem > c
+    uint32_t capPrimeiro;
+    uint32_t maximo;       // maior contagem
+} Placar;
+
+// -----------------------------
+// Índice textual das pistas de uma sessão
+// Para cada trigrama (3 bytes seguidos do texto normalizado: sem
+// maiúsculas nem acentos) guarda a lista das pistas que o contêm,
+// em ordem de coleta. Uma busca intersecta as listas dos trigramas
+// da consulta, começando pela menor, e confere só os candidatos.
+// O texto normalizado é indexado com dois marcadores no início,
+// então os trigramas "^^a" e "^ab" respondem buscas por prefixo.
+// Uma lista começa como vetor de posições e, quando passa a ter
+// pelo menos 1 pista a cada 32, vira um mapa de bits (que então
+// não ocupa mais que o vetor): trigramas comuns são testados em
+// O(1) e uma consulta só com trigramas comuns vira um E palavra a
+// palavra entre os mapas.
+// -----------------------------
+#define MARCADOR_INICIO '\x01'
+
+typedef struct ListaTrigrama {
+    uint32_t trigrama;     // 3 bytes em 24 bits
+    uint32_t n;            // pistas na lista
+    uint32_t cap;          // capacidade de 'itens' (itens) ou de 'bits' (palavras)
+    uint32_t *itens;       // posições locais crescentes (lista esparsa), ou NULL
+    uint64_t *bits;        // um bit por posição local (lista densa), ou NULL
+} ListaTrigrama;
+
+typedef struct IndiceTexto {
+    IndiceAberto indice;           // trigrama -> posição em 'listas'
+    ListaTrigrama *listas;
+    uint32_t nListas, capListas;
+    IdTexto *pistas;               // posição local -> pista
+    const char **normalizados;     // posição local -> texto normalizado
+    uint32_t n, cap;
+    Arena textos;
+} IndiceTexto;
+
+// -----------------------------
+// Sessão de um jogador
+// Posição atual, pistas coletadas e placar; o mapa e a tabela
+// hash ficam fora e podem ser compartilhados. 'coletadas' tem um
+// bit por id de pista: revisitar uma sala não insere a pista de
+// novo, então a BST e o placar crescem com as pistas distintas e
+// não com o número de movimentos.
+// -----------------------------
+typedef struct Sessao {
+    const Mapa *mapa;
+    uint32_t atual;          // posição da sala no mapa
+    ArvorePistas pistas;     // BST das pistas coletadas
+    size_t pistasColetadas;  // pistas distintas
+    uint64_t *coletadas;     // bitset por IdTexto
+    uint32_t capColetadas;   // em bits
+    const TabelaHash *tabela;
+    Placar placar;
+    Arena arena;           // bitset e placar desta sessão
+    IndiceTexto *busca;    // criado na primeira busca textual (ou NULL)
+} Sessao;
+
+// Resultado de um movimento
+#define MOVIMENTO_OK 0
+#define MOVIMENTO_INVALIDO 1
+#define MOVIMENTO_SAIR 2
+
 // -----------------------------
 // Protótipos
 // -----------------------------
-Sala* criarSala(const char *nome, const char *pista);
-void explorarSalas(Sala *inicio, PistaNode **raizPistas, HashNode *tabela[]);
-PistaNode* inserirPista(PistaNode *raiz, const char *pista);
-void exibirPistas(PistaNode *raiz);
-void liberarPistas(PistaNode *raiz);
-unsigned long hash_djb2(const char *str);
-void inserirNaHash(HashNode *tabela[], const char *pista, const char *suspeito);
-const char* encontrarSuspeito(HashNode *tabela[], const char *pista);
-int verificarSuspeitoFinal(PistaNode *raizPistas, HashNode *tabela[], const char *acusado);
-void liberarHash(HashNode *tabela[]);
-void liberarMapa(Sala *raiz);
+void inicializarArena(Arena *arena);
+void* arenaAlocar(Arena *arena, size_t tamanho);
+void* arenaAlocarAlinhado(Arena *arena, size_t tamanho, size_t alinhamento);
+void arenaReiniciar(Arena *arena);
+void arenaLiberar(Arena *arena);
+IdTexto internar(const char *texto);
+IdTexto buscarTexto(const char *texto);
+const char* textoDe(IdTexto id);
+void liberarPool(void);
+Sala* criarSala(Arena *arena, const char *nome, const char *pista);
+void compilarMapa(Sala *raiz, Mapa *mapa);
+void iniciarSessao(Sessao *sessao, const Mapa *mapa, const TabelaHash *tabela);
+void reiniciarSessao(Sessao *sessao);
+IdTexto coletarPistaDaSala(Sessao *sessao);
+int restaurarSessao(Sessao *sessao, uint32_t sala, const IdTexto *pistas, size_t n);
+int pistaJaColetada(const Sessao *sessao, IdTexto pista);
+uint32_t pistasContra(const Sessao *sessao, IdTexto acusado);
+long suspeitoMaisCitado(const Sessao *sessao);
+int moverSessao(Sessao *sessao, char opc);
+void encerrarSessao(Sessao *sessao);
+size_t normalizarTexto(const char *texto, char *saida);
+void iniciarIndiceTexto(IndiceTexto *ind);
+void indexarPista(IndiceTexto *ind, IdTexto pista);
+size_t buscarTrecho(const IndiceTexto *ind, const char *trecho, IdTexto *saida, size_t max);
+size_t buscarPrefixo(const IndiceTexto *ind, const char *prefixo, IdTexto *saida, size_t max);
+void liberarIndiceTexto(IndiceTexto *ind);
+size_t buscarNasPistas(Sessao *sessao, const char *trecho, IdTexto *saida, size_t max);
+size_t buscarPistasPorPrefixo(Sessao *sessao, const char *prefixo, IdTexto *saida, size_t max);
+void explorarSalas(Sessao *sessao);
+void iniciarArvorePistas(ArvorePistas *arv);
+void esvaziarArvorePistas(ArvorePistas *arv);
+void liberarArvorePistas(ArvorePistas *arv);
+void inserirPista(ArvorePistas *arv, IdTexto pista);
+int alturaPistas(const ArvorePistas *arv);
+void exibirPistas(const ArvorePistas *arv);
+size_t tamanhoPistas(const ArvorePistas *arv);
+IdTexto pistaNaPosicao(const ArvorePistas *arv, size_t k);
+size_t posicaoDaPista(const ArvorePistas *arv, const char *texto);
+size_t contarPistasComPrefixo(const ArvorePistas *arv, const char *prefixo);
+void cursorNaPosicao(CursorPistas *cursor, const ArvorePistas *arv, size_t k);
+void cursorNoTexto(CursorPistas *cursor, const ArvorePistas *arv, const char *texto);
+IdTexto proximaPista(CursorPistas *cursor);
+size_t percorrerPistas(const ArvorePistas *arv, const char *desde,
+                       int (*visitar)(IdTexto pista, void *contexto), void *contexto);
+void iniciarQuadro(QuadroPistas *q);
+void liberarQuadro(QuadroPistas *q);
+void iniciarDetetive(DetetiveQuadro *d, uint64_t semente);
+void liberarDetetive(DetetiveQuadro *d);
+int incluirNoQuadro(QuadroPistas *q, DetetiveQuadro *d, IdTexto pista);
+int quadroTemPista(const QuadroPistas *q, IdTexto pista);
+uint64_t tamanhoQuadro(const QuadroPistas *q);
+size_t percorrerQuadro(const QuadroPistas *q, int (*visitar)(IdTexto pista, void *contexto),
+                       void *contexto);
+void pontuarQuadro(const QuadroPistas *q, const TabelaHash *tabela, uint32_t *contagens);
+uint64_t hash_djb2(const char *str);
+uint64_t hash_palavras(const char *texto, size_t tamanho);
+void inicializarHash(TabelaHash *tabela);
+void inserirNaHash(TabelaHash *tabela, const char *pista, const char *suspeito);
+void inserirNaHashId(TabelaHash *tabela, IdTexto pista, IdTexto suspeito);
+void congelarHash(TabelaHash *tabela);
+const char* encontrarSuspeito(const TabelaHash *tabela, const char *pista);
+IdTexto encontrarSuspeitoId(const TabelaHash *tabela, IdTexto pista);
+long indiceDoSuspeito(const TabelaHash *tabela, IdTexto suspeito);
+long suspeitoDaPista(const TabelaHash *tabela, IdTexto pista);
+void estatisticasHash(const TabelaHash *tabela, EstatisticasHash *est);
+uint32_t suspeitosDaPista(const TabelaHash *tabela, IdTexto pista, const uint32_t **lista);
+void pontuarSuspeitos(const TabelaHash *tabela, const uint64_t *bits, uint32_t nBits,
+                      uint32_t *contagens);
+uint32_t contarPistasDoSuspeito(const TabelaHash *tabela, uint32_t k, const uint64_t *bits,
+                                uint32_t nBits);
+size_t listarPistasDoSuspeito(const TabelaHash *tabela, uint32_t k, const uint64_t *filtro,
+                              uint32_t nBits, IdTexto *saida, size_t max);
+int verificarSuspeitoFinal(const Sessao *sessao, IdTexto acusado);
+size_t pistasColetadasContra(const Sessao *sessao, IdTexto suspeito, IdTexto *saida, size_t max);
+void liberarHash(TabelaHash *tabela);
+Sala* montarMansao(Arena *arenaMapa, TabelaHash *tabela);
+void abrirMansao(Mansao *mansao, const char *arquivo);
+void fecharMansao(Mansao *mansao);
+int salvarMansao(const char *arquivo, const Mapa *mapa, const TabelaHash *tabela);
+uint32_t gerarMansao(const ConfigGerador *cfg, Mansao *mansao, uint64_t *comPista);
+int converterMansao(const char *entrada, const char *saida);
+int executarScript(int argc, char *argv[]);
+int executarServidor(int argc, char *argv[]);
+int executarCarga(int argc, char *argv[]);
+int executarRotas(int argc, char *argv[]);
+int executarGrafo(int argc, char *argv[]);
+int executarBench(int argc, char *argv[]);
+int executarGerador(int argc, char *argv[]);
+
+// Chamadas a malloc/realloc feitas pelas estruturas do jogo (arena,
+// pool, índices e tabela) nesta thread; os benchmarks leem a
+// diferença antes/depois de cada kernel.
+static _Thread_local size_t alocacoesHeap = 0;
+
+// Relógio monotônico em segundos (medições de vazão e benchmarks).
+static double agoraSeg(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
 
 // -----------------------------
-// criarSala()
-// Cria dinamicamente uma sala com nome e pista.
-// Retorna ponteiro para Sala alocada.
+// Métricas de execução (--metricas <arquivo>)
+// Cada thread soma as suas próprias contagens e histogramas de
+// latência (baldes em potências de 2 de nanossegundos), sem trava;
+// só quem escreve é a dona, e o exportador lê os valores com
+// atomics relaxados. Uma thread de fundo grava, a cada intervalo e
+// na saída do programa, a soma de todas as threads no arquivo, em
+// JSON se o nome terminar em ".json" e no formato de texto do
+// Prometheus nos outros casos.
+//
+// Sem --metricas, cada ponto de medida custa um desvio previsível.
+// -DMETRICAS=0 tira a instrumentação na compilação.
 // -----------------------------
-Sala* criarSala(const char *nome, const char *pista) {
-    Sala *s = (Sala*) malloc(sizeof(Sala));
-    if (!s) {
-        fprintf(stderr, "Erro: malloc criarSala\n");
-        exit(1);
+#ifndef METRICAS
+#define METRICAS 1
+#endif
+
+enum {
+    MET_INSERIR,       // pista na BST da sessão
+    MET_BUSCAR,        // pista -> suspeitos na tabela
+    MET_PERCORRER,     // percurso em ordem das pistas (listagem, páginas)
+    MET_MOVER,         // tratar um movimento (servidor e jogo interativo)
+    MET_ENTRADA,       // jogo interativo: esperando o teclado
+    MET_SAIDA,         // servidor: gravar respostas e diário; jogo: desenhar a tela
+    N_OPERACOES_METRICAS
+};
+
+enum {
+    CONT_BUSCAS_TABELA,      // buscas pista -> suspeitos (todas)
+    CONT_SONDAGENS,          // grupos de controle lidos no índice aberto
+    CONT_SONDAGENS_FIXAS,    // leituras no hash perfeito (uma por busca que chega lá)
+    CONT_REJEITADAS_FILTRO,  // buscas descartadas pelo filtro de Bloom
+    CONT_FALSOS_POSITIVOS,   // passaram pelo filtro e não acharam a pista
+    CONT_ALOCACOES_MOVIMENTO,
+    CONT_PISTAS_PERCORRIDAS,
+    N_CONTADORES_METRICAS
+};
+
+#define BALDES_LATENCIA 40    // balde b: até 2^b ns (o último acumula o resto)
+
+typedef struct MetricasThread {
+    _Atomic uint64_t quantidade[N_OPERACOES_METRICAS];
+    _Atomic uint64_t somaNs[N_OPERACOES_METRICAS];
+    _Atomic uint64_t baldes[N_OPERACOES_METRICAS][BALDES_LATENCIA];
+    _Atomic uint64_t contadores[N_CONTADORES_METRICAS];
+    _Atomic uint64_t alturaMaxima;     // maior altura de BST de pistas vista
+    struct MetricasThread *proxima;
+} MetricasThread;
+
+#if METRICAS
+static int metricasLigadas = 0;
+static MetricasThread *todasMetricas = NULL;    // lista de todas as threads
+static pthread_mutex_t travaMetricas = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local MetricasThread *minhasMetricas = NULL;
+static double nsPorMarca = 1.0;
+
+// Marca de tempo barata: contador de ciclos no x86-64 (convertido
+// com nsPorMarca, calibrado na partida), relógio monotônico fora dele.
+static inline uint64_t marcaTempo(void) {
+#if defined(__x86_64__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static MetricasThread* metricasDaThread(void) {
+    if (!minhasMetricas) {
+        MetricasThread *m = (MetricasThread*) calloc(1, sizeof(MetricasThread));
+        if (!m) { fprintf(stderr, "Erro: malloc metricas\n"); exit(1); }
+        pthread_mutex_lock(&travaMetricas);
+        m->proxima = todasMetricas;
+        todasMetricas = m;
+        pthread_mutex_unlock(&travaMetricas);
+        minhasMetricas = m;
     }
-    strncpy(s->nome, nome, MAX_NOME-1); s->nome[MAX_NOME-1] = '\0';
-    if (pista && strlen(pista) > 0) {
-        strncpy(s->pista, pista, MAX_PISTA-1);
-        s->pista[MAX_PISTA-1] = '\0';
-    } else {
-        s->pista[0] = '\0';
+    return minhasMetricas;
+}
+
+// Só a thread dona escreve: load + store relaxados bastam (sem lock).
+static inline void somarRelaxado(_Atomic uint64_t *c, uint64_t v) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + v,
+                          memory_order_relaxed);
+}
+
+static void registrarLatenciaMetrica(int op, uint64_t marcas) {
+    MetricasThread *m = metricasDaThread();
+    uint64_t ns = (uint64_t)(marcas * nsPorMarca);
+    int b = ns ? 64 - __builtin_clzll(ns) : 0;
+    if (b >= BALDES_LATENCIA) b = BALDES_LATENCIA - 1;
+    somarRelaxado(&m->quantidade[op], 1);
+    somarRelaxado(&m->somaNs[op], ns);
+    somarRelaxado(&m->baldes[op][b], 1);
+}
+
+static void contarMetricaLigada(int contador, uint64_t v) {
+    somarRelaxado(&metricasDaThread()->contadores[contador], v);
+}
+
+static void alturaMetricaLigada(uint64_t altura) {
+    MetricasThread *m = metricasDaThread();
+    if (altura > atomic_load_explicit(&m->alturaMaxima, memory_order_relaxed))
+        atomic_store_explicit(&m->alturaMaxima, altura, memory_order_relaxed);
+}
+
+#define MEDIR_INICIO(t) uint64_t t = metricasLigadas ? marcaTempo() : 0
+#define ALOCACOES_INICIO(a) size_t a = alocacoesHeap
+#define MEDIR_FIM(op, t) do { if (metricasLigadas) registrarLatenciaMetrica((op), marcaTempo() - (t)); } while (0)
+#define CONTAR_METRICA(c, v) do { if (metricasLigadas) contarMetricaLigada((c), (v)); } while (0)
+#define ALTURA_METRICA(a) do { if (metricasLigadas) alturaMetricaLigada((uint64_t)(a)); } while (0)
+#else
+#define MEDIR_INICIO(t) do { } while (0)
+#define ALOCACOES_INICIO(a) do { } while (0)
+#define MEDIR_FIM(op, t) do { } while (0)
+#define CONTAR_METRICA(c, v) do { } while (0)
+#define ALTURA_METRICA(a) do { } while (0)
+#endif
+
+#if METRICAS
+static const char *nomesOperacoes[N_OPERACOES_METRICAS] = {
+    "inserir", "buscar", "percorrer", "mover", "entrada", "saida"
+};
+static const char *nomesContadores[N_CONTADORES_METRICAS] = {
+    "buscas_tabela", "sondagens", "sondagens_fixas", "rejeitadas_filtro",
+    "falsos_positivos_filtro", "alocacoes_movimento", "pistas_percorridas"
+};
+
+static const char *arquivoMetricas = NULL;
+static double intervaloMetricas = 10.0;
+static pthread_t threadMetricas;
+static pthread_cond_t sinalMetricas = PTHREAD_COND_INITIALIZER;
+static int pararExportador = 0;
+
+typedef struct SomaMetricas {
+    uint64_t quantidade[N_OPERACOES_METRICAS];
+    uint64_t somaNs[N_OPERACOES_METRICAS];
+    uint64_t baldes[N_OPERACOES_METRICAS][BALDES_LATENCIA];
+    uint64_t contadores[N_CONTADORES_METRICAS];
+    uint64_t alturaMaxima;
+    int threads;
+} SomaMetricas;
+
+static void somarMetricas(SomaMetricas *s) {
+    memset(s, 0, sizeof(*s));
+    pthread_mutex_lock(&travaMetricas);
+    for (MetricasThread *m = todasMetricas; m; m = m->proxima) {
+        s->threads++;
+        for (int op = 0; op < N_OPERACOES_METRICAS; ++op) {
+            s->quantidade[op] += atomic_load_explicit(&m->quantidade[op], memory_order_relaxed);
+            s->somaNs[op] += atomic_load_explicit(&m->somaNs[op], memory_order_relaxed);
+            for (int b = 0; b < BALDES_LATENCIA; ++b)
+                s->baldes[op][b] += atomic_load_explicit(&m->baldes[op][b], memory_order_relaxed);
+        }
+        for (int c = 0; c < N_CONTADORES_METRICAS; ++c)
+            s->contadores[c] += atomic_load_explicit(&m->contadores[c], memory_order_relaxed);
+        uint64_t a = atomic_load_explicit(&m->alturaMaxima, memory_order_relaxed);
+        if (a > s->alturaMaxima) s->alturaMaxima = a;
+    }
+    pthread_mutex_unlock(&travaMetricas);
+}
+
+static void escreverPrometheus(FILE *f, const SomaMetricas *s) {
+    fprintf(f, "# HELP dq_operacao_segundos Latencia das operacoes do motor.\n"
+               "# TYPE dq_operacao_segundos histogram\n");
+    for (int op = 0; op < N_OPERACOES_METRICAS; ++op) {
+        uint64_t acumulado = 0;
+        for (int b = 0; b < BALDES_LATENCIA - 1; ++b) {
+            acumulado += s->baldes[op][b];
+            fprintf(f, "dq_operacao_segundos_bucket{op=\"%s\",le=\"%.9g\"} %llu\n", nomesOperacoes[op],
+                    (double)((uint64_t)1 << b) * 1e-9, (unsigned long long)acumulado);
+        }
+        fprintf(f, "dq_operacao_segundos_bucket{op=\"%s\",le=\"+Inf\"} %llu\n", nomesOperacoes[op],
+                (unsigned long long)s->quantidade[op]);
+        fprintf(f, "dq_operacao_segundos_sum{op=\"%s\"} %.9f\n", nomesOperacoes[op], s->somaNs[op] * 1e-9);
+        fprintf(f, "dq_operacao_segundos_count{op=\"%s\"} %llu\n", nomesOperacoes[op],
+                (unsigned long long)s->quantidade[op]);
+    }
+    for (int c = 0; c < N_CONTADORES_METRICAS; ++c)
+        fprintf(f, "# TYPE dq_%s_total counter\ndq_%s_total %llu\n", nomesContadores[c],
+                nomesContadores[c], (unsigned long long)s->contadores[c]);
+    fprintf(f, "# TYPE dq_altura_bst_maxima gauge\ndq_altura_bst_maxima %llu\n"
+               "# TYPE dq_threads gauge\ndq_threads %d\n",
+            (unsigned long long)s->alturaMaxima, s->threads);
+}
+
+static void escreverJson(FILE *f, const SomaMetricas *s) {
+    fprintf(f, "{\n  \"threads\": %d,\n  \"altura_bst_maxima\": %llu,\n  \"operacoes\": {\n",
+            s->threads, (unsigned long long)s->alturaMaxima);
+    for (int op = 0; op < N_OPERACOES_METRICAS; ++op) {
+        // baldes: [limite superior em ns, quantidade], só os não vazios
+        fprintf(f, "    \"%s\": { \"quantidade\": %llu, \"soma_ns\": %llu, \"baldes\": [",
+                nomesOperacoes[op], (unsigned long long)s->quantidade[op],
+                (unsigned long long)s->somaNs[op]);
+        const char *sep = "";
+        for (int b = 0; b < BALDES_LATENCIA; ++b) {
+            if (!s->baldes[op][b]) continue;
+            fprintf(f, "%s[%llu, %llu]", sep, (unsigned long long)1 << b,
+                    (unsigned long long)s->baldes[op][b]);
+            sep = ", ";
+        }
+        fprintf(f, "] }%s\n", op + 1 < N_OPERACOES_METRICAS ? "," : "");
+    }
+    fprintf(f, "  },\n  \"contadores\": {");
+    for (int c = 0; c < N_CONTADORES_METRICAS; ++c)
+        fprintf(f, "%s \"%s\": %llu", c ? "," : "", nomesContadores[c],
+                (unsigned long long)s->contadores[c]);
+    fprintf(f, " }\n}\n");
+}
+
+// Grava num temporário e renomeia: quem lê o arquivo nunca o vê pela metade.
+static void gravarMetricas(void) {
+    SomaMetricas s;
+    somarMetricas(&s);
+    char temp[1024];
+    snprintf(temp, sizeof temp, "%s.tmp", arquivoMetricas);
+    FILE *f = fopen(temp, "w");
+    if (!f) { perror(temp); return; }
+    size_t n = strlen(arquivoMetricas);
+    if (n >= 5 && strcmp(arquivoMetricas + n - 5, ".json") == 0) escreverJson(f, &s);
+    else escreverPrometheus(f, &s);
+    if (fclose(f) != 0 || rename(temp, arquivoMetricas) != 0) perror(arquivoMetricas);
+}
+
+static void* rotinaMetricas(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&travaMetricas);
+    while (!pararExportador) {
+        struct timespec limite;
+        clock_gettime(CLOCK_REALTIME, &limite);
+        double fim = limite.tv_sec + limite.tv_nsec / 1e9 + intervaloMetricas;
+        limite.tv_sec = (time_t)fim;
+        limite.tv_nsec = (long)((fim - (double)limite.tv_sec) * 1e9);
+        if (pthread_cond_timedwait(&sinalMetricas, &travaMetricas, &limite) != 0 && !pararExportador) {
+            pthread_mutex_unlock(&travaMetricas);
+            gravarMetricas();
+            pthread_mutex_lock(&travaMetricas);
+        }
+    }
+    pthread_mutex_unlock(&travaMetricas);
+    return NULL;
+}
+
+// Na saída do programa: para o exportador e grava a última amostra.
+static void pararMetricas(void) {
+    pthread_mutex_lock(&travaMetricas);
+    pararExportador = 1;
+    pthread_cond_signal(&sinalMetricas);
+    pthread_mutex_unlock(&travaMetricas);
+    pthread_join(threadMetricas, NULL);
+    gravarMetricas();
+}
+#endif
+
+// -----------------------------
+// iniciarMetricas()
+// Liga a instrumentação e a gravação periódica em 'arquivo'.
+// -----------------------------
+static void iniciarMetricas(const char *arquivo, double intervalo) {
+#if METRICAS
+    // calibra as marcas de tempo contra o relógio monotônico (~2 ms)
+    double t0 = agoraSeg(), t;
+    uint64_t m0 = marcaTempo();
+    while ((t = agoraSeg()) - t0 < 0.002) {}
+    nsPorMarca = (t - t0) * 1e9 / (double)(marcaTempo() - m0);
+    arquivoMetricas = arquivo;
+    intervaloMetricas = intervalo > 0 ? intervalo : 10.0;
+    metricasLigadas = 1;
+    pthread_create(&threadMetricas, NULL, rotinaMetricas, NULL);
+    atexit(pararMetricas);
+#else
+    (void)arquivo;
+    (void)intervalo;
+    fprintf(stderr, "Aviso: compilado com -DMETRICAS=0; --metricas ignorado\n");
+#endif
+}
+
+// -----------------------------
+// inicializarArena()
+// Arena vazia; o primeiro bloco só é criado na primeira alocação.
+// -----------------------------
+void inicializarArena(Arena *arena) {
+    arena->atual = NULL;
+    arena->blocos = 0;
+    arena->bytes = 0;
+}
+
+// -----------------------------
+// arenaAlocarAlinhado()
+// Reserva 'tamanho' bytes com o alinhamento pedido (potência de 2).
+// Quando o bloco atual enche, aloca outro com o dobro do tamanho
+// (até ARENA_BLOCO_MAXIMO), então n nós custam O(log n) chamadas
+// a malloc.
+// -----------------------------
+void* arenaAlocarAlinhado(Arena *arena, size_t tamanho, size_t alinhamento) {
+    BlocoArena *b = arena->atual;
+    size_t inicio = b ? (b->usado + alinhamento - 1) & ~(alinhamento - 1) : 0;
+    if (!b || inicio + tamanho > b->tamanho) {
+        size_t cap = b ? b->tamanho * 2 : ARENA_BLOCO_INICIAL;
+        if (cap > ARENA_BLOCO_MAXIMO) cap = ARENA_BLOCO_MAXIMO;
+        if (cap < tamanho) cap = tamanho;
+        b = (BlocoArena*) malloc(sizeof(BlocoArena) + cap);
+        if (!b) { fprintf(stderr, "Erro: malloc arenaAlocar\n"); exit(1); }
+        alocacoesHeap++;
+        b->anterior = arena->atual;
+        b->tamanho = cap;
+        b->usado = 0;
+        arena->atual = b;
+        arena->blocos++;
+        inicio = 0;
+    }
+    void *p = (unsigned char*)b->dados + inicio;
+    b->usado = inicio + tamanho;
+    arena->bytes += tamanho;
+    return p;
+}
+
+// -----------------------------
+// arenaAlocar()
+// Reserva 'tamanho' bytes com alinhamento para qualquer tipo.
+// -----------------------------
+void* arenaAlocar(Arena *arena, size_t tamanho) {
+    return arenaAlocarAlinhado(arena, tamanho, _Alignof(max_align_t));
+}
+
+// -----------------------------
+// arenaReiniciar()
+// Descarta tudo o que foi alocado mas mantém o bloco mais
+// recente (o maior) para a próxima rodada de alocações.
+// -----------------------------
+void arenaReiniciar(Arena *arena) {
+    BlocoArena *b = arena->atual;
+    if (!b) return;
+    BlocoArena *ant = b->anterior;
+    while (ant) {
+        BlocoArena *p = ant->anterior;
+        free(ant);
+        ant = p;
+    }
+    b->anterior = NULL;
+    b->usado = 0;
+    arena->blocos = 1;
+    arena->bytes = 0;
+}
+
+// -----------------------------
+// arenaLiberar()
+// Devolve todos os blocos (custo proporcional ao número de
+// blocos, não ao número de nós).
+// -----------------------------
+void arenaLiberar(Arena *arena) {
+    BlocoArena *b = arena->atual;
+    while (b) {
+        BlocoArena *ant = b->anterior;
+        free(b);
+        b = ant;
     }
+    inicializarArena(arena);
+}
+
+// -----------------------------
+// criarSala()
+// Cria uma sala com nome e pista, alocada na arena do mapa.
+// Os textos são internados no pool; a sala guarda só os ids.
+// Retorna ponteiro para Sala alocada.
+// -----------------------------
+Sala* criarSala(Arena *arena, const char *nome, const char *pista) {
+    Sala *s = (Sala*) arenaAlocar(arena, sizeof(Sala));
+    s->nome = internar(nome);
+    s->pista = internar(pista);
     s->esq = s->dir = NULL;
     return s;
 }
 
 // -----------------------------
-// inserirPista()
-// Insere uma pista na BST (ordem alfabética).
-// Se pista for igual, insere à direita (permite duplicatas).
-// Retorna raiz atualizada.
+// Armazenamento dos nós da BST de pistas
+// Compactos: vetor que dobra com realloc (as posições não mudam
+// ao crescer); a árvore vazia aponta para uma sentinela estática
+// e só aloca na primeira pista. Com ponteiros: arena própria.
 // -----------------------------
-PistaNode* inserirPista(PistaNode *raiz, const char *pista) {
-    if (pista == NULL || pista[0] == '\0') return raiz;
-    if (raiz == NULL) {
-        PistaNode *n = (PistaNode*) malloc(sizeof(PistaNode));
-        if (!n) { fprintf(stderr, "Erro: malloc inserirPista\n"); exit(1); }
-        strncpy(n->pista, pista, MAX_PISTA-1); n->pista[MAX_PISTA-1] = '\0';
-        n->esq = n->dir = NULL;
-        return n;
+#if NOS_COMPACTOS
+static PistaNode sentinelaPistas;   // nunca escrita
+
+void iniciarArvorePistas(ArvorePistas *arv) {
+    arv->nos = &sentinelaPistas;
+    arv->quantidade = 1;
+    arv->capacidade = 0;
+    arv->raiz = PISTA_NULA;
+}
+
+// Esvazia mantendo o vetor para a próxima árvore.
+void esvaziarArvorePistas(ArvorePistas *arv) {
+    arv->quantidade = 1;
+    arv->raiz = PISTA_NULA;
+}
+
+void liberarArvorePistas(ArvorePistas *arv) {
+    if (arv->capacidade) free(arv->nos);
+    iniciarArvorePistas(arv);
+}
+
+static RefPista novoNoPista(ArvorePistas *arv) {
+    if (arv->quantidade == arv->capacidade || arv->capacidade == 0) {
+        if (arv->quantidade > PISTAS_MAXIMAS) {
+            fprintf(stderr, "Erro: mais de %u pistas numa arvore (compile com -DNOS_COMPACTOS=0)\n",
+                    PISTAS_MAXIMAS);
+            exit(1);
+        }
+        uint32_t cap = arv->capacidade ? 2 * arv->capacidade : 64;
+        if (cap > PISTAS_MAXIMAS + 1) cap = PISTAS_MAXIMAS + 1;
+        PistaNode *nos = (PistaNode*) realloc(arv->capacidade ? arv->nos : NULL, cap * sizeof(PistaNode));
+        if (!nos) { fprintf(stderr, "Erro: realloc pistas\n"); exit(1); }
+        alocacoesHeap++;
+        nos[0] = sentinelaPistas;
+        arv->nos = nos;
+        arv->capacidade = cap;
     }
-    if (strcmp(pista, raiz->pista) < 0)
-        raiz->esq = inserirPista(raiz->esq, pista);
-    else
-        raiz->dir = inserirPista(raiz->dir, pista);
-    return raiz;
+    return arv->quantidade++;
+}
+
+// Altura e tamanho de um filho: a sentinela responde 0 aos dois.
+static inline int alturaNo(const ArvorePistas *arv, RefPista r) {
+    return arv->nos[r].altura;
+}
+
+static inline uint32_t tamanhoNo(const ArvorePistas *arv, RefPista r) {
+    return arv->nos[r].tamanho;
+}
+#else
+void iniciarArvorePistas(ArvorePistas *arv) {
+    inicializarArena(&arv->nos);
+    arv->raiz = PISTA_NULA;
+}
+
+void esvaziarArvorePistas(ArvorePistas *arv) {
+    arenaReiniciar(&arv->nos);
+    arv->raiz = PISTA_NULA;
+}
+
+void liberarArvorePistas(ArvorePistas *arv) {
+    arenaLiberar(&arv->nos);
+    arv->raiz = PISTA_NULA;
 }
 
+static RefPista novoNoPista(ArvorePistas *arv) {
+    return (RefPista) arenaAlocar(&arv->nos, sizeof(PistaNode));
+}
+
+static inline int alturaNo(const ArvorePistas *arv, RefPista r) {
+    (void)arv;
+    return r ? r->altura : 0;
+}
+
+static inline uint32_t tamanhoNo(const ArvorePistas *arv, RefPista r) {
+    (void)arv;
+    return r ? r->tamanho : 0;
+}
+#endif
+
 // -----------------------------
-// exibirPistas()
-// Percorre a BST em-order e imprime pistas (ordenadas).
+// alturaPistas()
+// Altura da árvore (0 para árvore vazia).
 // -----------------------------
-void exibirPistas(PistaNode *raiz) {
-    if (!raiz) return;
-    exibirPistas(raiz->esq);
-    printf(" - %s\n", raiz->pista);
-    exibirPistas(raiz->dir);
+int alturaPistas(const ArvorePistas *arv) {
+    return alturaNo(arv, arv->raiz);
 }
 
 // -----------------------------
-// liberarPistas()
-// Libera memória da BST de pistas.
+// tamanhoPistas()
+// Número de pistas na árvore (0 para árvore vazia).
 // -----------------------------
-void liberarPistas(PistaNode *raiz) {
-    if (!raiz) return;
-    liberarPistas(raiz->esq);
-    liberarPistas(raiz->dir);
-    free(raiz);
+size_t tamanhoPistas(const ArvorePistas *arv) {
+    return tamanhoNo(arv, arv->raiz);
+}
+
+// Recalcula altura e tamanho a partir dos filhos.
+static void atualizarNo(ArvorePistas *arv, PistaNode *n) {
+    int he = alturaNo(arv, n->esq), hd = alturaNo(arv, n->dir);
+    n->altura = 1 + (he > hd ? he : hd);
+    n->tamanho = 1 + tamanhoNo(arv, n->esq) + tamanhoNo(arv, n->dir);
+}
+
+static RefPista rotacionarDireita(ArvorePistas *arv, RefPista ry) {
+    PistaNode *y = NO_PISTA(arv, ry);
+    RefPista rx = y->esq;
+    PistaNode *x = NO_PISTA(arv, rx);
+    y->esq = x->dir;
+    x->dir = ry;
+    atualizarNo(arv, y);
+    atualizarNo(arv, x);
+    return rx;
+}
+
+static RefPista rotacionarEsquerda(ArvorePistas *arv, RefPista rx) {
+    PistaNode *x = NO_PISTA(arv, rx);
+    RefPista ry = x->dir;
+    PistaNode *y = NO_PISTA(arv, ry);
+    x->dir = y->esq;
+    y->esq = rx;
+    atualizarNo(arv, x);
+    atualizarNo(arv, y);
+    return ry;
 }
 
 // -----------------------------
-// hash_djb2()
-// Função hash djb2 para strings.
+// balancearPista()
+// Restaura a propriedade AVL (|fator| <= 1) após uma inserção.
 // -----------------------------
-unsigned long hash_djb2(const char *str) {
-    unsigned long hash = 5381;
-    int c;
-    while ((c = (unsigned char)*str++))
-        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
-    return hash % HASH_SIZE;
+static RefPista balancearPista(ArvorePistas *arv, RefPista r) {
+    PistaNode *n = NO_PISTA(arv, r);
+    atualizarNo(arv, n);
+    int fator = alturaNo(arv, n->esq) - alturaNo(arv, n->dir);
+    if (fator > 1) {
+        const PistaNode *e = NO_PISTA(arv, n->esq);
+        if (alturaNo(arv, e->esq) < alturaNo(arv, e->dir))
+            n->esq = rotacionarEsquerda(arv, n->esq);
+        return rotacionarDireita(arv, r);
+    }
+    if (fator < -1) {
+        const PistaNode *d = NO_PISTA(arv, n->dir);
+        if (alturaNo(arv, d->dir) < alturaNo(arv, d->esq))
+            n->dir = rotacionarDireita(arv, n->dir);
+        return rotacionarEsquerda(arv, r);
+    }
+    return r;
+}
+
+// Ordem alfabética entre duas pistas; ids iguais dispensam strcmp.
+static int compararPistas(IdTexto a, IdTexto b) {
+    return a == b ? 0 : strcmp(textoDe(a), textoDe(b));
+}
+
+// Desce até a folha onde 'novo' entra e rebalanceia na volta.
+// Não aloca: os endereços dos nós ficam válidos durante a descida.
+static RefPista inserirNo(ArvorePistas *arv, RefPista r, RefPista novo) {
+    if (r == PISTA_NULA) return novo;
+    PistaNode *n = NO_PISTA(arv, r);
+    if (compararPistas(NO_PISTA(arv, novo)->pista, n->pista) < 0)
+        n->esq = inserirNo(arv, n->esq, novo);
+    else
+        n->dir = inserirNo(arv, n->dir, novo);
+    return balancearPista(arv, r);
 }
 
 // -----------------------------
-// inserirNaHash()
-// Insere associação pista -> suspeito na tabela hash.
+// inserirPista()
+// Insere uma pista na BST (ordem alfabética) e rebalanceia (AVL),
+// garantindo altura O(log n) mesmo com pistas já ordenadas.
+// O nó novo sai do armazenamento da própria árvore.
+// Se pista for igual, insere à direita (permite duplicatas; as
+// sessões filtram repetidas pelo bitset antes de chamar).
 // -----------------------------
-void inserirNaHash(HashNode *tabela[], const char *pista, const char *suspeito) {
-    if (!pista || pista[0] == '\0' || !suspeito) return;
-    unsigned long idx = hash_djb2(pista);
-    HashNode *n = (HashNode*) malloc(sizeof(HashNode));
-    if (!n) { fprintf(stderr, "Erro: malloc inserirNaHash\n"); exit(1); }
-    strncpy(n->pista, pista, MAX_PISTA-1); n->pista[MAX_PISTA-1] = '\0';
-    strncpy(n->suspeito, suspeito, MAX_NOME-1); n->suspeito[MAX_NOME-1] = '\0';
-    n->prox = tabela[idx];
-    tabela[idx] = n;
+void inserirPista(ArvorePistas *arv, IdTexto pista) {
+    if (pista == TEXTO_NENHUM) return;
+    RefPista novo = novoNoPista(arv);
+    PistaNode *n = NO_PISTA(arv, novo);
+    n->pista = pista;
+    n->altura = 1;
+    n->tamanho = 1;
+    n->esq = n->dir = PISTA_NULA;
+    arv->raiz = inserirNo(arv, arv->raiz, novo);
 }
 
+
 // -----------------------------
-// encontrarSuspeito()
-// Retorna ponteiro para nome do suspeito associado a uma pista.
-// Se não encontrar, retorna NULL.
+// pistaNaPosicao()
+// k-ésima pista em ordem alfabética (k a partir de 0), ou
+// TEXTO_NENHUM se k >= número de pistas. O(log n).
 // -----------------------------
-const char* encontrarSuspeito(HashNode *tabela[], const char *pista) {
-    if (!pista || pista[0] == '\0') return NULL;
-    unsigned long idx = hash_djb2(pista);
-    HashNode *cur = tabela[idx];
-    while (cur) {
-        if (strcmp(cur->pista, pista) == 0)
-            return cur->suspeito;
-        cur = cur->prox;
+IdTexto pistaNaPosicao(const ArvorePistas *arv, size_t k) {
+    for (RefPista r = arv->raiz; r != PISTA_NULA; ) {
+        const PistaNode *n = NO_PISTA(arv, r);
+        size_t e = tamanhoNo(arv, n->esq);
+        if (k == e) return n->pista;
+        if (k < e) {
+            r = n->esq;
+        } else {
+            k -= e + 1;
+            r = n->dir;
+        }
     }
-    return NULL;
+    return TEXTO_NENHUM;
 }
 
 // -----------------------------
-// explorarSalas()
-// Navega pela árvore de salas a partir de 'inicio'.
-// Ao entrar em sala: exibe nome, coleta pista (se houver) e
-// insere a pista na BST de pistas automaticamente.
-// O jogador escolhe 'e' (esq), 'd' (dir) ou 's' (sair).
+// posicaoDaPista()
+// Quantas pistas vêm antes de 'texto' em ordem alfabética (a
+// posição que ele ocupa ou ocuparia). O(log n) comparações.
 // -----------------------------
-void explorarSalas(Sala *inicio, PistaNode **raizPistas, HashNode *tabela[]) {
-    if (!inicio) return;
-    Sala *atual = inicio;
-    char opc;
-    while (1) {
-        printf("\n--- Você entrou em: %s ---\n", atual->nome);
-        if (strlen(atual->pista) > 0) {
-            printf("Pista encontrada: \"%s\"\n", atual->pista);
-            *raizPistas = inserirPista(*raizPistas, atual->pista);
+size_t posicaoDaPista(const ArvorePistas *arv, const char *texto) {
+    size_t antes = 0;
+    for (RefPista r = arv->raiz; r != PISTA_NULA; ) {
+        const PistaNode *n = NO_PISTA(arv, r);
+        if (strcmp(textoDe(n->pista), texto) < 0) {
+            antes += tamanhoNo(arv, n->esq) + 1;
+            r = n->dir;
         } else {
-            printf("Nenhuma pista neste cômodo.\n");
+            r = n->esq;
         }
+    }
+    return antes;
+}
 
-        // opções
-        printf("\nCaminhos disponíveis:\n");
-        if (atual->esq) printf(" (e) Ir para %s\n", atual->esq->nome);
-        if (atual->dir) printf(" (d) Ir para %s\n", atual->dir->nome);
-        printf(" (s) Sair e ir ao julgamento\n");
-        printf("Escolha: ");
-        scanf(" %c", &opc);
-        opc = tolower(opc);
-
-        if (opc == 'e' && atual->esq) {
-            atual = atual->esq;
-        } else if (opc == 'd' && atual->dir) {
-            atual = atual->dir;
-        } else if (opc == 's') {
-            printf("\nExploração encerrada pelo jogador.\n");
-            return;
+// -----------------------------
+// contarPistasComPrefixo()
+// Pistas que começam por 'prefixo': as que ficam até o fim do
+// bloco do prefixo menos as que ficam antes dele. O(log n).
+// -----------------------------
+size_t contarPistasComPrefixo(const ArvorePistas *arv, const char *prefixo) {
+    size_t tam = strlen(prefixo), ate = 0;
+    for (RefPista r = arv->raiz; r != PISTA_NULA; ) {
+        const PistaNode *n = NO_PISTA(arv, r);
+        if (strncmp(textoDe(n->pista), prefixo, tam) <= 0) {
+            ate += tamanhoNo(arv, n->esq) + 1;
+            r = n->dir;
         } else {
-            printf("Opção inválida ou caminho inexistente. Tente novamente.\n");
+            r = n->esq;
         }
     }
+    return ate - posicaoDaPista(arv, prefixo);
 }
 
 // -----------------------------
-// verificarSuspeitoFinal()
-// Percorre a BST de pistas coletadas e conta quantas apontam
-// para o suspeito acusado (usando a tabela hash).
-// Retorna número de pistas que apontam para o acusado.
+// cursorNaPosicao()
+// Posiciona o cursor na k-ésima pista: a próxima chamada de
+// proximaPista() devolve pistaNaPosicao(arv, k).
 // -----------------------------
-int verificarSuspeitoFinal(PistaNode *raizPistas, HashNode *tabela[], const char *acusado) {
-    if (!raizPistas) return 0;
-    int count = 0;
-    // use stackless recursion to traverse; define inner function via recursion
-    struct Frame { PistaNode *node; } ;
-    // simple recursive traversal
-    if (raizPistas->esq) count += verificarSuspeitoFinal(raizPistas->esq, tabela, acusado);
-    const char *sus = encontrarSuspeito(tabela, raizPistas->pista);
-    if (sus && strcmp(sus, acusado) == 0) count++;
-    if (raizPistas->dir) count += verificarSuspeitoFinal(raizPistas->dir, tabela, acusado);
-    return count;
+void cursorNaPosicao(CursorPistas *cursor, const ArvorePistas *arv, size_t k) {
+    cursor->arvore = arv;
+    cursor->topo = 0;
+    for (RefPista r = arv->raiz; r != PISTA_NULA; ) {
+        const PistaNode *n = NO_PISTA(arv, r);
+        size_t e = tamanhoNo(arv, n->esq);
+        if (k <= e) {
+            cursor->pilha[cursor->topo++] = r;
+            if (k == e) return;
+            r = n->esq;
+        } else {
+            k -= e + 1;
+            r = n->dir;
+        }
+    }
 }
 
 // -----------------------------
-// liberarHash()
-// Libera a tabela hash.
+// cursorNoTexto()
+// Posiciona o cursor na primeira pista >= texto.
 // -----------------------------
-void liberarHash(HashNode *tabela[]) {
-    for (int i = 0; i < HASH_SIZE; ++i) {
-        HashNode *cur = tabela[i];
-        while (cur) {
-            HashNode *tmp = cur;
-            cur = cur->prox;
-            free(tmp);
+void cursorNoTexto(CursorPistas *cursor, const ArvorePistas *arv, const char *texto) {
+    cursor->arvore = arv;
+    cursor->topo = 0;
+    for (RefPista r = arv->raiz; r != PISTA_NULA; ) {
+        const PistaNode *n = NO_PISTA(arv, r);
+        if (strcmp(textoDe(n->pista), texto) >= 0) {
+            cursor->pilha[cursor->topo++] = r;
+            r = n->esq;
+        } else {
+            r = n->dir;
         }
-        tabela[i] = NULL;
     }
 }
 
 // -----------------------------
-// liberarMapa()
-// Libera toda a árvore de salas (pos-order)
+// proximaPista()
+// Devolve a pista sob o cursor e avança, ou TEXTO_NENHUM no fim.
+// O(1) amortizado por pista.
 // -----------------------------
-void liberarMapa(Sala *raiz) {
-    if (!raiz) return;
-    liberarMapa(raiz->esq);
-    liberarMapa(raiz->dir);
-    free(raiz);
+IdTexto proximaPista(CursorPistas *cursor) {
+    if (cursor->topo == 0) return TEXTO_NENHUM;
+    const ArvorePistas *arv = cursor->arvore;
+    const PistaNode *n = NO_PISTA(arv, cursor->pilha[--cursor->topo]);
+    for (RefPista d = n->dir; d != PISTA_NULA; d = NO_PISTA(arv, d)->esq)
+        cursor->pilha[cursor->topo++] = d;
+    return n->pista;
 }
 
 // -----------------------------
-// main()
-// Monta mapa fixo, monta hash de pistas->suspeitos,
-// permite exploração, exibe pistas e conduz acusação.
+// percorrerPistas()
+// Entrega a 'visitar' as pistas em ordem alfabética, a partir da
+// primeira >= 'desde' (NULL: desde o início), sem recursão nem
+// alocação (a pilha é a do cursor). Para assim que 'visitar'
+// retorna diferente de 0. Retorna quantas pistas foram entregues.
 // -----------------------------
-int main() {
-    // 1) Montar mapa (árvore binária fixa)
-    // Exemplo de mapa:
-    //                 Hall
-    //              /       \
-    //         SalaEstar    Cozinha
-    //         /     \         \
-    //      Jardim  Biblioteca  Despensa
-
-    Sala *hall = criarSala("Hall de Entrada", "Pegadas úmidas na passadeira");
-    Sala *salaEstar = criarSala("Sala de Estar", "Livro de receitas rasgado");
-    Sala *cozinha = criarSala("Cozinha", "Talher faltando no gaveteiro");
-    Sala *jardim = criarSala("Jardim", "Pedaço de tecido encharcado");
-    Sala *biblioteca = criarSala("Biblioteca", "Página arrancada com anotações");
-    Sala *despensa = criarSala("Despensa", "Frasco com resíduo químico");
+size_t percorrerPistas(const ArvorePistas *arv, const char *desde,
+                       int (*visitar)(IdTexto pista, void *contexto), void *contexto) {
+    MEDIR_INICIO(t0);
+    CursorPistas cursor;
+    if (desde) cursorNoTexto(&cursor, arv, desde);
+    else cursorNaPosicao(&cursor, arv, 0);
+    size_t n = 0;
+    for (IdTexto p; (p = proximaPista(&cursor)) != TEXTO_NENHUM; ) {
+        n++;
+        if (visitar(p, contexto)) break;
+    }
+    MEDIR_FIM(MET_PERCORRER, t0);
+    CONTAR_METRICA(CONT_PISTAS_PERCORRIDAS, n);
+    return n;
+}
 
-    hall->esq = salaEstar; hall->dir = cozinha;
-    salaEstar->esq = jardim; salaEstar->dir = biblioteca;
-    cozinha->dir = despensa;
+static int imprimirPista(IdTexto pista, void *contexto) {
+    (void)contexto;
+    printf(" - %s\n", textoDe(pista));
+    return 0;
+}
 
-    // 2) Inicializar tabela hash vazia
-    HashNode *tabela[HASH_SIZE];
-    for (int i = 0; i < HASH_SIZE; ++i) tabela[i] = NULL;
+// -----------------------------
+// exibirPistas()
+// Imprime as pistas da BST em ordem alfabética.
+// -----------------------------
+void exibirPistas(const ArvorePistas *arv) {
+    percorrerPistas(arv, NULL, imprimirPista, NULL);
+}
 
-    // 3) Popular tabela hash com associações pista -> suspeito
-    // (essas associações são pré-definidas no código)
-    inserirNaHash(tabela, "Pegadas úmidas na passadeira", "Sr. Verde");
-    inserirNaHash(tabela, "Livro de receitas rasgado", "Sra. Rosa");
+// -----------------------------
+// hash_djb2()
+// Função hash djb2 para strings (valor completo; a tabela
+// espalha os bits e usa máscara de potência de 2). Um byte por
+// iteração; mantida para -DHASH_TEXTOS=1 e para comparação.
+// -----------------------------
+uint64_t hash_djb2(const char *str) {
+    uint64_t hash = 5381;
+    int c;
+    while ((c = (unsigned char)*str++))
+        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+    return hash;
+}
+
+// Produto 64x64 -> 128 bits: a recebe a metade baixa, b a alta.
+static inline void multiplicar128(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t dobrarProduto(uint64_t a, uint64_t b) {
+    multiplicar128(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t ler64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t ler32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// -----------------------------
+// hash_palavras()
+// Hash de texto no estilo do wyhash: consome 16 bytes por passo
+// (48 em três faixas independentes nos textos longos) e mistura
+// cada par de palavras de 64 bits com um produto de 128 bits, em
+// vez da cadeia de uma multiplicação por byte do djb2. Lê com
+// memcpy, sem exigir alinhamento e sem passar de 'tamanho'.
+// -----------------------------
+uint64_t hash_palavras(const char *texto, size_t tamanho) {
+    static const uint64_t seg[4] = { 0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+                                     0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull };
+    const unsigned char *p = (const unsigned char*) texto;
+    uint64_t semente = dobrarProduto(seg[0], seg[1]);
+    uint64_t a, b;
+    if (tamanho <= 16) {
+        if (tamanho >= 4) {
+            size_t d = (tamanho >> 3) << 2;
+            a = (ler32(p) << 32) | ler32(p + d);
+            b = (ler32(p + tamanho - 4) << 32) | ler32(p + tamanho - 4 - d);
+        } else if (tamanho > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[tamanho >> 1] << 8) | p[tamanho - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = tamanho;
+        if (i > 48) {
+            uint64_t faixa1 = semente, faixa2 = semente;
+            do {
+                semente = dobrarProduto(ler64(p) ^ seg[1], ler64(p + 8) ^ semente);
+                faixa1 = dobrarProduto(ler64(p + 16) ^ seg[2], ler64(p + 24) ^ faixa1);
+                faixa2 = dobrarProduto(ler64(p + 32) ^ seg[3], ler64(p + 40) ^ faixa2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            semente ^= faixa1 ^ faixa2;
+        }
+        while (i > 16) {
+            semente = dobrarProduto(ler64(p) ^ seg[1], ler64(p + 8) ^ semente);
+            p += 16;
+            i -= 16;
+        }
+        a = ler64(p + i - 16);
+        b = ler64(p + i - 8);
+    }
+    a ^= seg[1];
+    b ^= semente;
+    multiplicar128(&a, &b);
+    return dobrarProduto(a ^ seg[0] ^ tamanho, b ^ seg[1]);
+}
+
+// Hash usado pelo pool (calculado uma vez por texto e guardado em
+// pool.hashes; as tabelas por id não voltam a olhar o texto).
+static inline uint64_t hashTexto(const char *texto, size_t tamanho) {
+#if HASH_TEXTOS == HASH_TEXTOS_DJB2
+    (void)tamanho;
+    return hash_djb2(texto);
+#else
+    return hash_palavras(texto, tamanho);
+#endif
+}
+
+#define CTRL_VAZIO ((int8_t)-128)
+
+// Espalha o hash: H1 (posição) usa os bits baixos, H2 (byte de
+// controle) os 7 bits altos.
+static uint64_t espalharHash(uint64_t h) {
+    uint64_t m = h * 0x9E3779B97F4A7C15ULL;
+    return m ^ (m >> 29);
+}
+
+static int8_t hashH2(uint64_t m) {
+    return (int8_t)(m >> 57);
+}
+
+// Máscara de bits: bit k ligado se ctrl[pos + k] == alvo.
+static unsigned casarGrupo(const int8_t *ctrl, size_t pos, int8_t alvo) {
+#ifdef __SSE2__
+    __m128i g = _mm_loadu_si128((const __m128i*)(ctrl + pos));
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(alvo)));
+#else
+    unsigned mask = 0;
+    for (int k = 0; k < HASH_GRUPO; ++k)
+        if (ctrl[pos + k] == alvo) mask |= 1u << k;
+    return mask;
+#endif
+}
+
+static void alocarIndice(IndiceAberto *ind, size_t capacidade) {
+    ind->capacidade = capacidade;
+    ind->ctrl = (int8_t*) malloc(capacidade + HASH_GRUPO);
+    ind->slots = (uint32_t*) calloc(capacidade, sizeof(uint32_t));
+    if (!ind->ctrl || !ind->slots) { fprintf(stderr, "Erro: malloc indice hash\n"); exit(1); }
+    alocacoesHeap += 2;
+    memset(ind->ctrl, CTRL_VAZIO, capacidade + HASH_GRUPO);
+}
+
+static void liberarIndice(IndiceAberto *ind) {
+    free(ind->ctrl);
+    free(ind->slots);
+    ind->ctrl = NULL;
+    ind->slots = NULL;
+    ind->capacidade = 0;
+}
+
+// Cópia de um índice (usada ao deixar de emprestar do arquivo).
+static void copiarIndice(IndiceAberto *destino, const IndiceAberto *origem) {
+    alocarIndice(destino, origem->capacidade);
+    memcpy(destino->ctrl, origem->ctrl, origem->capacidade + HASH_GRUPO);
+    memcpy(destino->slots, origem->slots, origem->capacidade * sizeof(uint32_t));
+}
+
+// Grava 'valor' num slot livre para o hash espalhado m (a chave
+// ainda não está no índice).
+static void indiceColocar(IndiceAberto *ind, uint64_t m, uint32_t valor) {
+    size_t mask = ind->capacidade - 1;
+    size_t pos = m & mask;
+    for (size_t passo = HASH_GRUPO; ; passo += HASH_GRUPO) {
+        unsigned vazios = casarGrupo(ind->ctrl, pos, CTRL_VAZIO);
+        if (vazios) {
+            size_t i = (pos + (size_t)__builtin_ctz(vazios)) & mask;
+            ind->ctrl[i] = hashH2(m);
+            // espelha o início no fim para grupos que passam da borda
+            if (i < HASH_GRUPO) ind->ctrl[ind->capacidade + i] = hashH2(m);
+            ind->slots[i] = valor;
+            return;
+        }
+        pos = (pos + passo) & mask;   // sondagem triangular por grupos
+    }
+}
+
+// Grupos visitados até alcançar o slot i a partir do hash m.
+static size_t gruposAteSlot(const IndiceAberto *ind, uint64_t m, size_t i) {
+    size_t mask = ind->capacidade - 1;
+    size_t pos = m & mask, grupos = 1;
+    for (size_t passo = HASH_GRUPO; ((i - pos) & mask) >= HASH_GRUPO; passo += HASH_GRUPO) {
+        pos = (pos + passo) & mask;
+        grupos++;
+    }
+    return grupos;
+}
+
+// -----------------------------
+// Pool global de textos
+// -----------------------------
+static PoolTextos pool;
+
+static void inicializarPool(void) {
+    memset(&pool, 0, sizeof(pool));
+    inicializarArena(&pool.bytes);
+    pool.capIds = 256;
+    pool.textos = (const char**) malloc(pool.capIds * sizeof(const char*));
+    pool.hashes = (uint64_t*) malloc(pool.capIds * sizeof(uint64_t));
+    if (!pool.textos || !pool.hashes) { fprintf(stderr, "Erro: malloc pool\n"); exit(1); }
+    alocacoesHeap += 2;
+    pool.textos[TEXTO_NENHUM] = "";
+    pool.hashes[TEXTO_NENHUM] = 0;
+    pool.quantidade = 1;
+    alocarIndice(&pool.indice, HASH_CAPACIDADE_INICIAL);
+}
+
+static inline const char* textoDoPool(IdTexto id) {
+    return pool.deslocamentos ? pool.base + pool.deslocamentos[id] : pool.textos[id];
+}
+
+// -----------------------------
+// adotarTextosDoArquivo()
+// O pool (ainda vazio) passa a usar a tabela de textos de um
+// arquivo mapeado, em O(1): os ids do arquivo viram os ids do pool.
+// -----------------------------
+static void adotarTextosDoArquivo(const char *base, const uint32_t *deslocamentos,
+                                  const uint64_t *hashes, uint32_t quantidade,
+                                  const int8_t *ctrl, const uint32_t *slots, size_t capacidade) {
+    if (pool.quantidade != 0) {
+        fprintf(stderr, "Erro: a mansao binaria deve ser aberta antes de internar textos\n");
+        exit(1);
+    }
+    memset(&pool, 0, sizeof(pool));
+    inicializarArena(&pool.bytes);
+    pool.base = base;
+    pool.deslocamentos = deslocamentos;
+    pool.hashes = (uint64_t*) hashes;
+    pool.quantidade = quantidade;
+    pool.capIds = quantidade;
+    pool.indice.ctrl = (int8_t*) ctrl;
+    pool.indice.slots = (uint32_t*) slots;
+    pool.indice.capacidade = capacidade;
+    pool.emprestado = 1;
+}
+
+// Troca os vetores emprestados do arquivo por cópias próprias
+// (antes da primeira alteração do pool).
+static void tornarPoolProprio(void) {
+    uint32_t cap = 256;
+    while (cap < pool.quantidade * 2) cap *= 2;
+    const char **textos = (const char**) malloc(cap * sizeof(const char*));
+    uint64_t *hashes = (uint64_t*) malloc(cap * sizeof(uint64_t));
+    if (!textos || !hashes) { fprintf(stderr, "Erro: malloc pool\n"); exit(1); }
+    alocacoesHeap += 2;
+    for (IdTexto i = 0; i < pool.quantidade; ++i) textos[i] = textoDoPool(i);
+    memcpy(hashes, pool.hashes, pool.quantidade * sizeof(uint64_t));
+    IndiceAberto ind;
+    copiarIndice(&ind, &pool.indice);
+    pool.textos = textos;
+    pool.hashes = hashes;
+    pool.capIds = cap;
+    pool.indice = ind;
+    pool.base = NULL;
+    pool.deslocamentos = NULL;
+    pool.emprestado = 0;
+}
+
+static IdTexto procurarNoPool(const char *texto, uint64_t h) {
+    uint64_t m = espalharHash(h);
+    int8_t h2 = hashH2(m);
+    size_t mask = pool.indice.capacidade - 1;
+    size_t pos = m & mask;
+    for (size_t passo = HASH_GRUPO; ; passo += HASH_GRUPO) {
+        unsigned cand = casarGrupo(pool.indice.ctrl, pos, h2);
+        while (cand) {
+            IdTexto id = pool.indice.slots[(pos + (size_t)__builtin_ctz(cand)) & mask];
+            if (pool.hashes[id] == h && strcmp(textoDoPool(id), texto) == 0)
+                return id;
+            cand &= cand - 1;
+        }
+        if (casarGrupo(pool.indice.ctrl, pos, CTRL_VAZIO)) return TEXTO_NENHUM;
+        pos = (pos + passo) & mask;
+    }
+}
+
+// -----------------------------
+// internar()
+// Retorna o id do texto, cadastrando-o na primeira vez.
+// NULL ou "" viram TEXTO_NENHUM.
+// -----------------------------
+IdTexto internar(const char *texto) {
+    if (!texto || texto[0] == '\0') return TEXTO_NENHUM;
+    if (pool.quantidade == 0) inicializarPool();
+    size_t tam = strlen(texto);
+    uint64_t h = hashTexto(texto, tam);
+    IdTexto id = procurarNoPool(texto, h);
+    if (id != TEXTO_NENHUM) return id;
+
+    if (pool.emprestado) tornarPoolProprio();
+    if (pool.quantidade == pool.capIds) {
+        pool.capIds *= 2;
+        pool.textos = (const char**) realloc(pool.textos, pool.capIds * sizeof(const char*));
+        pool.hashes = (uint64_t*) realloc(pool.hashes, pool.capIds * sizeof(uint64_t));
+        if (!pool.textos || !pool.hashes) { fprintf(stderr, "Erro: realloc pool\n"); exit(1); }
+        alocacoesHeap += 2;
+    }
+    if ((size_t)pool.quantidade * 8 > pool.indice.capacidade * 7) {
+        liberarIndice(&pool.indice);
+        alocarIndice(&pool.indice, pool.capIds * 2);
+        for (IdTexto i = 1; i < pool.quantidade; ++i)
+            indiceColocar(&pool.indice, espalharHash(pool.hashes[i]), i);
+    }
+    char *copia = (char*) arenaAlocarAlinhado(&pool.bytes, tam + 1, 1);
+    memcpy(copia, texto, tam + 1);
+    id = pool.quantidade++;
+    pool.textos[id] = copia;
+    pool.hashes[id] = h;
+    indiceColocar(&pool.indice, espalharHash(h), id);
+    return id;
+}
+
+// -----------------------------
+// buscarTexto()
+// Id de um texto já internado, ou TEXTO_NENHUM (não cadastra).
+// -----------------------------
+IdTexto buscarTexto(const char *texto) {
+    if (!texto || texto[0] == '\0' || pool.quantidade == 0) return TEXTO_NENHUM;
+    return procurarNoPool(texto, hashTexto(texto, strlen(texto)));
+}
+
+// -----------------------------
+// textoDe()
+// Texto de um id (só para exibição e ordenação).
+// -----------------------------
+const char* textoDe(IdTexto id) {
+    return id < pool.quantidade ? textoDoPool(id) : "";
+}
+
+// -----------------------------
+// liberarPool()
+// -----------------------------
+void liberarPool(void) {
+    if (pool.quantidade == 0) return;
+    arenaLiberar(&pool.bytes);
+    if (!pool.emprestado) {
+        free(pool.textos);
+        free(pool.hashes);
+        liberarIndice(&pool.indice);
+    }
+    memset(&pool, 0, sizeof(pool));
+}
+
+// -----------------------------
+// Tabela hash pista -> suspeito
+// Chave é o id da pista: a sondagem compara inteiros.
+// -----------------------------
+
+// Hash perfeito mínimo (hash e deslocamento, como no CHD): a pista
+// cai num balde pelos bits altos de h; cada balde guarda o
+// deslocamento que leva todas as suas pistas a posições livres.
+#define PERFEITO_CHAVES_POR_BALDE 4
+
+static inline uint64_t misturar64(uint64_t x) {
+    x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27; x *= 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// x (32 bits) levado a [0, n) sem divisão.
+static inline uint32_t reduzir32(uint64_t x, uint32_t n) {
+    return (uint32_t)(((x & 0xFFFFFFFFu) * n) >> 32);
+}
+
+static uint64_t proximoAleatorio(uint64_t *estado) {
+    // xorshift64*
+    uint64_t x = *estado;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *estado = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static inline uint64_t hashFixo(IdTexto pista, uint64_t semente) {
+    return misturar64(pista ^ semente);
+}
+
+static inline uint32_t slotFixo(uint64_t h, uint32_t piloto, uint32_t n) {
+    return reduzir32(misturar64(h + (piloto + 1ull) * 0x9E3779B97F4A7C15ULL) >> 32, n);
+}
+
+// Posição da pista na parte perfeita, ou -1. Uma única sondagem.
+// h é hashFixo(pista, t->semente).
+static inline long buscarFixa(const TabelaHash *t, IdTexto pista, uint64_t h) {
+    uint32_t e = slotFixo(h, t->pilotos[reduzir32(h >> 32, t->nBaldes)], t->nFixas);
+    return t->entradas[e].pista == pista ? (long)e : -1;
+}
+
+// Filtro de Bloom: usa o mesmo hash da parte perfeita (já calculado
+// em toda busca). O bloco vem dos 32 bits altos; o bit de cada
+// palavra, de 6 bits do topo de um produto que mistura o hash todo
+// (tirados direto de h, repetiriam os bits do bloco em mapas grandes
+// e as pistas de um bloco marcariam os mesmos bits). Com 16 bits por
+// pista, cerca de 0,1% de falsos positivos.
+#define PALAVRAS_FILTRO 8
+#define BITS_FILTRO_POR_PISTA 16
+#define PISTAS_POR_BLOCO_FILTRO (PALAVRAS_FILTRO * 64 / BITS_FILTRO_POR_PISTA)
+
+// Com pilotos e entradas abaixo disso (em bytes), a tabela fica na
+// cache e a busca direta sai mais barata que ler o filtro antes:
+// congelarHash não o constrói. -DFILTRO_MINIMO_BYTES=0 sempre constrói.
+#ifndef FILTRO_MINIMO_BYTES
+#define FILTRO_MINIMO_BYTES (4u << 20)
+#endif
+
+// 1 << i em tabela: sem BMI2, o deslocamento variável custa vários uops
+static const uint64_t bitFiltro[64] = {
+#define B4(i) 1ull << (i), 1ull << ((i) + 1), 1ull << ((i) + 2), 1ull << ((i) + 3)
+    B4(0), B4(4), B4(8), B4(12), B4(16), B4(20), B4(24), B4(28),
+    B4(32), B4(36), B4(40), B4(44), B4(48), B4(52), B4(56), B4(60)
+#undef B4
+};
+
+static inline uint64_t bitsDoFiltro(uint64_t h) {
+    return ((h ^ (h >> 32)) * 0x9E3779B97F4A7C15ULL) >> 16;
+}
+
+static inline const uint64_t* blocoDoFiltro(const FiltroPistas *f, uint64_t h) {
+    return f->blocos + (size_t)reduzir32(h >> 32, f->nBlocos) * PALAVRAS_FILTRO;
+}
+
+// 0 se a pista de hash h certamente não está na tabela.
+static inline int filtroPodeTer(const FiltroPistas *f, uint64_t h) {
+    const uint64_t *b = blocoDoFiltro(f, h);
+    uint64_t g = bitsDoFiltro(h), falta = 0;
+#pragma GCC unroll 8
+    for (int i = 0; i < PALAVRAS_FILTRO; ++i)
+        falta |= ~b[i] & bitFiltro[g >> (6 * i) & 63];
+    return falta == 0;
+}
+
+static inline void marcarNoFiltro(FiltroPistas *f, uint64_t h) {
+    uint64_t *b = (uint64_t*) blocoDoFiltro(f, h);
+    uint64_t g = bitsDoFiltro(h);
+    for (int i = 0; i < PALAVRAS_FILTRO; ++i) b[i] |= bitFiltro[g >> (6 * i) & 63];
+    f->pistas++;
+}
+
+static void liberarFiltro(FiltroPistas *f) {
+    free(f->blocos);
+    memset(f, 0, sizeof(*f));
+}
+
+// Refaz o filtro com todas as pistas da tabela, dimensionado para
+// 'capacidade' pistas. Depende da semente do hash perfeito.
+static void construirFiltro(TabelaHash *tabela, size_t capacidade) {
+    FiltroPistas *f = &tabela->filtro;
+    liberarFiltro(f);
+    size_t nBlocos = (capacidade + PISTAS_POR_BLOCO_FILTRO - 1) / PISTAS_POR_BLOCO_FILTRO;
+    if (nBlocos == 0) nBlocos = 1;
+    if (nBlocos > UINT32_MAX) nBlocos = UINT32_MAX;
+    size_t bytes = nBlocos * PALAVRAS_FILTRO * sizeof(uint64_t);
+    f->blocos = (uint64_t*) aligned_alloc(64, bytes);
+    if (!f->blocos) { fprintf(stderr, "Erro: malloc filtro de pistas\n"); exit(1); }
+    alocacoesHeap++;
+    memset(f->blocos, 0, bytes);
+    f->nBlocos = (uint32_t)nBlocos;
+    for (size_t e = 0; e < tabela->quantidade; ++e)
+        marcarNoFiltro(f, hashFixo(tabela->entradas[e].pista, tabela->semente));
+}
+
+// Índice da entrada com a pista, ou -1, sem passar pelo filtro.
+static long buscarNaTabela(const TabelaHash *t, IdTexto pista, uint64_t h) {
+    if (t->nFixas) {
+        CONTAR_METRICA(CONT_SONDAGENS_FIXAS, 1);
+        long e = buscarFixa(t, pista, h);
+        if (e >= 0 || t->quantidade == t->nFixas) return e;
+    }
+    uint64_t m = espalharHash(pista);
+    int8_t h2 = hashH2(m);
+    size_t mask = t->indice.capacidade - 1;
+    size_t pos = m & mask;
+    for (size_t passo = HASH_GRUPO; ; passo += HASH_GRUPO) {
+        unsigned cand = casarGrupo(t->indice.ctrl, pos, h2);
+        while (cand) {
+            uint32_t e = t->indice.slots[(pos + (size_t)__builtin_ctz(cand)) & mask];
+            if (t->entradas[e].pista == pista) {
+                CONTAR_METRICA(CONT_SONDAGENS, passo / HASH_GRUPO);
+                return (long)e;
+            }
+            cand &= cand - 1;
+        }
+        if (casarGrupo(t->indice.ctrl, pos, CTRL_VAZIO)) {
+            CONTAR_METRICA(CONT_SONDAGENS, passo / HASH_GRUPO);
+            return -1;
+        }
+        pos = (pos + passo) & mask;
+    }
+}
+
+// Índice da entrada com a pista, ou -1.
+// Só leitura: a tabela pode ser consultada por várias threads.
+static long buscarEntrada(const TabelaHash *t, IdTexto pista) {
+    CONTAR_METRICA(CONT_BUSCAS_TABELA, 1);
+    // o filtro só existe junto com a parte perfeita
+    uint64_t h = t->nFixas ? hashFixo(pista, t->semente) : 0;
+    if (!t->filtro.nBlocos) return buscarNaTabela(t, pista, h);
+    if (!filtroPodeTer(&t->filtro, h)) {
+        CONTAR_METRICA(CONT_REJEITADAS_FILTRO, 1);
+        return -1;
+    }
+    long e = buscarNaTabela(t, pista, h);
+    if (e < 0) CONTAR_METRICA(CONT_FALSOS_POSITIVOS, 1);
+    return e;
+}
+
+// -----------------------------
+// inicializarHash()
+// Prepara uma tabela vazia com capacidade inicial.
+// -----------------------------
+void inicializarHash(TabelaHash *tabela) {
+    memset(tabela, 0, sizeof(*tabela));
+    alocarIndice(&tabela->indice, HASH_CAPACIDADE_INICIAL);
+    alocarIndice(&tabela->indiceSuspeitos, HASH_CAPACIDADE_INICIAL);
+}
+
+// -----------------------------
+// indiceDoSuspeito()
+// Posição densa do suspeito na tabela, ou -1 se ele não está
+// associado a nenhuma pista.
+// -----------------------------
+long indiceDoSuspeito(const TabelaHash *tabela, IdTexto suspeito) {
+    if (suspeito == TEXTO_NENHUM) return -1;
+    const IndiceAberto *ind = &tabela->indiceSuspeitos;
+    uint64_t m = espalharHash(suspeito);
+    size_t mask = ind->capacidade - 1;
+    size_t pos = m & mask;
+    for (size_t passo = HASH_GRUPO; ; passo += HASH_GRUPO) {
+        unsigned cand = casarGrupo(ind->ctrl, pos, hashH2(m));
+        while (cand) {
+            uint32_t k = ind->slots[(pos + (size_t)__builtin_ctz(cand)) & mask];
+            if (tabela->suspeitos[k] == suspeito) return (long)k;
+            cand &= cand - 1;
+        }
+        if (casarGrupo(ind->ctrl, pos, CTRL_VAZIO)) return -1;
+        pos = (pos + passo) & mask;
+    }
+}
+
+// Cópia própria de um vetor (NULL se vazio).
+static void* duplicarVetor(const void *origem, size_t tamanho) {
+    if (tamanho == 0) return NULL;
+    void *copia = malloc(tamanho);
+    if (!copia) { fprintf(stderr, "Erro: malloc tabela\n"); exit(1); }
+    alocacoesHeap++;
+    memcpy(copia, origem, tamanho);
+    return copia;
+}
+
+// Troca os vetores de uma tabela mapeada de arquivo por cópias
+// próprias, antes da primeira inserção.
+static void tornarTabelaPropria(TabelaHash *tabela) {
+    IndiceAberto indice, indiceSuspeitos;
+    copiarIndice(&indice, &tabela->indice);
+    copiarIndice(&indiceSuspeitos, &tabela->indiceSuspeitos);
+    size_t capEntradas = tabela->quantidade > HASH_CAPACIDADE_INICIAL ? tabela->quantidade
+                                                                      : HASH_CAPACIDADE_INICIAL;
+    uint32_t capSuspeitos = tabela->nSuspeitos > 16 ? tabela->nSuspeitos : 16;
+    HashNode *entradas = (HashNode*) malloc(capEntradas * sizeof(HashNode));
+    IdTexto *suspeitos = (IdTexto*) malloc(capSuspeitos * sizeof(IdTexto));
+    if (!entradas || !suspeitos) { fprintf(stderr, "Erro: malloc tabela\n"); exit(1); }
+    alocacoesHeap += 2;
+    memcpy(entradas, tabela->entradas, tabela->quantidade * sizeof(HashNode));
+    memcpy(suspeitos, tabela->suspeitos, tabela->nSuspeitos * sizeof(IdTexto));
+    if (tabela->pilotos) {
+        uint32_t *pilotos = (uint32_t*) malloc(tabela->nBaldes * sizeof(uint32_t));
+        if (!pilotos) { fprintf(stderr, "Erro: malloc tabela\n"); exit(1); }
+        alocacoesHeap++;
+        memcpy(pilotos, tabela->pilotos, tabela->nBaldes * sizeof(uint32_t));
+        tabela->pilotos = pilotos;
+    }
+    IndiceInverso *inv = &tabela->inverso;
+    inv->primeiroBloco = (uint32_t*) duplicarVetor(inv->primeiroBloco,
+                                                   inv->primeiroBloco ? (inv->nSuspeitos + 1) * sizeof(uint32_t) : 0);
+    inv->blocos = (BlocoPistas*) duplicarVetor(inv->blocos, inv->nBlocos * sizeof(BlocoPistas));
+    inv->dados = (uint16_t*) duplicarVetor(inv->dados, inv->tamDados * sizeof(uint16_t));
+    tabela->grupos = (uint32_t*) duplicarVetor(tabela->grupos, tabela->tamGrupos * sizeof(uint32_t));
+    tabela->capGrupos = tabela->tamGrupos;
+    tabela->posteriores = (HashNode*) duplicarVetor(tabela->posteriores, tabela->nPosteriores * sizeof(HashNode));
+    tabela->capPosteriores = tabela->nPosteriores;
+    if (tabela->filtro.nBlocos) {
+        size_t bytes = (size_t)tabela->filtro.nBlocos * PALAVRAS_FILTRO * sizeof(uint64_t);
+        uint64_t *blocos = (uint64_t*) aligned_alloc(64, bytes);
+        if (!blocos) { fprintf(stderr, "Erro: malloc tabela\n"); exit(1); }
+        alocacoesHeap++;
+        memcpy(blocos, tabela->filtro.blocos, bytes);
+        tabela->filtro.blocos = blocos;
+    }
+    tabela->indice = indice;
+    tabela->indiceSuspeitos = indiceSuspeitos;
+    tabela->entradas = entradas;
+    tabela->capEntradas = capEntradas;
+    tabela->suspeitos = suspeitos;
+    tabela->capSuspeitos = capSuspeitos;
+    tabela->emprestada = 0;
+}
+
+// Posição do suspeito, cadastrando-o se for novo.
+static uint32_t cadastrarSuspeito(TabelaHash *tabela, IdTexto suspeito) {
+    long k = indiceDoSuspeito(tabela, suspeito);
+    if (k >= 0) return (uint32_t)k;
+    if ((size_t)(tabela->nSuspeitos + 1) * 8 > tabela->indiceSuspeitos.capacidade * 7) {
+        size_t cap = tabela->indiceSuspeitos.capacidade * 2;
+        liberarIndice(&tabela->indiceSuspeitos);
+        alocarIndice(&tabela->indiceSuspeitos, cap);
+        for (uint32_t i = 0; i < tabela->nSuspeitos; ++i)
+            indiceColocar(&tabela->indiceSuspeitos, espalharHash(tabela->suspeitos[i]), i);
+    }
+    if (tabela->nSuspeitos == tabela->capSuspeitos) {
+        tabela->capSuspeitos = tabela->capSuspeitos ? tabela->capSuspeitos * 2 : 16;
+        tabela->suspeitos = (IdTexto*) realloc(tabela->suspeitos, tabela->capSuspeitos * sizeof(IdTexto));
+        if (!tabela->suspeitos) { fprintf(stderr, "Erro: realloc suspeitos\n"); exit(1); }
+        alocacoesHeap++;
+    }
+    tabela->suspeitos[tabela->nSuspeitos] = suspeito;
+    indiceColocar(&tabela->indiceSuspeitos, espalharHash(suspeito), tabela->nSuspeitos);
+    return tabela->nSuspeitos++;
+}
+
+// Suspeitos de uma entrada: o próprio campo ou a lista em 'grupos'.
+static inline const uint32_t* suspeitosDaEntrada(const TabelaHash *tabela, const HashNode *e,
+                                                 uint32_t *n) {
+    if (!(e->suspeito & SUSPEITOS_VARIOS)) {
+        *n = 1;
+        return &e->suspeito;
+    }
+    const uint32_t *g = tabela->grupos + (e->suspeito & ~SUSPEITOS_VARIOS);
+    *n = g[0];
+    return g + 1;
+}
+
+// Acrescenta o suspeito k à entrada; a lista antiga fica para trás
+// em 'grupos' (pistas com vários suspeitos são poucas). Retorna 0
+// se o par já existia.
+static int acrescentarSuspeito(TabelaHash *tabela, HashNode *e, uint32_t k) {
+    uint32_t n;
+    const uint32_t *lista = suspeitosDaEntrada(tabela, e, &n);
+    for (uint32_t i = 0; i < n; ++i)
+        if (lista[i] == k) return 0;
+    uint32_t primeiro = lista[0];
+    uint32_t antigo = e->suspeito & SUSPEITOS_VARIOS ? (e->suspeito & ~SUSPEITOS_VARIOS) + 1 : UINT32_MAX;
+    if ((uint64_t)tabela->tamGrupos + n + 2 > SUSPEITOS_VARIOS) {
+        fprintf(stderr, "Erro: listas de suspeitos demais\n");
+        exit(1);
+    }
+    if (tabela->tamGrupos + n + 2 > tabela->capGrupos) {
+        uint32_t cap = tabela->capGrupos ? tabela->capGrupos : 64;
+        while (cap < tabela->tamGrupos + n + 2) cap *= 2;
+        tabela->grupos = (uint32_t*) realloc(tabela->grupos, cap * sizeof(uint32_t));
+        if (!tabela->grupos) { fprintf(stderr, "Erro: realloc grupos\n"); exit(1); }
+        alocacoesHeap++;
+        tabela->capGrupos = cap;
+    }
+    uint32_t *g = tabela->grupos + tabela->tamGrupos;
+    g[0] = n + 1;
+    if (antigo == UINT32_MAX) g[1] = primeiro;
+    else memcpy(g + 1, tabela->grupos + antigo, n * sizeof(uint32_t));
+    g[n + 1] = k;
+    e->suspeito = SUSPEITOS_VARIOS | tabela->tamGrupos;
+    tabela->tamGrupos += n + 2;
+    return 1;
+}
+
+// Guarda o par em 'posteriores' até o próximo congelarHash().
+static void registrarPosterior(TabelaHash *tabela, IdTexto pista, uint32_t k) {
+    if (tabela->nPosteriores == tabela->capPosteriores) {
+        tabela->capPosteriores = tabela->capPosteriores ? tabela->capPosteriores * 2 : 16;
+        tabela->posteriores = (HashNode*) realloc(tabela->posteriores,
+                                                  tabela->capPosteriores * sizeof(HashNode));
+        if (!tabela->posteriores) { fprintf(stderr, "Erro: realloc posteriores\n"); exit(1); }
+        alocacoesHeap++;
+    }
+    tabela->posteriores[tabela->nPosteriores++] = (HashNode){ pista, k };
+}
+
+// -----------------------------
+// inserirNaHashId()
+// Insere associação pista -> suspeito (ids do pool).
+// Uma pista pode apontar para vários suspeitos: cada par novo é
+// acrescentado, e repetir um par não muda nada.
+// Dobra o índice ao passar de 7/8 de ocupação.
+// -----------------------------
+void inserirNaHashId(TabelaHash *tabela, IdTexto pista, IdTexto suspeito) {
+    if (pista == TEXTO_NENHUM || suspeito == TEXTO_NENHUM) return;
+    if (tabela->emprestada) tornarTabelaPropria(tabela);
+    uint32_t k = cadastrarSuspeito(tabela, suspeito);
+    long existente = buscarEntrada(tabela, pista);
+    if (existente >= 0) {
+        if (acrescentarSuspeito(tabela, &tabela->entradas[existente], k))
+            registrarPosterior(tabela, pista, k);
+        return;
+    }
+    if ((tabela->quantidade - tabela->nFixas + 1) * 8 > tabela->indice.capacidade * 7) {
+        size_t cap = tabela->indice.capacidade * 2;
+        liberarIndice(&tabela->indice);
+        alocarIndice(&tabela->indice, cap);
+        for (size_t e = tabela->nFixas; e < tabela->quantidade; ++e)
+            indiceColocar(&tabela->indice, espalharHash(tabela->entradas[e].pista), (uint32_t)e);
+    }
+    if (tabela->quantidade == tabela->capEntradas) {
+        size_t nova = tabela->capEntradas ? tabela->capEntradas * 2 : HASH_CAPACIDADE_INICIAL;
+        HashNode *e = (HashNode*) realloc(tabela->entradas, nova * sizeof(HashNode));
+        if (!e) { fprintf(stderr, "Erro: realloc inserirNaHash\n"); exit(1); }
+        alocacoesHeap++;
+        tabela->entradas = e;
+        tabela->capEntradas = nova;
+    }
+    HashNode *n = &tabela->entradas[tabela->quantidade];
+    n->pista = pista;
+    n->suspeito = k;
+    indiceColocar(&tabela->indice, espalharHash(pista), (uint32_t)tabela->quantidade++);
+    registrarPosterior(tabela, pista, k);
+    // o filtro nasce no congelamento; depois, acompanha as inserções
+    // e dobra quando passa da capacidade para que foi dimensionado
+    FiltroPistas *f = &tabela->filtro;
+    if (f->nBlocos) {
+        if ((size_t)f->pistas + 1 > (size_t)f->nBlocos * PISTAS_POR_BLOCO_FILTRO)
+            construirFiltro(tabela, tabela->quantidade * 2);
+        else
+            marcarNoFiltro(f, hashFixo(pista, tabela->semente));
+    }
+}
+
+// -----------------------------
+// inserirNaHash()
+// Insere associação pista -> suspeito na tabela hash,
+// internando os dois textos.
+// -----------------------------
+void inserirNaHash(TabelaHash *tabela, const char *pista, const char *suspeito) {
+    if (!pista || pista[0] == '\0' || !suspeito) return;
+    inserirNaHashId(tabela, internar(pista), internar(suspeito));
+}
+
+static int compararU32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void liberarInverso(IndiceInverso *inv) {
+    free(inv->primeiroBloco);
+    free(inv->blocos);
+    free(inv->dados);
+    memset(inv, 0, sizeof(*inv));
+}
+
+// Refaz 'inverso' com todas as associações e esvazia 'posteriores'.
+// As pistas são agrupadas por suspeito (contagem), ordenadas dentro
+// de cada grupo e cortadas em blocos pelos 16 bits altos; uma
+// primeira passada mede os blocos e os dados, a segunda os grava.
+static void construirInverso(TabelaHash *tabela) {
+    IndiceInverso *inv = &tabela->inverso;
+    liberarInverso(inv);
+    tabela->nPosteriores = 0;
+    uint32_t nS = tabela->nSuspeitos;
+    if (nS == 0) return;
+    uint32_t *inicio = (uint32_t*) calloc(nS + 1, sizeof(uint32_t));
+    if (!inicio) { fprintf(stderr, "Erro: malloc indice inverso\n"); exit(1); }
+    size_t pares = 0;
+    for (size_t e = 0; e < tabela->quantidade; ++e) {
+        uint32_t n;
+        const uint32_t *lista = suspeitosDaEntrada(tabela, &tabela->entradas[e], &n);
+        for (uint32_t i = 0; i < n; ++i) inicio[lista[i] + 1]++;
+        pares += n;
+    }
+    for (uint32_t k = 0; k < nS; ++k) inicio[k + 1] += inicio[k];
+    IdTexto *ids = (IdTexto*) malloc((pares ? pares : 1) * sizeof(IdTexto));
+    uint32_t *proximo = (uint32_t*) malloc(nS * sizeof(uint32_t));
+    if (!ids || !proximo) { fprintf(stderr, "Erro: malloc indice inverso\n"); exit(1); }
+    memcpy(proximo, inicio, nS * sizeof(uint32_t));
+    for (size_t e = 0; e < tabela->quantidade; ++e) {
+        uint32_t n;
+        const uint32_t *lista = suspeitosDaEntrada(tabela, &tabela->entradas[e], &n);
+        for (uint32_t i = 0; i < n; ++i) ids[proximo[lista[i]]++] = tabela->entradas[e].pista;
+    }
+    free(proximo);
+
+    uint32_t nBlocos = 0;
+    uint64_t tamDados = 0;
+    for (uint32_t k = 0; k < nS; ++k) {
+        qsort(ids + inicio[k], inicio[k + 1] - inicio[k], sizeof(IdTexto), compararU32);
+        for (uint32_t i = inicio[k], j; i < inicio[k + 1]; i = j) {
+            for (j = i; j < inicio[k + 1] && ids[j] >> 16 == ids[i] >> 16; ++j) { }
+            nBlocos++;
+            if (j - i > BLOCO_VETOR_MAXIMO) tamDados = (tamDados + 3) / 4 * 4 + PALAVRAS_POR_BLOCO * 4;
+            else tamDados += j - i;
+        }
+    }
+    inv->primeiroBloco = (uint32_t*) malloc((nS + 1) * sizeof(uint32_t));
+    inv->blocos = (BlocoPistas*) malloc((nBlocos ? nBlocos : 1) * sizeof(BlocoPistas));
+    inv->dados = (uint16_t*) calloc(tamDados ? tamDados : 1, sizeof(uint16_t));
+    if (!inv->primeiroBloco || !inv->blocos || !inv->dados) {
+        fprintf(stderr, "Erro: malloc indice inverso\n");
+        exit(1);
+    }
+    alocacoesHeap += 3;
+    inv->nSuspeitos = nS;
+    inv->nBlocos = nBlocos;
+    inv->tamDados = tamDados;
+    uint32_t b = 0;
+    uint64_t d = 0;
+    for (uint32_t k = 0; k < nS; ++k) {
+        inv->primeiroBloco[k] = b;
+        for (uint32_t i = inicio[k], j; i < inicio[k + 1]; i = j) {
+            for (j = i; j < inicio[k + 1] && ids[j] >> 16 == ids[i] >> 16; ++j) { }
+            BlocoPistas *bl = &inv->blocos[b++];
+            bl->alto = (uint16_t)(ids[i] >> 16);
+            bl->n = j - i;
+            bl->denso = bl->n > BLOCO_VETOR_MAXIMO;
+            if (bl->denso) {
+                d = (d + 3) / 4 * 4;
+                uint64_t *mapa = (uint64_t*)(void*)(inv->dados + d);
+                for (uint32_t x = i; x < j; ++x) mapa[(ids[x] & 0xFFFF) / 64] |= 1ull << (ids[x] % 64);
+                bl->inicio = d;
+                d += PALAVRAS_POR_BLOCO * 4;
+            } else {
+                for (uint32_t x = i; x < j; ++x) inv->dados[d + x - i] = (uint16_t)ids[x];
+                bl->inicio = d;
+                d += bl->n;
+            }
+        }
+    }
+    inv->primeiroBloco[nS] = b;
+    free(ids);
+    free(inicio);
+}
+
+// -----------------------------
+// congelarHash()
+// Passa todas as associações atuais para o hash perfeito mínimo
+// (as entradas são reordenadas) e para o índice inverso, e esvazia
+// o índice aberto, que segue recebendo só o que for inserido depois.
+// Tabelas grandes ganham também o filtro de Bloom. Chamada quando o
+// caso está completo: ao montar a mansão embutida e ao converter
+// uma descrição para .dqm. Baldes são resolvidos do maior para o
+// menor; se algum não encontrar deslocamento, troca a semente.
+// -----------------------------
+void congelarHash(TabelaHash *tabela) {
+    if (tabela->emprestada) tornarTabelaPropria(tabela);
+    uint32_t n = (uint32_t)tabela->quantidade;
+    free(tabela->pilotos);
+    tabela->pilotos = NULL;
+    tabela->nBaldes = tabela->nFixas = 0;
+    liberarIndice(&tabela->indice);
+    alocarIndice(&tabela->indice, HASH_CAPACIDADE_INICIAL);
+    construirInverso(tabela);
+    liberarFiltro(&tabela->filtro);
+    if (n == 0) return;
+
+    uint32_t nBaldes = (n + PERFEITO_CHAVES_POR_BALDE - 1) / PERFEITO_CHAVES_POR_BALDE;
+    uint64_t *hashes = (uint64_t*) malloc(n * sizeof(uint64_t));
+    uint32_t *inicio = (uint32_t*) malloc((nBaldes + 1) * sizeof(uint32_t));  // balde -> 1ª posição em 'chaves'
+    uint32_t *chaves = (uint32_t*) malloc(n * sizeof(uint32_t));              // entradas agrupadas por balde
+    uint32_t *ordem = (uint32_t*) malloc(nBaldes * sizeof(uint32_t));         // baldes, maiores primeiro
+    uint32_t *slots = (uint32_t*) malloc(n * sizeof(uint32_t));               // entrada -> posição final
+    uint64_t *ocupado = (uint64_t*) malloc(((n + 63) / 64) * sizeof(uint64_t));
+    uint32_t *pilotos = (uint32_t*) malloc(nBaldes * sizeof(uint32_t));
+    if (!hashes || !inicio || !chaves || !ordem || !slots || !ocupado || !pilotos) {
+        fprintf(stderr, "Erro: malloc congelarHash\n");
+        exit(1);
+    }
+    alocacoesHeap += 7;
+    uint64_t limite = (uint64_t)n * 64 + 1024;   // deslocamentos tentados por balde
+    if (limite > UINT32_MAX) limite = UINT32_MAX;
+    uint64_t semente;
+    for (uint32_t tentativa = 0; ; ++tentativa) {
+        semente = misturar64(0x4451ull + tentativa);
+        memset(inicio, 0, (nBaldes + 1) * sizeof(uint32_t));
+        for (uint32_t e = 0; e < n; ++e) {
+            hashes[e] = hashFixo(tabela->entradas[e].pista, semente);
+            inicio[reduzir32(hashes[e] >> 32, nBaldes)]++;
+        }
+        uint32_t maior = 0;
+        for (uint32_t b = 0; b < nBaldes; ++b) {
+            if (inicio[b] > maior) maior = inicio[b];
+            if (b) inicio[b] += inicio[b - 1];
+        }
+        inicio[nBaldes] = n;
+        for (uint32_t e = n; e-- > 0; )
+            chaves[--inicio[reduzir32(hashes[e] >> 32, nBaldes)]] = e;
+        uint32_t nOrdem = 0;
+        for (uint32_t tam = maior; tam > 0; --tam)
+            for (uint32_t b = 0; b < nBaldes; ++b)
+                if (inicio[b + 1] - inicio[b] == tam) ordem[nOrdem++] = b;
+
+        memset(ocupado, 0, ((n + 63) / 64) * sizeof(uint64_t));
+        memset(pilotos, 0, nBaldes * sizeof(uint32_t));
+        int ok = 1;
+        for (uint32_t i = 0; i < nOrdem && ok; ++i) {
+            uint32_t b = ordem[i], de = inicio[b], ate = inicio[b + 1];
+            uint64_t p;
+            for (p = 0; p < limite; ++p) {
+                uint32_t k = de;
+                for (; k < ate; ++k) {
+                    uint32_t sl = slotFixo(hashes[chaves[k]], (uint32_t)p, n);
+                    if (ocupado[sl >> 6] >> (sl & 63) & 1) break;
+                    ocupado[sl >> 6] |= 1ull << (sl & 63);
+                    slots[chaves[k]] = sl;
+                }
+                if (k == ate) break;
+                while (k-- > de) ocupado[slots[chaves[k]] >> 6] &= ~(1ull << (slots[chaves[k]] & 63));
+            }
+            if (p == limite) ok = 0;
+            else pilotos[b] = (uint32_t)p;
+        }
+        if (ok) break;
+    }
+
+    HashNode *novas = (HashNode*) malloc(tabela->capEntradas * sizeof(HashNode));
+    if (!novas) { fprintf(stderr, "Erro: malloc congelarHash\n"); exit(1); }
+    alocacoesHeap++;
+    for (uint32_t e = 0; e < n; ++e) novas[slots[e]] = tabela->entradas[e];
+    free(tabela->entradas);
+    tabela->entradas = novas;
+    tabela->pilotos = pilotos;
+    tabela->nBaldes = nBaldes;
+    tabela->nFixas = n;
+    tabela->semente = semente;
+    free(hashes); free(inicio); free(chaves); free(ordem); free(slots); free(ocupado);
+    size_t bytesTabela = (size_t)nBaldes * sizeof(uint32_t) + (size_t)n * sizeof(HashNode);
+    if (bytesTabela >= FILTRO_MINIMO_BYTES) construirFiltro(tabela, n);
+}
+
+// -----------------------------
+// suspeitosDaPista()
+// Posições dos suspeitos associados a uma pista, na ordem em que
+// foram associados; *lista aponta para dentro da tabela.
+// Retorna quantos são (0 se a pista não está na tabela).
+// -----------------------------
+uint32_t suspeitosDaPista(const TabelaHash *tabela, IdTexto pista, const uint32_t **lista) {
+    long e = pista != TEXTO_NENHUM ? buscarEntrada(tabela, pista) : -1;
+    if (e < 0) return 0;
+    uint32_t n;
+    *lista = suspeitosDaEntrada(tabela, &tabela->entradas[e], &n);
+    return n;
+}
+
+// -----------------------------
+// suspeitoDaPista()
+// Posição densa do primeiro suspeito associado a uma pista, ou -1.
+// -----------------------------
+long suspeitoDaPista(const TabelaHash *tabela, IdTexto pista) {
+    const uint32_t *lista;
+    return suspeitosDaPista(tabela, pista, &lista) ? (long)lista[0] : -1;
+}
+
+// Contagem de bits de uma palavra. Sem a instrução popcnt (x86-64
+// básico) o compilador chamaria uma rotina da biblioteca; a soma
+// em paralelo (SWAR) fica no registrador e o laço vetoriza.
+static inline uint32_t contarBits64(uint64_t x) {
+#if defined(__POPCNT__) || !defined(__x86_64__)
+    return (uint32_t)__builtin_popcountll(x);
+#else
+    x -= (x >> 1) & 0x5555555555555555ull;
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (uint32_t)((x * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+// Pistas do bloco com o bit ligado em 'bits' (nPalavras palavras,
+// um bit por id de pista).
+static uint32_t contarBlocoEm(const IndiceInverso *inv, const BlocoPistas *b,
+                              const uint64_t *bits, uint32_t nPalavras) {
+    uint32_t base = (uint32_t)b->alto * PALAVRAS_POR_BLOCO;
+    if (base >= nPalavras) return 0;
+    uint32_t c = 0;
+    if (b->denso) {
+        const uint64_t *mapa = (const uint64_t*)(const void*)(inv->dados + b->inicio);
+        const uint64_t *s = bits + base;
+        uint32_t lim = nPalavras - base < PALAVRAS_POR_BLOCO ? nPalavras - base : PALAVRAS_POR_BLOCO;
+        for (uint32_t i = 0; i < lim; ++i) c += contarBits64(mapa[i] & s[i]);
+    } else {
+        const uint16_t *v = inv->dados + b->inicio;
+        for (uint32_t i = 0; i < b->n; ++i) {
+            uint32_t palavra = base + v[i] / 64;
+            if (palavra >= nPalavras) break;
+            c += (uint32_t)(bits[palavra] >> (v[i] % 64) & 1);
+        }
+    }
+    return c;
+}
+
+// -----------------------------
+// pontuarSuspeitos()
+// contagens[k] = pistas ligadas em 'bits' (um bit por id de pista,
+// nBits múltiplo de 64) que apontam para o suspeito k, para todos
+// os nSuspeitos de uma vez: uma passada pelos blocos do índice
+// inverso, mais os pares incluídos depois do congelamento.
+// -----------------------------
+void pontuarSuspeitos(const TabelaHash *tabela, const uint64_t *bits, uint32_t nBits,
+                      uint32_t *contagens) {
+    const IndiceInverso *inv = &tabela->inverso;
+    uint32_t nPalavras = nBits / 64;
+    memset(contagens, 0, tabela->nSuspeitos * sizeof(uint32_t));
+    for (uint32_t k = 0; k < inv->nSuspeitos; ++k)
+        for (uint32_t b = inv->primeiroBloco[k]; b < inv->primeiroBloco[k + 1]; ++b)
+            contagens[k] += contarBlocoEm(inv, &inv->blocos[b], bits, nPalavras);
+    for (uint32_t i = 0; i < tabela->nPosteriores; ++i) {
+        IdTexto p = tabela->posteriores[i].pista;
+        if (p / 64 < nPalavras && (bits[p / 64] >> (p % 64) & 1))
+            contagens[tabela->posteriores[i].suspeito]++;
+    }
+}
+
+// -----------------------------
+// contarPistasDoSuspeito()
+// Como pontuarSuspeitos(), só para o suspeito k.
+// -----------------------------
+uint32_t contarPistasDoSuspeito(const TabelaHash *tabela, uint32_t k, const uint64_t *bits,
+                                uint32_t nBits) {
+    const IndiceInverso *inv = &tabela->inverso;
+    uint32_t nPalavras = nBits / 64, c = 0;
+    if (k < inv->nSuspeitos)
+        for (uint32_t b = inv->primeiroBloco[k]; b < inv->primeiroBloco[k + 1]; ++b)
+            c += contarBlocoEm(inv, &inv->blocos[b], bits, nPalavras);
+    for (uint32_t i = 0; i < tabela->nPosteriores; ++i) {
+        IdTexto p = tabela->posteriores[i].pista;
+        if (tabela->posteriores[i].suspeito == k && p / 64 < nPalavras && (bits[p / 64] >> (p % 64) & 1))
+            c++;
+    }
+    return c;
+}
+
+// -----------------------------
+// listarPistasDoSuspeito()
+// Grava até 'max' pistas que apontam para o suspeito k, em ordem
+// de id (as incluídas depois do congelamento vêm no fim). Com
+// 'filtro' (um bit por id, nBits bits), só as que estão ligadas
+// nele. Retorna quantas gravou.
+// -----------------------------
+size_t listarPistasDoSuspeito(const TabelaHash *tabela, uint32_t k, const uint64_t *filtro,
+                              uint32_t nBits, IdTexto *saida, size_t max) {
+    const IndiceInverso *inv = &tabela->inverso;
+    size_t n = 0;
+#define ACEITA(id) (!filtro || ((id) / 64 < nBits / 64 && (filtro[(id) / 64] >> ((id) % 64) & 1)))
+    if (k < inv->nSuspeitos) {
+        for (uint32_t b = inv->primeiroBloco[k]; b < inv->primeiroBloco[k + 1] && n < max; ++b) {
+            const BlocoPistas *bl = &inv->blocos[b];
+            IdTexto base = (IdTexto)bl->alto << 16;
+            if (bl->denso) {
+                const uint64_t *mapa = (const uint64_t*)(const void*)(inv->dados + bl->inicio);
+                for (uint32_t w = 0; w < PALAVRAS_POR_BLOCO && n < max; ++w) {
+                    uint64_t m = mapa[w];
+                    if (filtro) {
+                        uint32_t palavra = base / 64 + w;
+                        m = palavra < nBits / 64 ? m & filtro[palavra] : 0;
+                    }
+                    for (; m && n < max; m &= m - 1) saida[n++] = base + w * 64 + (IdTexto)__builtin_ctzll(m);
+                }
+            } else {
+                const uint16_t *v = inv->dados + bl->inicio;
+                for (uint32_t i = 0; i < bl->n && n < max; ++i)
+                    if (ACEITA(base + v[i])) saida[n++] = base + v[i];
+            }
+        }
+    }
+    for (uint32_t i = 0; i < tabela->nPosteriores && n < max; ++i)
+        if (tabela->posteriores[i].suspeito == k && ACEITA(tabela->posteriores[i].pista))
+            saida[n++] = tabela->posteriores[i].pista;
+#undef ACEITA
+    return n;
+}
+
+// -----------------------------
+// encontrarSuspeitoId()
+// Id do (primeiro) suspeito associado a uma pista, ou TEXTO_NENHUM.
+// -----------------------------
+IdTexto encontrarSuspeitoId(const TabelaHash *tabela, IdTexto pista) {
+    long k = suspeitoDaPista(tabela, pista);
+    return k >= 0 ? tabela->suspeitos[k] : TEXTO_NENHUM;
+}
+
+// -----------------------------
+// encontrarSuspeito()
+// Retorna ponteiro para nome do (primeiro) suspeito associado a
+// uma pista.
+// Se não encontrar, retorna NULL.
+// -----------------------------
+const char* encontrarSuspeito(const TabelaHash *tabela, const char *pista) {
+    IdTexto sus = encontrarSuspeitoId(tabela, buscarTexto(pista));
+    return sus != TEXTO_NENHUM ? textoDe(sus) : NULL;
+}
+
+// -----------------------------
+// estatisticasHash()
+// Fator de carga e comprimento de sondagem (em grupos) de
+// cada chave do índice aberto e, para buscas sem sucesso, a
+// média sobre todas as posições iniciais possíveis. As chaves
+// do hash perfeito custam sempre uma sondagem e ficam de fora.
+// Também o tamanho do filtro de Bloom e sua taxa de falsos
+// positivos (1 sem filtro: toda busca chega à tabela).
+// -----------------------------
+void estatisticasHash(const TabelaHash *tabela, EstatisticasHash *est) {
+    const IndiceAberto *ind = &tabela->indice;
+    size_t soma = 0, maxima = 0;
+    for (size_t i = 0; i < ind->capacidade; ++i) {
+        if (ind->ctrl[i] == CTRL_VAZIO) continue;
+        uint64_t m = espalharHash(tabela->entradas[ind->slots[i]].pista);
+        size_t grupos = gruposAteSlot(ind, m, i);
+        soma += grupos;
+        if (grupos > maxima) maxima = grupos;
+    }
+    size_t abertas = tabela->quantidade - tabela->nFixas;
+    est->quantidade = tabela->quantidade;
+    est->fixas = tabela->nFixas;
+    est->capacidade = ind->capacidade;
+    est->fatorCarga = (double)abertas / ind->capacidade;
+    est->sondagemMedia = abertas ? (double)soma / abertas : 0.0;
+    est->sondagemMaxima = maxima;
+    size_t mask = ind->capacidade - 1, somaFalha = 0;
+    for (size_t inicio = 0; inicio < ind->capacidade; ++inicio) {
+        size_t pos = inicio, grupos = 1;
+        for (size_t passo = HASH_GRUPO; !casarGrupo(ind->ctrl, pos, CTRL_VAZIO); passo += HASH_GRUPO) {
+            pos = (pos + passo) & mask;
+            grupos++;
+        }
+        somaFalha += grupos;
+    }
+    est->sondagemMediaFalha = (double)somaFalha / ind->capacidade;
+    // falso positivo de um bloco: produto da fração de bits marcados
+    // em cada palavra; a pista ausente cai num bloco qualquer
+    const FiltroPistas *f = &tabela->filtro;
+    est->bitsFiltro = (size_t)f->nBlocos * PALAVRAS_FILTRO * 64;
+    est->bitsPorPista = f->pistas ? (double)est->bitsFiltro / f->pistas : 0.0;
+    double somaFp = 0.0;
+    for (uint32_t b = 0; b < f->nBlocos; ++b) {
+        double fp = 1.0;
+        for (int i = 0; i < PALAVRAS_FILTRO; ++i)
+            fp *= contarBits64(f->blocos[(size_t)b * PALAVRAS_FILTRO + i]) / 64.0;
+        somaFp += fp;
+    }
+    est->falsoPositivoFiltro = f->nBlocos ? somaFp / f->nBlocos : 1.0;
+}
+
+// -----------------------------
+// Busca textual nas pistas
+// -----------------------------
+
+// Letra sem acento para o segundo byte de "À".."ÿ" (U+00C0..U+00FF,
+// prefixo 0xC3 em UTF-8); 0 mantém o caractere como está.
+static const char semAcento[64] = {
+    'a','a','a','a','a','a', 0 ,'c','e','e','e','e','i','i','i','i',
+     0 ,'n','o','o','o','o','o', 0 ,'o','u','u','u','u','y', 0 , 0 ,
+    'a','a','a','a','a','a', 0 ,'c','e','e','e','e','i','i','i','i',
+     0 ,'n','o','o','o','o','o', 0 ,'o','u','u','u','u','y', 0 ,'y',
+};
+
+// -----------------------------
+// normalizarTexto()
+// Copia 'texto' para 'saida' em minúsculas e sem acentos (letras
+// latinas em UTF-8 viram a letra ASCII base). 'saida' precisa de
+// strlen(texto) + 1 bytes: o resultado nunca é maior. Retorna o
+// comprimento do resultado.
+// -----------------------------
+size_t normalizarTexto(const char *texto, char *saida) {
+    const unsigned char *p = (const unsigned char*) texto;
+    size_t n = 0;
+    while (*p) {
+        if (p[0] == 0xC3 && p[1] >= 0x80 && p[1] <= 0xBF && semAcento[p[1] - 0x80]) {
+            saida[n++] = semAcento[p[1] - 0x80];
+            p += 2;
+        } else {
+            saida[n++] = (char) tolower(*p);
+            p++;
+        }
+    }
+    saida[n] = '\0';
+    return n;
+}
+
+static inline uint32_t trigramaEm(const char *s) {
+    return (uint32_t)(unsigned char)s[0] << 16 | (uint32_t)(unsigned char)s[1] << 8 |
+           (unsigned char)s[2];
+}
+
+// Lista do trigrama, ou NULL.
+static const ListaTrigrama* listaDoTrigrama(const IndiceTexto *ind, uint32_t trigrama) {
+    uint64_t m = espalharHash(trigrama);
+    size_t mask = ind->indice.capacidade - 1;
+    size_t pos = m & mask;
+    for (size_t passo = HASH_GRUPO; ; passo += HASH_GRUPO) {
+        unsigned cand = casarGrupo(ind->indice.ctrl, pos, hashH2(m));
+        while (cand) {
+            uint32_t l = ind->indice.slots[(pos + (size_t)__builtin_ctz(cand)) & mask];
+            if (ind->listas[l].trigrama == trigrama) return &ind->listas[l];
+            cand &= cand - 1;
+        }
+        if (casarGrupo(ind->indice.ctrl, pos, CTRL_VAZIO)) return NULL;
+        pos = (pos + passo) & mask;
+    }
+}
+
+// Lista do trigrama, criando-a se preciso.
+static ListaTrigrama* garantirLista(IndiceTexto *ind, uint32_t trigrama) {
+    ListaTrigrama *l = (ListaTrigrama*) listaDoTrigrama(ind, trigrama);
+    if (l) return l;
+    if ((size_t)(ind->nListas + 1) * 8 > ind->indice.capacidade * 7) {
+        size_t cap = ind->indice.capacidade * 2;
+        liberarIndice(&ind->indice);
+        alocarIndice(&ind->indice, cap);
+        for (uint32_t i = 0; i < ind->nListas; ++i)
+            indiceColocar(&ind->indice, espalharHash(ind->listas[i].trigrama), i);
+    }
+    if (ind->nListas == ind->capListas) {
+        ind->capListas = ind->capListas ? ind->capListas * 2 : 256;
+        ind->listas = (ListaTrigrama*) realloc(ind->listas, ind->capListas * sizeof(ListaTrigrama));
+        if (!ind->listas) { fprintf(stderr, "Erro: realloc indice textual\n"); exit(1); }
+        alocacoesHeap++;
+    }
+    l = &ind->listas[ind->nListas];
+    memset(l, 0, sizeof(*l));
+    l->trigrama = trigrama;
+    indiceColocar(&ind->indice, espalharHash(trigrama), ind->nListas++);
+    return l;
+}
+
+// -----------------------------
+// iniciarIndiceTexto()
+// -----------------------------
+void iniciarIndiceTexto(IndiceTexto *ind) {
+    memset(ind, 0, sizeof(*ind));
+    alocarIndice(&ind->indice, HASH_CAPACIDADE_INICIAL);
+    inicializarArena(&ind->textos);
+}
+
+// -----------------------------
+// indexarPista()
+// Acrescenta uma pista ao índice: guarda o texto normalizado e
+// anota a pista na lista de cada trigrama dele (uma vez por
+// trigrama, mesmo que ele se repita no texto).
+// -----------------------------
+void indexarPista(IndiceTexto *ind, IdTexto pista) {
+    const char *texto = textoDe(pista);
+    size_t tam = strlen(texto);
+    char *norm = (char*) arenaAlocarAlinhado(&ind->textos, tam + 3, 1);
+    norm[0] = norm[1] = MARCADOR_INICIO;
+    tam = normalizarTexto(texto, norm + 2) + 2;
+    if (ind->n == ind->cap) {
+        ind->cap = ind->cap ? ind->cap * 2 : 256;
+        ind->pistas = (IdTexto*) realloc(ind->pistas, ind->cap * sizeof(IdTexto));
+        ind->normalizados = (const char**) realloc(ind->normalizados, ind->cap * sizeof(const char*));
+        if (!ind->pistas || !ind->normalizados) { fprintf(stderr, "Erro: realloc indice textual\n"); exit(1); }
+        alocacoesHeap += 2;
+    }
+    uint32_t local = ind->n++;
+    ind->pistas[local] = pista;
+    ind->normalizados[local] = norm + 2;
+    for (size_t i = 0; i + 3 <= tam; ++i) {
+        ListaTrigrama *l = garantirLista(ind, trigramaEm(norm + i));
+        if (!l->bits && l->n == l->cap && (uint64_t)l->n * 32 >= ind->n) {
+            // densa: troca o vetor pelo mapa de bits
+            uint32_t palavras = ind->cap / 64 + 1;
+            uint64_t *bits = (uint64_t*) calloc(palavras, sizeof(uint64_t));
+            if (!bits) { fprintf(stderr, "Erro: malloc indice textual\n"); exit(1); }
+            alocacoesHeap++;
+            for (uint32_t k = 0; k < l->n; ++k) bits[l->itens[k] / 64] |= 1ull << (l->itens[k] % 64);
+            free(l->itens);
+            l->itens = NULL;
+            l->bits = bits;
+            l->cap = palavras;
+        }
+        if (l->bits) {
+            if (local / 64 >= l->cap) {
+                uint32_t palavras = l->cap * 2 > local / 64 ? l->cap * 2 : local / 64 + 1;
+                l->bits = (uint64_t*) realloc(l->bits, palavras * sizeof(uint64_t));
+                if (!l->bits) { fprintf(stderr, "Erro: realloc indice textual\n"); exit(1); }
+                alocacoesHeap++;
+                memset(l->bits + l->cap, 0, (palavras - l->cap) * sizeof(uint64_t));
+                l->cap = palavras;
+            }
+            uint64_t bit = 1ull << (local % 64);
+            if (l->bits[local / 64] & bit) continue;
+            l->bits[local / 64] |= bit;
+            l->n++;
+            continue;
+        }
+        if (l->n > 0 && l->itens[l->n - 1] == local) continue;
+        if (l->n == l->cap) {
+            l->cap = l->cap ? l->cap * 2 : 4;
+            l->itens = (uint32_t*) realloc(l->itens, l->cap * sizeof(uint32_t));
+            if (!l->itens) { fprintf(stderr, "Erro: realloc indice textual\n"); exit(1); }
+            alocacoesHeap++;
+        }
+        l->itens[l->n++] = local;
+    }
+}
+
+static inline int temBit(const ListaTrigrama *l, uint32_t x) {
+    return x / 64 < l->cap && (l->bits[x / 64] >> (x % 64) & 1);
+}
+
+#define TRIGRAMAS_POR_CONSULTA 32
+
+// Primeira posição >= x em itens[de..n) (busca exponencial a partir de 'de').
+static uint32_t avancarAte(const ListaTrigrama *l, uint32_t de, uint32_t x) {
+    uint32_t passo = 1, ate = de;
+    while (ate < l->n && l->itens[ate] < x) {
+        de = ate + 1;
+        ate += passo;
+        passo *= 2;
+    }
+    if (ate > l->n) ate = l->n;
+    while (de < ate) {
+        uint32_t meio = de + (ate - de) / 2;
+        if (l->itens[meio] < x) de = meio + 1; else ate = meio;
+    }
+    return de;
+}
+
+// Intersecta as listas dos trigramas de 'chave' (comprimento tam),
+// confere cada candidato contra 'consulta' (como trecho ou como
+// prefixo) e grava até 'max' pistas. Com alguma lista esparsa, a
+// menor delas guia e as demais são testadas (bit ou busca
+// exponencial); só com mapas de bits, faz o E palavra a palavra.
+static size_t buscarPorTrigramas(const IndiceTexto *ind, const char *chave, size_t tam,
+                                 const char *consulta, int prefixo, IdTexto *saida, size_t max) {
+    const ListaTrigrama *esparsas[TRIGRAMAS_POR_CONSULTA], *densas[TRIGRAMAS_POR_CONSULTA];
+    uint32_t pos[TRIGRAMAS_POR_CONSULTA];
+    int nEsparsas = 0, nDensas = 0;
+    for (size_t i = 0; i + 3 <= tam && nEsparsas + nDensas < TRIGRAMAS_POR_CONSULTA; ++i) {
+        const ListaTrigrama *l = listaDoTrigrama(ind, trigramaEm(chave + i));
+        if (!l) return 0;
+        const ListaTrigrama **grupo = l->bits ? densas : esparsas;
+        int *k = l->bits ? &nDensas : &nEsparsas;
+        int repetida = 0;
+        for (int j = 0; j < *k; ++j) repetida |= grupo[j] == l;
+        if (repetida) continue;
+        // inserção ordenada pelo tamanho: as menores eliminam antes
+        int j = (*k)++;
+        while (j > 0 && grupo[j - 1]->n > l->n) { grupo[j] = grupo[j - 1]; --j; }
+        grupo[j] = l;
+    }
+    if (nEsparsas + nDensas == 0) return 0;
+    size_t achadas = 0, tamConsulta = strlen(consulta);
+#define CONFERIR_E_GRAVAR(x) do { \
+        const char *norm_ = ind->normalizados[x]; \
+        if (prefixo ? strncmp(norm_, consulta, tamConsulta) == 0 : strstr(norm_, consulta) != NULL) { \
+            if (saida) saida[achadas] = ind->pistas[x]; \
+            achadas++; \
+        } \
+    } while (0)
+    if (nEsparsas > 0) {
+        for (int j = 0; j < nEsparsas; ++j) pos[j] = 0;
+        for (uint32_t i = 0; i < esparsas[0]->n && achadas < max; ++i) {
+            uint32_t x = esparsas[0]->itens[i];
+            int emTodas = 1;
+            for (int j = 0; j < nDensas && emTodas; ++j) emTodas = temBit(densas[j], x);
+            for (int j = 1; j < nEsparsas && emTodas; ++j) {
+                pos[j] = avancarAte(esparsas[j], pos[j], x);
+                emTodas = pos[j] < esparsas[j]->n && esparsas[j]->itens[pos[j]] == x;
+            }
+            if (emTodas) CONFERIR_E_GRAVAR(x);
+        }
+    } else {
+        uint32_t palavras = densas[0]->cap;
+        for (int j = 1; j < nDensas; ++j) if (densas[j]->cap < palavras) palavras = densas[j]->cap;
+        for (uint32_t w = 0; w < palavras && achadas < max; ++w) {
+            uint64_t e = densas[0]->bits[w];
+            for (int j = 1; j < nDensas && e; ++j) e &= densas[j]->bits[w];
+            while (e && achadas < max) {
+                uint32_t x = w * 64 + (uint32_t)__builtin_ctzll(e);
+                e &= e - 1;
+                CONFERIR_E_GRAVAR(x);
+            }
+        }
+    }
+#undef CONFERIR_E_GRAVAR
+    return achadas;
+}
+
+// Consulta curta demais para trigramas: confere todas as pistas.
+static size_t buscarPorVarredura(const IndiceTexto *ind, const char *consulta, int prefixo,
+                                 IdTexto *saida, size_t max) {
+    size_t achadas = 0, tam = strlen(consulta);
+    for (uint32_t x = 0; x < ind->n && achadas < max; ++x) {
+        const char *norm = ind->normalizados[x];
+        if (prefixo ? strncmp(norm, consulta, tam) != 0 : !strstr(norm, consulta)) continue;
+        if (saida) saida[achadas] = ind->pistas[x];
+        achadas++;
+    }
+    return achadas;
+}
+
+// -----------------------------
+// buscarTrecho()
+// Pistas que contêm 'trecho' (sem diferenciar maiúsculas nem
+// acentos), na ordem em que entraram no índice. Grava até 'max'
+// ids em 'saida'
+// (que pode ser NULL para só contar) e retorna quantas gravou.
+// Trechos de 1 ou 2 letras não têm trigrama e varrem as pistas.
+// -----------------------------
+size_t buscarTrecho(const IndiceTexto *ind, const char *trecho, IdTexto *saida, size_t max) {
+    char *consulta = (char*) malloc(strlen(trecho) + 1);
+    if (!consulta) { fprintf(stderr, "Erro: malloc busca\n"); exit(1); }
+    size_t tam = normalizarTexto(trecho, consulta);
+    size_t achadas = tam >= 3 ? buscarPorTrigramas(ind, consulta, tam, consulta, 0, saida, max)
+                              : buscarPorVarredura(ind, consulta, 0, saida, max);
+    free(consulta);
+    return achadas;
+}
+
+// -----------------------------
+// buscarPrefixo()
+// Como buscarTrecho(), para pistas que começam por 'prefixo'.
+// Os marcadores de início dão trigramas até a prefixos de 1 letra.
+// -----------------------------
+size_t buscarPrefixo(const IndiceTexto *ind, const char *prefixo, IdTexto *saida, size_t max) {
+    char *chave = (char*) malloc(strlen(prefixo) + 3);
+    if (!chave) { fprintf(stderr, "Erro: malloc busca\n"); exit(1); }
+    chave[0] = chave[1] = MARCADOR_INICIO;
+    size_t tam = normalizarTexto(prefixo, chave + 2);
+    size_t achadas = tam > 0 ? buscarPorTrigramas(ind, chave, tam + 2, chave + 2, 1, saida, max)
+                             : buscarPorVarredura(ind, "", 1, saida, max);
+    free(chave);
+    return achadas;
+}
+
+// -----------------------------
+// liberarIndiceTexto()
+// -----------------------------
+void liberarIndiceTexto(IndiceTexto *ind) {
+    for (uint32_t i = 0; i < ind->nListas; ++i) {
+        free(ind->listas[i].itens);
+        free(ind->listas[i].bits);
+    }
+    free(ind->listas);
+    free(ind->pistas);
+    free(ind->normalizados);
+    liberarIndice(&ind->indice);
+    arenaLiberar(&ind->textos);
+    memset(ind, 0, sizeof(*ind));
+}
+
+// -----------------------------
+// Placar: operações
+// -----------------------------
+static void iniciarPlacar(Placar *p, Arena *arena, uint32_t n) {
+    p->n = n;
+    p->contagem = (uint32_t*) arenaAlocar(arena, (n + 1) * sizeof(uint32_t));
+    p->ordem = (uint32_t*) arenaAlocar(arena, (n + 1) * sizeof(uint32_t));
+    p->posicao = (uint32_t*) arenaAlocar(arena, (n + 1) * sizeof(uint32_t));
+    p->capPrimeiro = 8;
+    p->primeiro = (uint32_t*) arenaAlocar(arena, p->capPrimeiro * sizeof(uint32_t));
+    for (uint32_t i = 0; i < n; ++i) {
+        p->contagem[i] = 0;
+        p->ordem[i] = p->posicao[i] = i;
+    }
+    memset(p->primeiro, 0, p->capPrimeiro * sizeof(uint32_t));
+    p->maximo = 0;
+}
+
+// Soma uma pista ao suspeito k.
+static void registrarNoPlacar(Placar *p, Arena *arena, uint32_t k) {
+    uint32_t c = p->contagem[k];
+    if (c + 1 >= p->capPrimeiro) {
+        // cresce na arena (a cópia antiga fica para trás até o fim da sessão)
+        uint32_t cap = p->capPrimeiro * 2;
+        uint32_t *novo = (uint32_t*) arenaAlocar(arena, cap * sizeof(uint32_t));
+        memcpy(novo, p->primeiro, p->capPrimeiro * sizeof(uint32_t));
+        memset(novo + p->capPrimeiro, 0, (cap - p->capPrimeiro) * sizeof(uint32_t));
+        p->primeiro = novo;
+        p->capPrimeiro = cap;
+    }
+    // troca k com o primeiro do bloco de contagem c
+    uint32_t pos = p->posicao[k], alvo = p->primeiro[c];
+    uint32_t outro = p->ordem[alvo];
+    p->ordem[alvo] = k;    p->posicao[k] = alvo;
+    p->ordem[pos] = outro; p->posicao[outro] = pos;
+    p->primeiro[c]++;
+    p->contagem[k] = c + 1;
+    if (c + 1 > p->maximo) p->maximo = c + 1;
+}
+
+// -----------------------------
+// topoDoPlacar()
+// Copia até k suspeitos com mais pistas (contagem > 0) em ordem
+// decrescente. Retorna quantos foram copiados.
+// -----------------------------
+static uint32_t topoDoPlacar(const Placar *p, uint32_t k, uint32_t *saida) {
+    uint32_t n = p->primeiro[0] < k ? p->primeiro[0] : k;
+    memcpy(saida, p->ordem, n * sizeof(uint32_t));
+    return n;
+}
+
+// -----------------------------
+// iniciarSessao()
+// Coloca o jogador na sala inicial do mapa, sem pistas. O placar
+// é dimensionado pelos suspeitos já cadastrados na tabela.
+// -----------------------------
+void iniciarSessao(Sessao *sessao, const Mapa *mapa, const TabelaHash *tabela) {
+    sessao->mapa = mapa;
+    sessao->tabela = tabela;
+    sessao->busca = NULL;
+    inicializarArena(&sessao->arena);
+    iniciarArvorePistas(&sessao->pistas);
+    reiniciarSessao(sessao);
+}
+
+// -----------------------------
+// reiniciarSessao()
+// Volta à sala inicial reaproveitando a arena da sessão.
+// -----------------------------
+void reiniciarSessao(Sessao *sessao) {
+    arenaReiniciar(&sessao->arena);
+    sessao->atual = sessao->mapa->raiz;
+    esvaziarArvorePistas(&sessao->pistas);
+    sessao->pistasColetadas = 0;
+    // começa pequeno e dobra conforme os ids das pistas coletadas, para
+    // que abrir uma sessão não custe proporcional ao tamanho do pool
+    sessao->capColetadas = 256;
+    sessao->coletadas = (uint64_t*) arenaAlocar(&sessao->arena, sessao->capColetadas / 8);
+    memset(sessao->coletadas, 0, sessao->capColetadas / 8);
+    iniciarPlacar(&sessao->placar, &sessao->arena, sessao->tabela->nSuspeitos);
+    if (sessao->busca) {
+        liberarIndiceTexto(sessao->busca);
+        free(sessao->busca);
+        sessao->busca = NULL;
+    }
+}
+
+// -----------------------------
+// pistaJaColetada()
+// 1 se a pista já foi coletada nesta sessão, em O(1).
+// -----------------------------
+int pistaJaColetada(const Sessao *sessao, IdTexto pista) {
+    return pista < sessao->capColetadas &&
+           (sessao->coletadas[pista / 64] >> (pista % 64) & 1u);
+}
+
+// Marca a pista como coletada; retorna 1 se ela era nova.
+static int marcarColetada(Sessao *sessao, IdTexto pista) {
+    if (pista >= sessao->capColetadas) {
+        // cresce na arena, como o placar
+        uint32_t cap = sessao->capColetadas;
+        while (cap <= pista) cap *= 2;
+        uint64_t *novo = (uint64_t*) arenaAlocar(&sessao->arena, cap / 8);
+        memcpy(novo, sessao->coletadas, sessao->capColetadas / 8);
+        memset(novo + sessao->capColetadas / 64, 0, (cap - sessao->capColetadas) / 8);
+        sessao->coletadas = novo;
+        sessao->capColetadas = cap;
+    }
+    uint64_t bit = (uint64_t)1 << (pista % 64);
+    if (sessao->coletadas[pista / 64] & bit) return 0;
+    sessao->coletadas[pista / 64] |= bit;
+    return 1;
+}
+
+// Anota uma pista ainda não coletada: BST, índice textual e um
+// ponto a cada suspeito associado a ela.
+static void anotarPista(Sessao *sessao, IdTexto pista) {
+    if (pista == TEXTO_NENHUM || !marcarColetada(sessao, pista)) return;
+    MEDIR_INICIO(t0);
+    inserirPista(&sessao->pistas, pista);
+    MEDIR_FIM(MET_INSERIR, t0);
+    ALTURA_METRICA(alturaPistas(&sessao->pistas));
+    sessao->pistasColetadas++;
+    if (sessao->busca) indexarPista(sessao->busca, pista);
+    const uint32_t *suspeitos;
+    MEDIR_INICIO(t1);
+    uint32_t n = suspeitosDaPista(sessao->tabela, pista, &suspeitos);
+    MEDIR_FIM(MET_BUSCAR, t1);
+    for (uint32_t i = 0; i < n; ++i)
+        if (suspeitos[i] < sessao->placar.n)
+            registrarNoPlacar(&sessao->placar, &sessao->arena, suspeitos[i]);
+}
+
+// -----------------------------
+// coletarPistaDaSala()
+// Insere na BST a pista da sala atual, se houver e se ainda não
+// foi coletada, e soma um ponto a cada suspeito associado a ela.
+// Retorna o id da pista da sala (ou TEXTO_NENHUM).
+// -----------------------------
+IdTexto coletarPistaDaSala(Sessao *sessao) {
+    IdTexto pista = sessao->mapa->pistas[sessao->atual];
+    anotarPista(sessao, pista);
+    return pista;
+}
+
+// -----------------------------
+// restaurarSessao()
+// Recomeça a sessão já na sala 'sala' com as pistas dadas (ids do
+// pool) coletadas, como ao ler uma foto: BST e placar são refeitos
+// a partir do conjunto. Retorna 0, ou -1 se a sala ou alguma pista
+// não existe nesta mansão.
+// -----------------------------
+int restaurarSessao(Sessao *sessao, uint32_t sala, const IdTexto *pistas, size_t n) {
+    if (sala >= sessao->mapa->nSalas) return -1;
+    for (size_t i = 0; i < n; ++i)
+        if (pistas[i] == TEXTO_NENHUM || pistas[i] >= pool.quantidade) return -1;
+    reiniciarSessao(sessao);
+    sessao->atual = sala;
+    for (size_t i = 0; i < n; ++i) anotarPista(sessao, pistas[i]);
+    return 0;
+}
+
+// -----------------------------
+// pistasContra()
+// Pistas coletadas que apontam para o acusado, em O(1).
+// -----------------------------
+uint32_t pistasContra(const Sessao *sessao, IdTexto acusado) {
+    long k = indiceDoSuspeito(sessao->tabela, acusado);
+    return k >= 0 && (uint32_t)k < sessao->placar.n ? sessao->placar.contagem[k] : 0;
+}
+
+// -----------------------------
+// suspeitoMaisCitado()
+// Posição do suspeito líder do placar, ou -1 sem pistas.
+// -----------------------------
+long suspeitoMaisCitado(const Sessao *sessao) {
+    const Placar *p = &sessao->placar;
+    return p->n > 0 && p->contagem[p->ordem[0]] > 0 ? (long)p->ordem[0] : -1;
+}
+
+// -----------------------------
+// moverSessao()
+// Aplica uma escolha do jogador: 'e' (esq), 'd' (dir) ou 's' (sair).
+// Retorna MOVIMENTO_OK, MOVIMENTO_INVALIDO ou MOVIMENTO_SAIR.
+// -----------------------------
+int moverSessao(Sessao *sessao, char opc) {
+    opc = (char)tolower((unsigned char)opc);
+    const FilhosSala *a = &sessao->mapa->filhos[sessao->atual];
+    // a comparação com nSalas também recusa SALA_NENHUMA
+    if (opc == 'e' && a->esq < sessao->mapa->nSalas) {
+        sessao->atual = a->esq;
+    } else if (opc == 'd' && a->dir < sessao->mapa->nSalas) {
+        sessao->atual = a->dir;
+    } else if (opc == 's') {
+        return MOVIMENTO_SAIR;
+    } else {
+        return MOVIMENTO_INVALIDO;
+    }
+    return MOVIMENTO_OK;
+}
+
+// -----------------------------
+// encerrarSessao()
+// Libera as pistas da sessão.
+// -----------------------------
+void encerrarSessao(Sessao *sessao) {
+    arenaLiberar(&sessao->arena);
+    liberarArvorePistas(&sessao->pistas);
+    sessao->pistasColetadas = 0;
+    if (sessao->busca) {
+        liberarIndiceTexto(sessao->busca);
+        free(sessao->busca);
+        sessao->busca = NULL;
+    }
+}
+
+// Índice textual da sessão; na primeira busca indexa as pistas já
+// coletadas e a partir daí cada coleta o atualiza.
+static const IndiceTexto* indiceDaSessao(Sessao *sessao) {
+    if (!sessao->busca) {
+        sessao->busca = (IndiceTexto*) malloc(sizeof(IndiceTexto));
+        if (!sessao->busca) { fprintf(stderr, "Erro: malloc indice textual\n"); exit(1); }
+        alocacoesHeap++;
+        iniciarIndiceTexto(sessao->busca);
+        CursorPistas cursor;
+        cursorNaPosicao(&cursor, &sessao->pistas, 0);
+        for (IdTexto p; (p = proximaPista(&cursor)) != TEXTO_NENHUM; )
+            indexarPista(sessao->busca, p);
+    }
+    return sessao->busca;
+}
+
+// -----------------------------
+// buscarNasPistas()
+// Pistas coletadas que mencionam 'trecho' (ver buscarTrecho()).
+// -----------------------------
+size_t buscarNasPistas(Sessao *sessao, const char *trecho, IdTexto *saida, size_t max) {
+    return buscarTrecho(indiceDaSessao(sessao), trecho, saida, max);
+}
+
+// -----------------------------
+// buscarPistasPorPrefixo()
+// Pistas coletadas que começam por 'prefixo' (ver buscarPrefixo()).
+// -----------------------------
+size_t buscarPistasPorPrefixo(Sessao *sessao, const char *prefixo, IdTexto *saida, size_t max) {
+    return buscarPrefixo(indiceDaSessao(sessao), prefixo, saida, max);
+}
+
+// -----------------------------
+// Quadro de evidências: inclusão e leitura sem trava
+// -----------------------------
+void iniciarQuadro(QuadroPistas *q) {
+    q->cabeca = (NoQuadro*) calloc(1, sizeof(NoQuadro) + NIVEIS_QUADRO * sizeof(_Atomic(NoQuadro*)));
+    if (!q->cabeca) { fprintf(stderr, "Erro: malloc quadro\n"); exit(1); }
+    q->cabeca->niveis = NIVEIS_QUADRO;
+    for (int i = 0; i < NIVEIS_QUADRO; ++i) atomic_init(&q->cabeca->proximo[i], NULL);
+    atomic_init(&q->quantidade, 0);
+}
+
+// Os nós ficam nas arenas dos detetives: libere-as depois.
+void liberarQuadro(QuadroPistas *q) {
+    free(q->cabeca);
+    q->cabeca = NULL;
+}
+
+void iniciarDetetive(DetetiveQuadro *d, uint64_t semente) {
+    inicializarArena(&d->arena);
+    d->sobra = NULL;
+    d->aleatorio = misturar64(semente) | 1;
+}
+
+void liberarDetetive(DetetiveQuadro *d) {
+    arenaLiberar(&d->arena);
+    d->sobra = NULL;
+}
+
+// Antecessores e sucessores de 'pista' em cada nível; diz se o
+// sucessor no nível 0 já é a própria pista.
+static int localizarNoQuadro(const QuadroPistas *q, IdTexto pista,
+                             NoQuadro **antes, NoQuadro **depois) {
+    NoQuadro *x = q->cabeca;
+    for (int nivel = NIVEIS_QUADRO - 1; nivel >= 0; --nivel) {
+        NoQuadro *prox = atomic_load_explicit(&x->proximo[nivel], memory_order_acquire);
+        while (prox && compararPistas(prox->pista, pista) < 0) {
+            x = prox;
+            prox = atomic_load_explicit(&x->proximo[nivel], memory_order_acquire);
+        }
+        antes[nivel] = x;
+        depois[nivel] = prox;
+    }
+    return depois[0] && depois[0]->pista == pista;
+}
+
+// -----------------------------
+// incluirNoQuadro()
+// Inclui a pista se ainda não estiver no quadro; retorna 1 se foi
+// este detetive que a incluiu. Seguro com qualquer número de
+// detetives e leitores ao mesmo tempo, cada detetive na sua thread.
+// -----------------------------
+int incluirNoQuadro(QuadroPistas *q, DetetiveQuadro *d, IdTexto pista) {
+    if (pista == TEXTO_NENHUM) return 0;
+    NoQuadro *antes[NIVEIS_QUADRO], *depois[NIVEIS_QUADRO];
+    if (localizarNoQuadro(q, pista, antes, depois)) return 0;
+    NoQuadro *n = d->sobra;
+    if (n) {
+        d->sobra = NULL;
+    } else {
+        uint64_t sorteio = proximoAleatorio(&d->aleatorio);
+        uint32_t niveis = 1 + (uint32_t)__builtin_ctzll(sorteio | (1ull << (2 * (NIVEIS_QUADRO - 1)))) / 2;
+        n = (NoQuadro*) arenaAlocar(&d->arena, sizeof(NoQuadro) + niveis * sizeof(_Atomic(NoQuadro*)));
+        n->niveis = niveis;
+    }
+    n->pista = pista;
+    // nível 0: a partir do CAS a pista faz parte do quadro
+    while (1) {
+        for (uint32_t i = 0; i < n->niveis; ++i)
+            atomic_store_explicit(&n->proximo[i], depois[i], memory_order_relaxed);
+        NoQuadro *esperado = depois[0];
+        if (atomic_compare_exchange_strong_explicit(&antes[0]->proximo[0], &esperado, n,
+                                                    memory_order_release, memory_order_relaxed))
+            break;
+        if (localizarNoQuadro(q, pista, antes, depois)) {
+            d->sobra = n;          // outro detetive incluiu a mesma pista
+            return 0;
+        }
+    }
+    atomic_fetch_add_explicit(&q->quantidade, 1, memory_order_relaxed);
+    // níveis de cima, de baixo para cima: ninguém chega a n num nível
+    // antes de ele estar ligado ali, então ajustar n->proximo[nivel]
+    // antes de cada tentativa é seguro
+    for (uint32_t nivel = 1; nivel < n->niveis; ++nivel) {
+        while (1) {
+            NoQuadro *esperado = depois[nivel];
+            atomic_store_explicit(&n->proximo[nivel], esperado, memory_order_relaxed);
+            if (atomic_compare_exchange_strong_explicit(&antes[nivel]->proximo[nivel], &esperado, n,
+                                                        memory_order_release, memory_order_relaxed))
+                break;
+            localizarNoQuadro(q, pista, antes, depois);
+        }
+    }
+    return 1;
+}
+
+// -----------------------------
+// quadroTemPista()
+// Busca sem trava, O(log n) esperado.
+// -----------------------------
+int quadroTemPista(const QuadroPistas *q, IdTexto pista) {
+    NoQuadro *antes[NIVEIS_QUADRO], *depois[NIVEIS_QUADRO];
+    return localizarNoQuadro(q, pista, antes, depois);
+}
+
+uint64_t tamanhoQuadro(const QuadroPistas *q) {
+    return atomic_load_explicit(&q->quantidade, memory_order_relaxed);
+}
+
+// -----------------------------
+// percorrerQuadro()
+// Como percorrerPistas(), sobre o quadro: ordem alfabética pelo
+// nível 0, sem trava. Pistas incluídas durante o percurso aparecem
+// se entrarem à frente do ponto em que ele está.
+// -----------------------------
+size_t percorrerQuadro(const QuadroPistas *q, int (*visitar)(IdTexto pista, void *contexto),
+                       void *contexto) {
+    size_t n = 0;
+    for (NoQuadro *x = atomic_load_explicit(&q->cabeca->proximo[0], memory_order_acquire); x;
+         x = atomic_load_explicit(&x->proximo[0], memory_order_acquire)) {
+        n++;
+        if (visitar(x->pista, contexto)) break;
+    }
+    return n;
+}
+
+// -----------------------------
+// pontuarQuadro()
+// Pistas do quadro contra cada suspeito (contagens[k], para os
+// tabela->nSuspeitos suspeitos), lidas num percurso sem trava.
+// -----------------------------
+void pontuarQuadro(const QuadroPistas *q, const TabelaHash *tabela, uint32_t *contagens) {
+    memset(contagens, 0, tabela->nSuspeitos * sizeof(uint32_t));
+    for (NoQuadro *x = atomic_load_explicit(&q->cabeca->proximo[0], memory_order_acquire); x;
+         x = atomic_load_explicit(&x->proximo[0], memory_order_acquire)) {
+        const uint32_t *lista;
+        uint32_t n = suspeitosDaPista(tabela, x->pista, &lista);
+        for (uint32_t i = 0; i < n; ++i) contagens[lista[i]]++;
+    }
+}
+
+// -----------------------------
+// explorarSalas()
+// Navega pela árvore de salas a partir da sala atual da sessão.
+// Ao entrar em sala: exibe nome, coleta pista (se houver) e
+// insere a pista na BST de pistas (uma vez por pista distinta).
+// O jogador escolhe 'e' (esq), 'd' (dir) ou 's' (sair);
+// fim da entrada também encerra a exploração.
+// -----------------------------
+void explorarSalas(Sessao *sessao) {
+    const Mapa *mapa = sessao->mapa;
+    char opc;
+    // a coleta é parte do movimento (MET_MOVER); desenhar a tela fica
+    // em MET_SAIDA e a espera pelo teclado em MET_ENTRADA
+    int repetida = pistaJaColetada(sessao, mapa->pistas[sessao->atual]);
+    IdTexto pista = coletarPistaDaSala(sessao);
+    while (1) {
+        MEDIR_INICIO(tSaida);
+        const FilhosSala *atual = &mapa->filhos[sessao->atual];
+        printf("\n--- Você entrou em: %s ---\n", textoDe(mapa->nomes[sessao->atual]));
+        if (pista != TEXTO_NENHUM) {
+            printf("%s: \"%s\"\n", repetida ? "Pista já anotada" : "Pista encontrada",
+                   textoDe(pista));
+        } else {
+            printf("Nenhuma pista neste cômodo.\n");
+        }
+
+        // opções
+        printf("\nCaminhos disponíveis:\n");
+        if (atual->esq < mapa->nSalas) printf(" (e) Ir para %s\n", textoDe(mapa->nomes[atual->esq]));
+        if (atual->dir < mapa->nSalas) printf(" (d) Ir para %s\n", textoDe(mapa->nomes[atual->dir]));
+        printf(" (s) Sair e ir ao julgamento\n");
+        printf("Escolha: ");
+        MEDIR_FIM(MET_SAIDA, tSaida);
+        MEDIR_INICIO(tEntrada);
+        if (scanf(" %c", &opc) != 1) opc = 's';
+        MEDIR_FIM(MET_ENTRADA, tEntrada);
+
+        MEDIR_INICIO(t0);
+        ALOCACOES_INICIO(alocacoes);
+        int r = moverSessao(sessao, opc);
+        if (r != MOVIMENTO_SAIR) {
+            repetida = pistaJaColetada(sessao, mapa->pistas[sessao->atual]);
+            pista = coletarPistaDaSala(sessao);
+        }
+        MEDIR_FIM(MET_MOVER, t0);
+        CONTAR_METRICA(CONT_ALOCACOES_MOVIMENTO, alocacoesHeap - alocacoes);
+        if (r == MOVIMENTO_SAIR) {
+            printf("\nExploração encerrada pelo jogador.\n");
+            return;
+        }
+        if (r == MOVIMENTO_INVALIDO)
+            printf("Opção inválida ou caminho inexistente. Tente novamente.\n");
+    }
+}
+
+// -----------------------------
+// verificarSuspeitoFinal()
+// Conta as pistas coletadas que apontam para o suspeito acusado:
+// E entre o conjunto de pistas coletadas da sessão (bitset por id)
+// e as pistas do acusado no índice inverso da tabela, sem passar
+// pela BST nem consultar a tabela pista a pista.
+// acusado é o id do nome no pool (TEXTO_NENHUM nunca casa).
+// Retorna número de pistas que apontam para o acusado.
+// -----------------------------
+int verificarSuspeitoFinal(const Sessao *sessao, IdTexto acusado) {
+    long k = indiceDoSuspeito(sessao->tabela, acusado);
+    if (k < 0) return 0;
+    return (int)contarPistasDoSuspeito(sessao->tabela, (uint32_t)k, sessao->coletadas,
+                                       sessao->capColetadas);
+}
+
+// -----------------------------
+// pistasColetadasContra()
+// Grava até 'max' pistas coletadas que apontam para o suspeito,
+// em ordem de id. Retorna quantas gravou.
+// -----------------------------
+size_t pistasColetadasContra(const Sessao *sessao, IdTexto suspeito, IdTexto *saida, size_t max) {
+    long k = indiceDoSuspeito(sessao->tabela, suspeito);
+    if (k < 0) return 0;
+    return listarPistasDoSuspeito(sessao->tabela, (uint32_t)k, sessao->coletadas,
+                                  sessao->capColetadas, saida, max);
+}
+
+// -----------------------------
+// liberarHash()
+// Libera a tabela hash.
+// -----------------------------
+void liberarHash(TabelaHash *tabela) {
+    if (!tabela->emprestada) {
+        liberarIndice(&tabela->indice);
+        liberarIndice(&tabela->indiceSuspeitos);
+        free(tabela->entradas);
+        free(tabela->suspeitos);
+        free(tabela->pilotos);
+        free(tabela->grupos);
+        free(tabela->posteriores);
+        liberarInverso(&tabela->inverso);
+        liberarFiltro(&tabela->filtro);
+    }
+    memset(tabela, 0, sizeof(*tabela));
+}
+
+// -----------------------------
+// montarMansao()
+// Monta o mapa fixo na arena do mapa e popula a tabela hash com
+// as associações pista -> suspeito, congeladas no hash perfeito.
+// Retorna o Hall de Entrada.
+// -----------------------------
+Sala* montarMansao(Arena *arenaMapa, TabelaHash *tabela) {
+    // Exemplo de mapa:
+    //                 Hall
+    //              /       \
+    //         SalaEstar    Cozinha
+    //         /     \         \
+    //      Jardim  Biblioteca  Despensa
+
+    Sala *hall = criarSala(arenaMapa, "Hall de Entrada", "Pegadas úmidas na passadeira");
+    Sala *salaEstar = criarSala(arenaMapa, "Sala de Estar", "Livro de receitas rasgado");
+    Sala *cozinha = criarSala(arenaMapa, "Cozinha", "Talher faltando no gaveteiro");
+    Sala *jardim = criarSala(arenaMapa, "Jardim", "Pedaço de tecido encharcado");
+    Sala *biblioteca = criarSala(arenaMapa, "Biblioteca", "Página arrancada com anotações");
+    Sala *despensa = criarSala(arenaMapa, "Despensa", "Frasco com resíduo químico");
+
+    hall->esq = salaEstar; hall->dir = cozinha;
+    salaEstar->esq = jardim; salaEstar->dir = biblioteca;
+    cozinha->dir = despensa;
+
+    // associações pré-definidas no código
+    inserirNaHash(tabela, "Pegadas úmidas na passadeira", "Sr. Verde");
+    inserirNaHash(tabela, "Livro de receitas rasgado", "Sra. Rosa");
     inserirNaHash(tabela, "Talher faltando no gaveteiro", "Sr. Azul");
     inserirNaHash(tabela, "Pedaço de tecido encharcado", "Sr. Verde");
     inserirNaHash(tabela, "Página arrancada com anotações", "Sra. Rosa");
     inserirNaHash(tabela, "Frasco com resíduo químico", "Sr. Amarelo");
+    congelarHash(tabela);
+    return hall;
+}
+
+// -----------------------------
+// alocarMapa()
+// Reserva os três vetores de n salas num único bloco (mapa->memoria).
+// -----------------------------
+static void alocarMapa(Mapa *mapa, uint32_t n) {
+    size_t tamFilhos = (size_t)n * sizeof(FilhosSala);
+    size_t tamIds = (size_t)n * sizeof(IdTexto);
+    unsigned char *bloco = (unsigned char*) malloc(tamFilhos + 2 * tamIds + 1);
+    if (!bloco) { fprintf(stderr, "Erro: malloc mapa\n"); exit(1); }
+    mapa->filhos = (const FilhosSala*)(void*) bloco;
+    mapa->pistas = (const IdTexto*)(void*)(bloco + tamFilhos);
+    mapa->nomes = (const IdTexto*)(void*)(bloco + tamFilhos + tamIds);
+    mapa->nSalas = n;
+    mapa->raiz = 0;
+    mapa->memoria = bloco;
+}
+
+// -----------------------------
+// compilarMapa()
+// Converte a árvore de Sala (ponteiros) no mapa achatado, em
+// pré-ordem a partir da raiz, que fica na posição 0.
+// Libere com free(mapa->memoria).
+// -----------------------------
+void compilarMapa(Sala *raiz, Mapa *mapa) {
+    typedef struct { Sala *sala; uint32_t pai; int direita; } Pendente;
+    size_t capPilha = 64, topo = 0;
+    Pendente *pilha = (Pendente*) malloc(capPilha * sizeof(Pendente));
+    if (!pilha) { fprintf(stderr, "Erro: malloc compilarMapa\n"); exit(1); }
+    // primeira passada só conta as salas
+    uint32_t n = 0;
+    if (raiz) pilha[topo++] = (Pendente){ raiz, 0, 0 };
+    while (topo > 0) {
+        Sala *sala = pilha[--topo].sala;
+        n++;
+        if (topo + 2 > capPilha) {
+            capPilha *= 2;
+            pilha = (Pendente*) realloc(pilha, capPilha * sizeof(Pendente));
+            if (!pilha) { fprintf(stderr, "Erro: realloc compilarMapa\n"); exit(1); }
+        }
+        if (sala->dir) pilha[topo++] = (Pendente){ sala->dir, 0, 0 };
+        if (sala->esq) pilha[topo++] = (Pendente){ sala->esq, 0, 0 };
+    }
+    alocarMapa(mapa, n);
+    FilhosSala *filhos = (FilhosSala*) mapa->filhos;
+    IdTexto *pistas = (IdTexto*) mapa->pistas;
+    IdTexto *nomes = (IdTexto*) mapa->nomes;
+    n = 0;
+    if (raiz) pilha[topo++] = (Pendente){ raiz, SALA_NENHUMA, 0 };
+    while (topo > 0) {
+        Pendente p = pilha[--topo];
+        nomes[n] = p.sala->nome;
+        pistas[n] = p.sala->pista;
+        filhos[n].esq = filhos[n].dir = SALA_NENHUMA;
+        if (p.pai != SALA_NENHUMA) {
+            if (p.direita) filhos[p.pai].dir = n; else filhos[p.pai].esq = n;
+        }
+        // direita empilhada primeiro para a esquerda sair antes (pré-ordem)
+        if (p.sala->dir) pilha[topo++] = (Pendente){ p.sala->dir, n, 1 };
+        if (p.sala->esq) pilha[topo++] = (Pendente){ p.sala->esq, n, 0 };
+        n++;
+    }
+    free(pilha);
+}
+
+// Lê o arquivo inteiro (ou stdin) para um buffer terminado em '\0'.
+static char* lerArquivoInteiro(const char *caminho, size_t *tamanho) {
+    FILE *f = strcmp(caminho, "-") == 0 ? stdin : fopen(caminho, "rb");
+    if (!f) { perror(caminho); return NULL; }
+    size_t cap = 1 << 16, usado = 0;
+    char *buf = (char*) malloc(cap);
+    if (!buf) { fprintf(stderr, "Erro: malloc roteiro\n"); exit(1); }
+    size_t lidos;
+    while ((lidos = fread(buf + usado, 1, cap - usado - 1, f)) > 0) {
+        usado += lidos;
+        if (cap - usado - 1 == 0) {
+            cap *= 2;
+            buf = (char*) realloc(buf, cap);
+            if (!buf) { fprintf(stderr, "Erro: realloc roteiro\n"); exit(1); }
+        }
+    }
+    if (f != stdin) fclose(f);
+    buf[usado] = '\0';
+    *tamanho = usado;
+    return buf;
+}
+
+static char* aparar(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    char *fim = s + strlen(s);
+    while (fim > s && isspace((unsigned char)fim[-1])) *--fim = '\0';
+    return s;
+}
+
+// -----------------------------
+// Arquivo binário de mansão (.dqm)
+// Cabeçalho fixo seguido de seções alinhadas a 8 bytes, cada uma
+// no formato usado em memória: os vetores do mapa, a tabela de
+// textos (deslocamentos, bytes, hashes e índice do pool) e os
+// vetores da tabela pista -> suspeitos com o hash perfeito, os
+// índices, o índice inverso suspeito -> pistas e o filtro de Bloom
+// (alinhado a 64 bytes, um bloco por linha de cache). Abrir é mapear
+// o arquivo, conferir o cabeçalho e apontar as estruturas para as
+// seções: nada é lido, copiado nem alocado por nó, e o tempo não
+// depende do tamanho do mapa. O conteúdo é confiado a quem gravou o
+// arquivo; um .dqm de fora deve ser aberto com --verificar, que o
+// confere inteiro antes de usar. Inteiros na ordem de bytes da
+// máquina que gravou o arquivo.
+// -----------------------------
+#define MANSAO_MAGICA "DQMANSAO"
+#define MANSAO_VERSAO 6   // 2: salas em vetores separados (filhos, pistas, nomes)
+                          // 3: associações do caso em hash perfeito (pilotos)
+                          // 4: registra a função de hash dos textos
+                          // 5: vários suspeitos por pista e índice inverso
+                          // 6: filtro de Bloom das pistas
+
+enum {
+    SEC_FILHOS, SEC_PISTAS_SALAS, SEC_NOMES_SALAS, SEC_DESLOCAMENTOS, SEC_TEXTOS, SEC_HASHES,
+    SEC_CTRL_TEXTOS, SEC_SLOTS_TEXTOS,
+    SEC_ENTRADAS, SEC_PILOTOS, SEC_CTRL_PISTAS, SEC_SLOTS_PISTAS,
+    SEC_SUSPEITOS, SEC_CTRL_SUSPEITOS, SEC_SLOTS_SUSPEITOS,
+    SEC_GRUPOS, SEC_PRIMEIRO_BLOCO, SEC_BLOCOS, SEC_DADOS_BLOCOS, SEC_POSTERIORES,
+    SEC_FILTRO,
+    SECOES_MANSAO
+};
+
+typedef struct CabecalhoMansao {
+    char magica[8];
+    uint32_t versao;
+    uint32_t nSalas;
+    uint32_t raiz;
+    uint32_t nTextos;        // ids do pool, incluindo o 0
+    uint32_t nEntradas;      // associações pista -> suspeito
+    uint32_t nSuspeitos;
+    uint32_t nFixas;         // entradas no hash perfeito
+    uint32_t nBaldes;
+    uint32_t hashTextos;     // HASH_TEXTOS de quem gravou (hashes e índice do pool)
+    uint32_t tamGrupos;      // listas de suspeitos, em uint32
+    uint32_t nSuspeitosInverso;
+    uint32_t nBlocos;
+    uint32_t nPosteriores;
+    uint32_t nBlocosFiltro;  // 0: sem filtro
+    uint64_t tamDadosBlocos; // em uint16
+    uint64_t semente;
+    uint64_t capTextos;      // capacidade de cada índice
+    uint64_t capPistas;
+    uint64_t capSuspeitos;
+    uint64_t tamTextos;      // bytes dos textos, com os '\0'
+    uint64_t tamArquivo;
+    uint64_t secao[SECOES_MANSAO];   // deslocamento de cada seção
+} CabecalhoMansao;
+
+static const char *arquivoMansao = NULL;   // --mapa: mansão binária a usar
+static int verificarMansao = 0;            // --verificar: conferir o conteúdo ao abrir
+
+static void tamanhosSecoes(const CabecalhoMansao *c, uint64_t tam[SECOES_MANSAO]) {
+    tam[SEC_FILHOS] = (uint64_t)c->nSalas * sizeof(FilhosSala);
+    tam[SEC_PISTAS_SALAS] = (uint64_t)c->nSalas * sizeof(IdTexto);
+    tam[SEC_NOMES_SALAS] = (uint64_t)c->nSalas * sizeof(IdTexto);
+    tam[SEC_DESLOCAMENTOS] = (uint64_t)c->nTextos * sizeof(uint32_t);
+    tam[SEC_TEXTOS] = c->tamTextos;
+    tam[SEC_HASHES] = (uint64_t)c->nTextos * sizeof(uint64_t);
+    tam[SEC_CTRL_TEXTOS] = c->capTextos + HASH_GRUPO;
+    tam[SEC_SLOTS_TEXTOS] = c->capTextos * sizeof(uint32_t);
+    tam[SEC_ENTRADAS] = (uint64_t)c->nEntradas * sizeof(HashNode);
+    tam[SEC_PILOTOS] = (uint64_t)c->nBaldes * sizeof(uint32_t);
+    tam[SEC_CTRL_PISTAS] = c->capPistas + HASH_GRUPO;
+    tam[SEC_SLOTS_PISTAS] = c->capPistas * sizeof(uint32_t);
+    tam[SEC_SUSPEITOS] = (uint64_t)c->nSuspeitos * sizeof(IdTexto);
+    tam[SEC_CTRL_SUSPEITOS] = c->capSuspeitos + HASH_GRUPO;
+    tam[SEC_SLOTS_SUSPEITOS] = c->capSuspeitos * sizeof(uint32_t);
+    tam[SEC_GRUPOS] = (uint64_t)c->tamGrupos * sizeof(uint32_t);
+    tam[SEC_PRIMEIRO_BLOCO] = c->nSuspeitosInverso ? ((uint64_t)c->nSuspeitosInverso + 1) * sizeof(uint32_t) : 0;
+    tam[SEC_BLOCOS] = (uint64_t)c->nBlocos * sizeof(BlocoPistas);
+    tam[SEC_DADOS_BLOCOS] = c->tamDadosBlocos * sizeof(uint16_t);
+    tam[SEC_POSTERIORES] = (uint64_t)c->nPosteriores * sizeof(HashNode);
+    tam[SEC_FILTRO] = (uint64_t)c->nBlocosFiltro * PALAVRAS_FILTRO * sizeof(uint64_t);
+}
+
+// Seções começam alinhadas a 8 bytes; o filtro, a uma linha de cache.
+static uint64_t alinhamentoSecao(int secao) {
+    return secao == SEC_FILTRO ? 64 : 8;
+}
+
+static int capacidadeValida(uint64_t cap, uint64_t ocupados) {
+    return cap >= HASH_GRUPO && cap <= ((uint64_t)1 << 40) &&
+           (cap & (cap - 1)) == 0 && ocupados < cap;
+}
+
+// Confere o cabeçalho contra o tamanho real do arquivo, em O(1).
+// Retorna NULL se estiver tudo certo ou o motivo da recusa.
+static const char* validarCabecalho(const CabecalhoMansao *c, size_t tamanho) {
+    if (memcmp(c->magica, MANSAO_MAGICA, sizeof(c->magica)) != 0) return "assinatura incorreta";
+    if (c->versao != MANSAO_VERSAO) return "versao nao suportada";
+    if (c->hashTextos != HASH_TEXTOS) return "gravado com outra funcao de hash de textos";
+    if (c->tamArquivo != tamanho) return "tamanho diferente do registrado";
+    if (c->nSalas == 0 || c->raiz >= c->nSalas) return "sala inicial inexistente";
+    if (c->nTextos == 0 || c->tamTextos == 0 || c->tamTextos > UINT32_MAX) return "tabela de textos vazia ou grande demais";
+    if (c->nFixas > c->nEntradas || c->nBaldes > c->nFixas || (c->nFixas != 0) != (c->nBaldes != 0))
+        return "hash perfeito invalido";
+    if (c->nBlocosFiltro && !c->nFixas) return "filtro sem hash perfeito";
+    if (!capacidadeValida(c->capTextos, c->nTextos) ||
+        !capacidadeValida(c->capPistas, c->nEntradas - c->nFixas) ||
+        !capacidadeValida(c->capSuspeitos, c->nSuspeitos))
+        return "capacidade de indice invalida";
+    if (c->nSuspeitosInverso > c->nSuspeitos || c->tamGrupos > SUSPEITOS_VARIOS ||
+        c->tamDadosBlocos > ((uint64_t)1 << 40))
+        return "indice inverso invalido";
+    uint64_t tam[SECOES_MANSAO];
+    tamanhosSecoes(c, tam);
+    for (int i = 0; i < SECOES_MANSAO; ++i) {
+        if (c->secao[i] % alinhamentoSecao(i) != 0 || c->secao[i] < sizeof(CabecalhoMansao) ||
+            c->secao[i] > tamanho || tam[i] > tamanho - c->secao[i])
+            return "secao fora do arquivo";
+    }
+    const char *textos = (const char*)c + c->secao[SEC_TEXTOS];
+    if (textos[c->tamTextos - 1] != '\0') return "textos sem terminador";
+    return NULL;
+}
+
+// Índice aberto de um arquivo: ao menos um byte de controle vazio
+// (senão a sondagem não termina), o espelho do início no fim igual
+// ao original e, nas posições ocupadas, valores abaixo de 'limite'.
+static int indiceDoArquivoValido(const int8_t *ctrl, const uint32_t *slots, uint64_t cap,
+                                 uint32_t limite) {
+    int vazio = 0;
+    for (uint64_t i = 0; i < cap; ++i) {
+        if (ctrl[i] == CTRL_VAZIO) vazio = 1;
+        else if (slots[i] >= limite) return 0;
+    }
+    return vazio && memcmp(ctrl, ctrl + cap, HASH_GRUPO) == 0;
+}
+
+// Suspeito(s) de uma entrada: a posição ou uma lista em 'grupos'
+// inteira dentro da seção, com posições válidas.
+static int suspeitosDoArquivoValidos(const CabecalhoMansao *c, const uint32_t *grupos, uint32_t s) {
+    if (!(s & SUSPEITOS_VARIOS)) return s < c->nSuspeitos;
+    uint32_t inicio = s & ~SUSPEITOS_VARIOS;
+    if (inicio >= c->tamGrupos || grupos[inicio] == 0 || grupos[inicio] > c->tamGrupos - inicio - 1)
+        return 0;
+    for (uint32_t i = 1; i <= grupos[inicio]; ++i)
+        if (grupos[inicio + i] >= c->nSuspeitos) return 0;
+    return 1;
+}
+
+// -----------------------------
+// validarConteudo()
+// Confere, numa passada sequencial pelas seções, tudo o que vira
+// índice de vetor: filhos das salas, ids de texto, deslocamentos,
+// posições guardadas nos índices abertos (que também precisam de
+// um byte vazio), suspeitos das entradas e listas, e os blocos do
+// índice inverso. Pilotos, hashes e filtro podem ter qualquer
+// valor: no pior caso, uma busca não acha o que devia. Lê o arquivo
+// todo, por isso só roda com --verificar.
+// Retorna NULL se estiver tudo certo ou o motivo da recusa.
+// -----------------------------
+static const char* validarConteudo(const CabecalhoMansao *c) {
+    const unsigned char *b = (const unsigned char*) c;
+#define SECAO(tipo, i) ((tipo)(const void*)(b + c->secao[i]))
+    const FilhosSala *filhos = SECAO(const FilhosSala*, SEC_FILHOS);
+    const IdTexto *pistasSalas = SECAO(const IdTexto*, SEC_PISTAS_SALAS);
+    const IdTexto *nomesSalas = SECAO(const IdTexto*, SEC_NOMES_SALAS);
+    for (uint32_t i = 0; i < c->nSalas; ++i) {
+        if ((filhos[i].esq != SALA_NENHUMA && filhos[i].esq >= c->nSalas) ||
+            (filhos[i].dir != SALA_NENHUMA && filhos[i].dir >= c->nSalas))
+            return "sala com filho inexistente";
+        if (pistasSalas[i] >= c->nTextos || nomesSalas[i] >= c->nTextos)
+            return "sala com texto inexistente";
+    }
+    const uint32_t *deslocamentos = SECAO(const uint32_t*, SEC_DESLOCAMENTOS);
+    for (uint32_t i = 0; i < c->nTextos; ++i)
+        if (deslocamentos[i] >= c->tamTextos) return "texto fora da tabela de textos";
+    if (!indiceDoArquivoValido(SECAO(const int8_t*, SEC_CTRL_TEXTOS), SECAO(const uint32_t*, SEC_SLOTS_TEXTOS),
+                               c->capTextos, c->nTextos) ||
+        !indiceDoArquivoValido(SECAO(const int8_t*, SEC_CTRL_PISTAS), SECAO(const uint32_t*, SEC_SLOTS_PISTAS),
+                               c->capPistas, c->nEntradas) ||
+        !indiceDoArquivoValido(SECAO(const int8_t*, SEC_CTRL_SUSPEITOS),
+                               SECAO(const uint32_t*, SEC_SLOTS_SUSPEITOS), c->capSuspeitos, c->nSuspeitos))
+        return "indice hash invalido";
+
+    const uint32_t *grupos = SECAO(const uint32_t*, SEC_GRUPOS);
+    const HashNode *entradas = SECAO(const HashNode*, SEC_ENTRADAS);
+    for (uint32_t i = 0; i < c->nEntradas; ++i)
+        if (entradas[i].pista >= c->nTextos || !suspeitosDoArquivoValidos(c, grupos, entradas[i].suspeito))
+            return "associacao pista -> suspeito invalida";
+    const IdTexto *suspeitos = SECAO(const IdTexto*, SEC_SUSPEITOS);
+    for (uint32_t i = 0; i < c->nSuspeitos; ++i)
+        if (suspeitos[i] >= c->nTextos) return "suspeito com texto inexistente";
+    const HashNode *posteriores = SECAO(const HashNode*, SEC_POSTERIORES);
+    for (uint32_t i = 0; i < c->nPosteriores; ++i)
+        if (posteriores[i].pista >= c->nTextos || posteriores[i].suspeito >= c->nSuspeitos)
+            return "associacao posterior invalida";
+
+    if (c->nSuspeitosInverso) {
+        const uint32_t *primeiro = SECAO(const uint32_t*, SEC_PRIMEIRO_BLOCO);
+        if (primeiro[0] != 0 || primeiro[c->nSuspeitosInverso] != c->nBlocos) return "indice inverso invalido";
+        for (uint32_t k = 0; k < c->nSuspeitosInverso; ++k)
+            if (primeiro[k] > primeiro[k + 1]) return "indice inverso invalido";
+    } else if (c->nBlocos) {
+        return "indice inverso invalido";
+    }
+    const BlocoPistas *blocos = SECAO(const BlocoPistas*, SEC_BLOCOS);
+    const uint16_t *dados = SECAO(const uint16_t*, SEC_DADOS_BLOCOS);
+    for (uint32_t i = 0; i < c->nBlocos; ++i) {
+        const BlocoPistas *bl = &blocos[i];
+        uint64_t base = (uint64_t)bl->alto << 16;
+        if (base >= c->nTextos) return "bloco do indice inverso com pista inexistente";
+        if (bl->denso) {
+            if (bl->inicio % 4 != 0 || bl->inicio > c->tamDadosBlocos ||
+                c->tamDadosBlocos - bl->inicio < PALAVRAS_POR_BLOCO * 4)
+                return "bloco do indice inverso fora dos dados";
+            // bits além da última pista precisam estar desligados
+            const uint64_t *mapa = (const uint64_t*)(const void*)(dados + bl->inicio);
+            uint64_t fim = c->nTextos - base;   // primeiro id local inexistente
+            if (fim < 65536) {
+                if (mapa[fim / 64] >> (fim % 64)) return "bloco do indice inverso com pista inexistente";
+                for (uint64_t w = fim / 64 + 1; w < PALAVRAS_POR_BLOCO; ++w)
+                    if (mapa[w]) return "bloco do indice inverso com pista inexistente";
+            }
+        } else {
+            if (bl->n > BLOCO_VETOR_MAXIMO || bl->inicio > c->tamDadosBlocos ||
+                c->tamDadosBlocos - bl->inicio < bl->n)
+                return "bloco do indice inverso fora dos dados";
+            for (uint32_t j = 0; j < bl->n; ++j)
+                if (base + dados[bl->inicio + j] >= c->nTextos)
+                    return "bloco do indice inverso com pista inexistente";
+        }
+    }
+#undef SECAO
+    return NULL;
+}
+
+// Mapeia o arquivo e aponta mapa, pool e tabela para as seções.
+static void carregarMansao(Mansao *mansao, const char *arquivo) {
+    int fd = open(arquivo, O_RDONLY);
+    if (fd < 0) { perror(arquivo); exit(1); }
+    struct stat st;
+    if (fstat(fd, &st) < 0) { perror(arquivo); exit(1); }
+    size_t tamanho = (size_t)st.st_size;
+    if (tamanho < sizeof(CabecalhoMansao)) {
+        fprintf(stderr, "Erro: mansao binaria invalida (%s): arquivo curto demais\n", arquivo);
+        exit(1);
+    }
+    void *base = mmap(NULL, tamanho, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) { perror("mmap"); exit(1); }
+    const CabecalhoMansao *c = (const CabecalhoMansao*) base;
+    const char *motivo = validarCabecalho(c, tamanho);
+    if (!motivo && verificarMansao) motivo = validarConteudo(c);
+    if (motivo) {
+        fprintf(stderr, "Erro: mansao binaria invalida (%s): %s\n", arquivo, motivo);
+        exit(1);
+    }
+    const unsigned char *b = (const unsigned char*) base;
+#define SECAO(tipo, i) ((tipo)(const void*)(b + c->secao[i]))
+    mansao->arquivo = base;
+    mansao->tamArquivo = tamanho;
+    mansao->mapa.filhos = SECAO(const FilhosSala*, SEC_FILHOS);
+    mansao->mapa.pistas = SECAO(const IdTexto*, SEC_PISTAS_SALAS);
+    mansao->mapa.nomes = SECAO(const IdTexto*, SEC_NOMES_SALAS);
+    mansao->mapa.nSalas = c->nSalas;
+    mansao->mapa.raiz = c->raiz;
+
+    adotarTextosDoArquivo(SECAO(const char*, SEC_TEXTOS), SECAO(const uint32_t*, SEC_DESLOCAMENTOS),
+                          SECAO(const uint64_t*, SEC_HASHES), c->nTextos,
+                          SECAO(const int8_t*, SEC_CTRL_TEXTOS), SECAO(const uint32_t*, SEC_SLOTS_TEXTOS),
+                          c->capTextos);
+
+    // a tabela fica somente leitura; inserir nela faz cópias próprias
+    TabelaHash *t = &mansao->tabela;
+    memset(t, 0, sizeof(*t));
+    t->indice.ctrl = SECAO(int8_t*, SEC_CTRL_PISTAS);
+    t->indice.slots = SECAO(uint32_t*, SEC_SLOTS_PISTAS);
+    t->indice.capacidade = c->capPistas;
+    t->entradas = SECAO(HashNode*, SEC_ENTRADAS);
+    t->quantidade = t->capEntradas = c->nEntradas;
+    t->pilotos = c->nBaldes ? SECAO(uint32_t*, SEC_PILOTOS) : NULL;
+    t->nBaldes = c->nBaldes;
+    t->nFixas = c->nFixas;
+    t->semente = c->semente;
+    t->indiceSuspeitos.ctrl = SECAO(int8_t*, SEC_CTRL_SUSPEITOS);
+    t->indiceSuspeitos.slots = SECAO(uint32_t*, SEC_SLOTS_SUSPEITOS);
+    t->indiceSuspeitos.capacidade = c->capSuspeitos;
+    t->suspeitos = SECAO(IdTexto*, SEC_SUSPEITOS);
+    t->nSuspeitos = t->capSuspeitos = c->nSuspeitos;
+    t->grupos = SECAO(uint32_t*, SEC_GRUPOS);
+    t->tamGrupos = t->capGrupos = c->tamGrupos;
+    t->inverso.nSuspeitos = c->nSuspeitosInverso;
+    t->inverso.nBlocos = c->nBlocos;
+    t->inverso.tamDados = c->tamDadosBlocos;
+    t->inverso.primeiroBloco = c->nSuspeitosInverso ? SECAO(uint32_t*, SEC_PRIMEIRO_BLOCO) : NULL;
+    t->inverso.blocos = SECAO(BlocoPistas*, SEC_BLOCOS);
+    t->inverso.dados = SECAO(uint16_t*, SEC_DADOS_BLOCOS);
+    t->posteriores = SECAO(HashNode*, SEC_POSTERIORES);
+    t->nPosteriores = t->capPosteriores = c->nPosteriores;
+    t->filtro.blocos = c->nBlocosFiltro ? SECAO(uint64_t*, SEC_FILTRO) : NULL;
+    t->filtro.nBlocos = c->nBlocosFiltro;
+    t->filtro.pistas = c->nEntradas;
+    t->emprestada = 1;
+#undef SECAO
+}
+
+// -----------------------------
+// abrirMansao()
+// Com arquivo, mapeia a mansão binária; sem arquivo (NULL), monta
+// a mansão embutida no código. Deve vir antes de qualquer internar().
+// -----------------------------
+void abrirMansao(Mansao *mansao, const char *arquivo) {
+    memset(mansao, 0, sizeof(*mansao));
+    if (arquivo) {
+        carregarMansao(mansao, arquivo);
+        return;
+    }
+    Arena arenaMapa;
+    inicializarArena(&arenaMapa);
+    inicializarHash(&mansao->tabela);
+    Sala *hall = montarMansao(&arenaMapa, &mansao->tabela);
+    compilarMapa(hall, &mansao->mapa);
+    arenaLiberar(&arenaMapa);
+}
+
+// -----------------------------
+// fecharMansao()
+// Libera mapa e tabela (ou desfaz o mapeamento). Os textos do
+// pool adotados do arquivo deixam de valer: depois disso, só
+// liberarPool().
+// -----------------------------
+void fecharMansao(Mansao *mansao) {
+    liberarHash(&mansao->tabela);
+    free(mansao->mapa.memoria);
+    if (mansao->arquivo) munmap(mansao->arquivo, mansao->tamArquivo);
+    memset(mansao, 0, sizeof(*mansao));
+}
+
+static int escreverSecao(FILE *f, CabecalhoMansao *c, int secao, const void *dados,
+                         uint64_t tamanho, uint64_t *posicao) {
+    static const char zeros[64] = { 0 };
+    uint64_t alinhamento = alinhamentoSecao(secao);
+    uint64_t enchimento = (alinhamento - *posicao % alinhamento) % alinhamento;
+    if (enchimento && fwrite(zeros, 1, enchimento, f) != enchimento) return -1;
+    *posicao += enchimento;
+    c->secao[secao] = *posicao;
+    if (tamanho && fwrite(dados, 1, tamanho, f) != tamanho) return -1;
+    *posicao += tamanho;
+    return 0;
+}
+
+// -----------------------------
+// salvarMansao()
+// Grava mapa, tabela hash e o pool inteiro de textos (os ids das
+// salas e da tabela são ids do pool) no formato binário.
+// Retorna 0 em caso de sucesso.
+// -----------------------------
+int salvarMansao(const char *arquivo, const Mapa *mapa, const TabelaHash *tabela) {
+    if (pool.quantidade == 0) inicializarPool();
+    CabecalhoMansao c;
+    memset(&c, 0, sizeof(c));
+    memcpy(c.magica, MANSAO_MAGICA, sizeof(c.magica));
+    c.versao = MANSAO_VERSAO;
+    c.hashTextos = HASH_TEXTOS;
+    c.nSalas = mapa->nSalas;
+    c.raiz = mapa->raiz;
+    c.nTextos = pool.quantidade;
+    c.nEntradas = (uint32_t)tabela->quantidade;
+    c.nSuspeitos = tabela->nSuspeitos;
+    c.nFixas = tabela->nFixas;
+    c.nBaldes = tabela->nBaldes;
+    c.semente = tabela->semente;
+    c.capTextos = pool.indice.capacidade;
+    c.capPistas = tabela->indice.capacidade;
+    c.capSuspeitos = tabela->indiceSuspeitos.capacidade;
+    c.tamGrupos = tabela->tamGrupos;
+    c.nSuspeitosInverso = tabela->inverso.nSuspeitos;
+    c.nBlocos = tabela->inverso.nBlocos;
+    c.tamDadosBlocos = tabela->inverso.tamDados;
+    c.nPosteriores = tabela->nPosteriores;
+    c.nBlocosFiltro = tabela->filtro.nBlocos;
+
+    // textos concatenados; o id 0 aponta para o "" do início
+    uint32_t *deslocamentos = (uint32_t*) malloc(c.nTextos * sizeof(uint32_t));
+    uint64_t tamTextos = 1;
+    for (IdTexto i = 1; i < c.nTextos; ++i) tamTextos += strlen(textoDoPool(i)) + 1;
+    char *textos = (char*) malloc(tamTextos);
+    if (!deslocamentos || !textos) { fprintf(stderr, "Erro: malloc salvarMansao\n"); exit(1); }
+    if (tamTextos > UINT32_MAX) {
+        fprintf(stderr, "Erro: textos da mansao passam de 4 GiB\n");
+        free(deslocamentos); free(textos);
+        return 1;
+    }
+    textos[0] = '\0';
+    deslocamentos[0] = 0;
+    uint64_t pos = 1;
+    for (IdTexto i = 1; i < c.nTextos; ++i) {
+        size_t tam = strlen(textoDoPool(i)) + 1;
+        memcpy(textos + pos, textoDoPool(i), tam);
+        deslocamentos[i] = (uint32_t)pos;
+        pos += tam;
+    }
+    c.tamTextos = tamTextos;
+
+    FILE *f = fopen(arquivo, "wb");
+    if (!f) { perror(arquivo); free(deslocamentos); free(textos); return 1; }
+    uint64_t tam[SECOES_MANSAO];
+    tamanhosSecoes(&c, tam);
+    const void *dados[SECOES_MANSAO] = {
+        mapa->filhos, mapa->pistas, mapa->nomes, deslocamentos, textos, pool.hashes,
+        pool.indice.ctrl, pool.indice.slots,
+        tabela->entradas, tabela->pilotos, tabela->indice.ctrl, tabela->indice.slots,
+        tabela->suspeitos, tabela->indiceSuspeitos.ctrl, tabela->indiceSuspeitos.slots,
+        tabela->grupos, tabela->inverso.primeiroBloco, tabela->inverso.blocos, tabela->inverso.dados,
+        tabela->posteriores, tabela->filtro.blocos
+    };
+    // cabeçalho provisório; o definitivo (com as seções) vai no fim
+    uint64_t posicao = sizeof(c);
+    int erro = fwrite(&c, sizeof(c), 1, f) != 1;
+    for (int i = 0; i < SECOES_MANSAO && !erro; ++i)
+        erro = escreverSecao(f, &c, i, dados[i], tam[i], &posicao) != 0;
+    c.tamArquivo = posicao;
+    if (!erro) erro = fseek(f, 0, SEEK_SET) != 0 || fwrite(&c, sizeof(c), 1, f) != 1;
+    if (fclose(f) != 0) erro = 1;
+    free(deslocamentos);
+    free(textos);
+    if (erro) { fprintf(stderr, "Erro: falha ao gravar %s\n", arquivo); return 1; }
+    return 0;
+}
+
+#define SUSPEITOS_POR_LINHA 16
+
+// Divide uma linha em até 'max' campos separados por ';' (aparados).
+static int dividirCampos(char *linha, char **campos, int max) {
+    int n = 0;
+    while (n < max) {
+        char *sep = strchr(linha, ';');
+        if (sep) *sep = '\0';
+        campos[n++] = aparar(linha);
+        if (!sep) break;
+        linha = sep + 1;
+    }
+    return n;
+}
+
+// -----------------------------
+// converterMansao()
+// ./mestre --converter <descricao.txt|-> <saida.dqm>
+// Descrição em texto, uma declaração por linha ('#' comenta):
+//   sala <nome>;<pista>;<sala à esquerda>;<sala à direita>
+//   pista <pista>;<suspeito>[;<suspeito>...]
+// Campos vazios significam "nenhum". Uma pista pode apontar para
+// até SUSPEITOS_POR_LINHA suspeitos por linha; repetir a linha
+// acrescenta outros. A primeira sala é a entrada;
+// os filhos são referidos pelo nome e podem ser declarados depois.
+// -----------------------------
+int converterMansao(const char *entrada, const char *saida) {
+    size_t tamanho;
+    char *texto = lerArquivoInteiro(entrada, &tamanho);
+    if (!texto) return 1;
+    TabelaHash tabela;
+    inicializarHash(&tabela);
+    // salas como declaradas; até resolver os nomes, esq/dir guardam
+    // o id do nome do filho
+    typedef struct { IdTexto nome, pista; uint32_t esq, dir; } Declaracao;
+    uint32_t n = 0, cap = 1024;
+    Declaracao *salas = (Declaracao*) malloc(cap * sizeof(Declaracao));
+    if (!salas) { fprintf(stderr, "Erro: malloc converter\n"); exit(1); }
+    uint32_t *salaDoNome = NULL;
+    int erro = 0, numero = 0;
+    char *linha = texto;
+    while (linha && *linha && !erro) {
+        char *prox = strchr(linha, '\n');
+        if (prox) *prox++ = '\0';
+        numero++;
+        char *l = aparar(linha);
+        linha = prox;
+        if (*l == '\0' || *l == '#') continue;
+        char *campos[SUSPEITOS_POR_LINHA + 2] = { "", "", "", "" };
+        if (strncmp(l, "sala ", 5) == 0) {
+            dividirCampos(l + 5, campos, 4);
+            if (*campos[0] == '\0') {
+                fprintf(stderr, "Erro: linha %d: sala sem nome\n", numero);
+                erro = 1;
+            }
+            if (n == cap) {
+                cap *= 2;
+                salas = (Declaracao*) realloc(salas, cap * sizeof(Declaracao));
+                if (!salas) { fprintf(stderr, "Erro: realloc converter\n"); exit(1); }
+            }
+            salas[n++] = (Declaracao){ internar(campos[0]), internar(campos[1]),
+                                       internar(campos[2]), internar(campos[3]) };
+        } else if (strncmp(l, "pista ", 6) == 0) {
+            int nCampos = dividirCampos(l + 6, campos, SUSPEITOS_POR_LINHA + 2);
+            if (nCampos < 2 || !*campos[0]) {
+                fprintf(stderr, "Erro: linha %d: esperado 'pista <pista>;<suspeito>'\n", numero);
+                erro = 1;
+            } else if (nCampos > SUSPEITOS_POR_LINHA + 1) {
+                fprintf(stderr, "Erro: linha %d: mais de %d suspeitos\n", numero, SUSPEITOS_POR_LINHA);
+                erro = 1;
+            }
+            for (int i = 1; i < nCampos && !erro; ++i) {
+                if (!*campos[i]) {
+                    fprintf(stderr, "Erro: linha %d: suspeito vazio\n", numero);
+                    erro = 1;
+                } else {
+                    inserirNaHash(&tabela, campos[0], campos[i]);
+                }
+            }
+        } else {
+            fprintf(stderr, "Erro: linha %d: esperado 'sala' ou 'pista'\n", numero);
+            erro = 1;
+        }
+    }
+    if (!erro && n == 0) {
+        fprintf(stderr, "Erro: nenhuma sala declarada em %s\n", entrada);
+        erro = 1;
+    }
+    if (!erro) {
+        // nome -> posição da sala, para trocar os nomes dos filhos por posições
+        salaDoNome = (uint32_t*) malloc(pool.quantidade * sizeof(uint32_t));
+        if (!salaDoNome) { fprintf(stderr, "Erro: malloc converter\n"); exit(1); }
+        for (IdTexto i = 0; i < pool.quantidade; ++i) salaDoNome[i] = SALA_NENHUMA;
+        for (uint32_t i = 0; i < n && !erro; ++i) {
+            if (salaDoNome[salas[i].nome] != SALA_NENHUMA) {
+                fprintf(stderr, "Erro: sala '%s' declarada duas vezes\n", textoDe(salas[i].nome));
+                erro = 1;
+            }
+            salaDoNome[salas[i].nome] = i;
+        }
+        for (uint32_t i = 0; i < n && !erro; ++i) {
+            uint32_t *filhos[2] = { &salas[i].esq, &salas[i].dir };
+            for (int k = 0; k < 2 && !erro; ++k) {
+                IdTexto nome = *filhos[k];
+                *filhos[k] = nome == TEXTO_NENHUM ? SALA_NENHUMA : salaDoNome[nome];
+                if (nome != TEXTO_NENHUM && *filhos[k] == SALA_NENHUMA) {
+                    fprintf(stderr, "Erro: sala '%s' (saida de '%s') nao declarada\n",
+                            textoDe(nome), textoDe(salas[i].nome));
+                    erro = 1;
+                }
+            }
+        }
+    }
+    if (!erro) {
+        Mapa mapa;
+        alocarMapa(&mapa, n);
+        for (uint32_t i = 0; i < n; ++i) {
+            ((FilhosSala*) mapa.filhos)[i] = (FilhosSala){ salas[i].esq, salas[i].dir };
+            ((IdTexto*) mapa.pistas)[i] = salas[i].pista;
+            ((IdTexto*) mapa.nomes)[i] = salas[i].nome;
+        }
+        congelarHash(&tabela);
+        erro = salvarMansao(saida, &mapa, &tabela);
+        free(mapa.memoria);
+        if (!erro)
+            fprintf(stderr, "%u salas, %zu pistas, %u suspeitos, %u textos -> %s\n",
+                    n, tabela.quantidade, tabela.nSuspeitos, pool.quantidade - 1, saida);
+    }
+    free(salaDoNome);
+    free(salas);
+    liberarHash(&tabela);
+    liberarPool();
+    free(texto);
+    return erro;
+}
+
+// -----------------------------
+// Modo roteiro (--script)
+// Executa sessões sem teclado, lidas de um arquivo (ou stdin
+// com "-"). Cada linha é uma sessão: as teclas de movimento e,
+// depois de ';', o nome do acusado. Ex.: "e d s;Sr. Verde".
+// Linhas vazias ou iniciadas por '#' são ignoradas.
+// As teclas têm o mesmo efeito do modo interativo, então uma
+// linha reproduz exatamente uma partida jogada no terminal.
+// -----------------------------
+typedef struct Roteiro {
+    const char *movimentos;
+    const char *acusado;
+    IdTexto idAcusado;
+} Roteiro;
+
+// Divide o texto em roteiros (modifica o buffer). Retorna a quantidade.
+static size_t lerRoteiros(char *texto, Roteiro **saida) {
+    size_t cap = 64, n = 0;
+    Roteiro *r = (Roteiro*) malloc(cap * sizeof(Roteiro));
+    if (!r) { fprintf(stderr, "Erro: malloc roteiro\n"); exit(1); }
+    char *linha = texto;
+    while (linha && *linha) {
+        char *prox = strchr(linha, '\n');
+        if (prox) *prox++ = '\0';
+        char *l = aparar(linha);
+        linha = prox;
+        if (*l == '\0' || *l == '#') continue;
+        char *sep = strchr(l, ';');
+        if (sep) *sep = '\0';
+        if (n == cap) {
+            cap *= 2;
+            r = (Roteiro*) realloc(r, cap * sizeof(Roteiro));
+            if (!r) { fprintf(stderr, "Erro: realloc roteiro\n"); exit(1); }
+        }
+        r[n].movimentos = l;
+        r[n].acusado = sep ? aparar(sep + 1) : "";
+        r[n].idAcusado = TEXTO_NENHUM;
+        n++;
+    }
+    *saida = r;
+    return n;
+}
+
+// Joga um roteiro na sessão já posicionada no início.
+static void jogarRoteiro(Sessao *sessao, const char *movimentos) {
+    coletarPistaDaSala(sessao);
+    for (const char *m = movimentos; *m; ++m) {
+        if (isspace((unsigned char)*m)) continue;
+        if (moverSessao(sessao, *m) == MOVIMENTO_SAIR) return;
+        coletarPistaDaSala(sessao);
+    }
+}
+
+// -----------------------------
+// executarScript()
+// ./mestre --script <arquivo|-> [--repetir N] [--quieto]
+// Imprime uma linha por sessão com o veredito (saída com buffer)
+// e, no stderr, a vazão em sessões por segundo.
+// -----------------------------
+int executarScript(int argc, char *argv[]) {
+    const char *caminho = NULL;
+    long repeticoes = 1;
+    int quieto = 0;
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "--repetir") == 0 && i + 1 < argc) repeticoes = atol(argv[++i]);
+        else if (strcmp(argv[i], "--quieto") == 0) quieto = 1;
+        else caminho = argv[i];
+    }
+    if (!caminho || repeticoes < 1) {
+        fprintf(stderr, "Uso: --script <arquivo|-> [--repetir N] [--quieto]\n");
+        return 1;
+    }
+    size_t tamanho;
+    char *texto = lerArquivoInteiro(caminho, &tamanho);
+    if (!texto) return 1;
+    Roteiro *roteiros;
+    size_t n = lerRoteiros(texto, &roteiros);
+
+    Mansao mansao;
+    abrirMansao(&mansao, arquivoMansao);
+    const TabelaHash *tabela = &mansao.tabela;
+    for (size_t i = 0; i < n; ++i)
+        roteiros[i].idAcusado = buscarTexto(roteiros[i].acusado);
+
+    static char bufferSaida[1 << 16];
+    setvbuf(stdout, bufferSaida, _IOFBF, sizeof bufferSaida);
+
+    Sessao sessao;
+    iniciarSessao(&sessao, &mansao.mapa, tabela);
+    size_t numero = 0, aceitas = 0;
+    double t0 = agoraSeg();
+    for (long rep = 0; rep < repeticoes; ++rep) {
+        for (size_t i = 0; i < n; ++i) {
+            reiniciarSessao(&sessao);
+            jogarRoteiro(&sessao, roteiros[i].movimentos);
+            uint32_t cont = pistasContra(&sessao, roteiros[i].idAcusado);
+            int aceita = cont >= PISTAS_PARA_CONDENAR;
+            aceitas += aceita;
+            numero++;
+            if (!quieto) {
+                long lider = suspeitoMaisCitado(&sessao);
+                printf("sessao=%zu sala_final=\"%s\" pistas=%zu acusado=\"%s\" contra=%u "
+                       "mais_citado=\"%s\" veredito=%s\n",
+                       numero, textoDe(mansao.mapa.nomes[sessao.atual]),
+                       sessao.pistasColetadas, roteiros[i].acusado, cont,
+                       lider >= 0 ? textoDe(tabela->suspeitos[lider]) : "",
+                       aceita ? "aceita" : "rejeitada");
+            }
+        }
+    }
+    fflush(stdout);
+    double dt = agoraSeg() - t0;
+    fprintf(stderr, "%zu sessoes (%zu aceitas) em %.3f s: %.0f sessoes/s\n",
+            numero, aceitas, dt, dt > 0 ? numero / dt : 0.0);
+
+    encerrarSessao(&sessao);
+    fecharMansao(&mansao);
+    liberarPool();
+    free(roteiros);
+    free(texto);
+    return 0;
+}
+
+// -----------------------------
+// Modo servidor (--servidor) e gerador de carga (--carga)
+// O mapa, a tabela hash e o pool de textos são montados uma vez
+// e depois só lidos. Cada sessão pertence a um único trabalhador
+// (id % nTrabalhadores), que guarda a posição e as pistas dela;
+// por isso o estado das sessões dispensa travas.
+//
+// Protocolo (uma linha por comando no stdin, resposta no stdout
+// prefixada pelo id da sessão):
+//   <id> novo            inicia (ou reinicia) a sessão na sala inicial
+//   <id> e | d           move à esquerda / direita
+//   <id> pistas          lista as pistas coletadas
+//   <id> pistas <i> <n>  página: n pistas a partir da i-ésima (0, 1, ...)
+//   <id> contar <prefixo>  quantas pistas coletadas começam pelo prefixo
+//   <id> buscar <trecho>   pistas que mencionam o trecho (até 50; sem
+//                          diferenciar maiúsculas nem acentos)
+//   <id> prefixo <texto>   idem, para pistas que começam pelo texto
+//   <id> placar          até 3 suspeitos mais citados
+//   <id> suspeito <nome>   pistas coletadas contra o suspeito (até 50)
+//   <id> acusar <nome>   julga a acusação e encerra a sessão
+//   <id> s | fim         encerra a sessão
+// Com --diario, os comandos que mudam sessões (novo, movimentos
+// válidos, acusar e fim) são gravados antes da resposta; ver
+// "Diário das sessões" abaixo.
+// -----------------------------
+#define CMD_NOVO 'n'
+#define CMD_PISTAS 'p'
+#define CMD_PLACAR 'c'
+#define CMD_ACUSAR 'a'
+#define CMD_FIM 'f'
+#define CMD_CONTAR 'k'
+#define CMD_BUSCAR 'b'
+#define CMD_PREFIXO 'x'
+#define CMD_SUSPEITO 'u'
+#define BUSCA_MAXIMA 50
+#define SAIDA_TRABALHADOR (64 * 1024)
+
+typedef struct Comando {
+    uint32_t sessao;
+    char tipo;             // 'e', 'd' ou um CMD_*
+    IdTexto acusado;       // CMD_ACUSAR/SUSPEITO
+    double enviadoEm;      // para a latência no modo carga
+    uint32_t inicio;       // CMD_PISTAS: página
+    uint32_t quantidade;
+    char *texto;           // CMD_CONTAR/BUSCAR/PREFIXO: cópia, liberada pelo trabalhador
+} Comando;
+
+typedef struct FilaComandos {
+    Comando *itens;
+    size_t cap, inicio, quantidade;
+    int encerrar;
+    pthread_mutex_t trava;
+    pthread_cond_t temItem;
+} FilaComandos;
+
+// Registro do diário: um comando que mudou o estado de uma sessão.
+// Replicado na restauração, leva a sessão ao mesmo estado, porque
+// mover e coletar só dependem da mansão.
+typedef struct RegistroDiario {
+    uint64_t seqTipo;      // número de sequência << 8 | tipo do comando
+    uint32_t sessao;
+    uint32_t verificacao;  // detecta registro pela metade no fim do arquivo
+} RegistroDiario;
+
+typedef struct Servidor Servidor;
+
+typedef struct Trabalhador {
+    pthread_t thread;
+    Servidor *servidor;
+    FilaComandos fila;
+    Sessao **sessoes;      // indexado por id / nTrabalhadores
+    uint32_t *movimentos;  // movimentos feitos por sessão (modo carga)
+    size_t capSessoes;
+    char *saida;
+    size_t usados;
+    double *latencias;
+    size_t nLatencias, capLatencias;
+    uint64_t semente;
+    int fdDiario;          // -1 sem diário
+    RegistroDiario *diario;        // registros ainda não gravados
+    size_t nDiario, capDiario;
+    uint64_t seqDiario;            // último número de sequência usado
+    uint64_t registrosDesdeFoto;
+} Trabalhador;
+
+struct Servidor {
+    const Mapa *mapa;           // compartilhados, somente leitura
+    const TabelaHash *tabela;
+    int nTrabalhadores;
+    Trabalhador *trabalhadores;
+    pthread_mutex_t travaSaida;
+    long movimentosPorSessao;   // > 0 liga o modo carga
+    atomic_long sessoesAtivas;  // modo carga: sessões ainda jogando
+    const char *dirDiario;      // NULL sem diário
+    uint64_t epoca;             // geração dos arquivos do diário em uso
+    uint64_t impressao;         // da mansão, gravada em fotos e diários
+    long registrosPorFoto;
+};
+
+static void gravarDiario(Trabalhador *t);
+
+static uint32_t verificacaoRegistro(const RegistroDiario *r) {
+    return (uint32_t)misturar64(r->seqTipo ^ ((uint64_t)r->sessao << 40) ^ 0x44514449ULL);
+}
+
+// Anota no buffer do trabalhador um comando que mudou a sessão; o
+// buffer vai para o arquivo no fim do lote, antes das respostas.
+static void anotarDiario(Trabalhador *t, uint32_t sessao, char tipo) {
+    if (t->fdDiario < 0) return;
+    if (t->nDiario == t->capDiario) {
+        t->capDiario = t->capDiario ? t->capDiario * 2 : 256;
+        t->diario = (RegistroDiario*) realloc(t->diario, t->capDiario * sizeof(RegistroDiario));
+        if (!t->diario) { fprintf(stderr, "Erro: realloc diario\n"); exit(1); }
+    }
+    RegistroDiario *r = &t->diario[t->nDiario++];
+    r->seqTipo = (++t->seqDiario << 8) | (uint8_t)tipo;
+    r->sessao = sessao;
+    r->verificacao = verificacaoRegistro(r);
+}
+
+static void iniciarFila(FilaComandos *f) {
+    f->cap = 1024;
+    f->itens = (Comando*) malloc(f->cap * sizeof(Comando));
+    if (!f->itens) { fprintf(stderr, "Erro: malloc fila\n"); exit(1); }
+    f->inicio = f->quantidade = 0;
+    f->encerrar = 0;
+    pthread_mutex_init(&f->trava, NULL);
+    pthread_cond_init(&f->temItem, NULL);
+}
+
+static void destruirFila(FilaComandos *f) {
+    free(f->itens);
+    pthread_mutex_destroy(&f->trava);
+    pthread_cond_destroy(&f->temItem);
+}
+
+static void enfileirar(FilaComandos *f, const Comando *c) {
+    pthread_mutex_lock(&f->trava);
+    if (f->quantidade == f->cap) {
+        // fila circular cheia: dobra e desenrola
+        Comando *novos = (Comando*) malloc(2 * f->cap * sizeof(Comando));
+        if (!novos) { fprintf(stderr, "Erro: malloc fila\n"); exit(1); }
+        for (size_t i = 0; i < f->quantidade; ++i)
+            novos[i] = f->itens[(f->inicio + i) % f->cap];
+        free(f->itens);
+        f->itens = novos;
+        f->inicio = 0;
+        f->cap *= 2;
+    }
+    f->itens[(f->inicio + f->quantidade++) % f->cap] = *c;
+    pthread_cond_signal(&f->temItem);
+    pthread_mutex_unlock(&f->trava);
+}
+
+// Retira até 'max' comandos; bloqueia enquanto a fila estiver vazia.
+// Retorna 0 quando a fila foi encerrada e esvaziada.
+static size_t desenfileirar(FilaComandos *f, Comando *destino, size_t max) {
+    pthread_mutex_lock(&f->trava);
+    while (f->quantidade == 0 && !f->encerrar)
+        pthread_cond_wait(&f->temItem, &f->trava);
+    size_t n = 0;
+    while (n < max && f->quantidade > 0) {
+        destino[n++] = f->itens[f->inicio];
+        f->inicio = (f->inicio + 1) % f->cap;
+        f->quantidade--;
+    }
+    pthread_mutex_unlock(&f->trava);
+    return n;
+}
+
+static void encerrarFila(FilaComandos *f) {
+    pthread_mutex_lock(&f->trava);
+    f->encerrar = 1;
+    pthread_cond_broadcast(&f->temItem);
+    pthread_mutex_unlock(&f->trava);
+}
+
+// Escreve as respostas completas (até a última quebra de linha) e
+// guarda o começo da resposta em andamento, para que as linhas de
+// trabalhadores diferentes não se misturem. Uma resposta maior que
+// o buffer inteiro sai em pedaços.
+static void descarregarSaida(Trabalhador *t) {
+    if (t->nDiario) gravarDiario(t);   // o diário sempre antes da resposta
+    if (t->usados == 0) return;
+    size_t n = t->usados;
+    while (n > 0 && t->saida[n - 1] != '\n') n--;
+    if (n == 0) n = t->usados;
+    MEDIR_INICIO(t0);
+    pthread_mutex_lock(&t->servidor->travaSaida);
+    fwrite(t->saida, 1, n, stdout);
+    fflush(stdout);
+    pthread_mutex_unlock(&t->servidor->travaSaida);
+    MEDIR_FIM(MET_SAIDA, t0);
+    memmove(t->saida, t->saida + n, t->usados - n);
+    t->usados -= n;
+}
+
+static void responder(Trabalhador *t, const char *fmt, ...) {
+    if (t->servidor->movimentosPorSessao > 0) return;   // modo carga: sem saída
+    if (SAIDA_TRABALHADOR - t->usados < 1024) descarregarSaida(t);
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(t->saida + t->usados, SAIDA_TRABALHADOR - t->usados, fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        size_t livre = SAIDA_TRABALHADOR - t->usados;
+        t->usados += (size_t)n < livre ? (size_t)n : livre - 1;
+    }
+}
+
+static Sessao* sessaoDoTrabalhador(Trabalhador *t, uint32_t id, int criar) {
+    size_t local = id / (uint32_t)t->servidor->nTrabalhadores;
+    if (local >= t->capSessoes) {
+        if (!criar) return NULL;
+        size_t cap = t->capSessoes ? t->capSessoes : 64;
+        while (cap <= local) cap *= 2;
+        t->sessoes = (Sessao**) realloc(t->sessoes, cap * sizeof(Sessao*));
+        t->movimentos = (uint32_t*) realloc(t->movimentos, cap * sizeof(uint32_t));
+        if (!t->sessoes || !t->movimentos) { fprintf(stderr, "Erro: realloc sessoes\n"); exit(1); }
+        memset(t->sessoes + t->capSessoes, 0, (cap - t->capSessoes) * sizeof(Sessao*));
+        memset(t->movimentos + t->capSessoes, 0, (cap - t->capSessoes) * sizeof(uint32_t));
+        t->capSessoes = cap;
+    }
+    if (!t->sessoes[local] && criar) {
+        t->sessoes[local] = (Sessao*) malloc(sizeof(Sessao));
+        if (!t->sessoes[local]) { fprintf(stderr, "Erro: malloc sessao\n"); exit(1); }
+        iniciarSessao(t->sessoes[local], t->servidor->mapa, t->servidor->tabela);
+    }
+    return t->sessoes[local];
+}
+
+static void fecharSessao(Trabalhador *t, uint32_t id) {
+    size_t local = id / (uint32_t)t->servidor->nTrabalhadores;
+    if (local < t->capSessoes && t->sessoes[local]) {
+        encerrarSessao(t->sessoes[local]);
+        free(t->sessoes[local]);
+        t->sessoes[local] = NULL;
+    }
+}
+
+static void registrarLatencia(Trabalhador *t, double seg) {
+    if (t->nLatencias == t->capLatencias) {
+        t->capLatencias = t->capLatencias ? t->capLatencias * 2 : 4096;
+        t->latencias = (double*) realloc(t->latencias, t->capLatencias * sizeof(double));
+        if (!t->latencias) { fprintf(stderr, "Erro: realloc latencias\n"); exit(1); }
+    }
+    t->latencias[t->nLatencias++] = seg;
+}
+
+// Modo carga: escolhe o próximo comando do jogador simulado.
+static void proximoComandoCarga(Trabalhador *t, uint32_t id, Sessao *s) {
+    size_t local = id / (uint32_t)t->servidor->nTrabalhadores;
+    Comando c = { id, CMD_FIM, TEXTO_NENHUM, 0.0, 0, UINT32_MAX, NULL };
+    if (t->movimentos[local] < (uint32_t)t->servidor->movimentosPorSessao) {
+        const Mapa *mapa = t->servidor->mapa;
+        const FilhosSala *a = &mapa->filhos[s->atual];
+        int temEsq = a->esq < mapa->nSalas, temDir = a->dir < mapa->nSalas;
+        if (temEsq && temDir) c.tipo = (proximoAleatorio(&t->semente) & 1) ? 'e' : 'd';
+        else if (temEsq) c.tipo = 'e';
+        else if (temDir) c.tipo = 'd';
+        else c.tipo = CMD_NOVO;   // chegou a uma folha: recomeça da entrada
+    }
+    c.enviadoEm = agoraSeg();
+    enfileirar(&t->fila, &c);
+}
+
+static void executarComando(Trabalhador *t, const Comando *c) {
+    Sessao *s = sessaoDoTrabalhador(t, c->sessao, c->tipo == CMD_NOVO);
+    if (!s) {
+        responder(t, "%u erro sessao inexistente\n", c->sessao);
+        return;
+    }
+    MEDIR_INICIO(t0);
+    ALOCACOES_INICIO(alocacoes);
+    switch (c->tipo) {
+    case CMD_NOVO:
+        reiniciarSessao(s);
+        coletarPistaDaSala(s);
+        anotarDiario(t, c->sessao, CMD_NOVO);
+        responder(t, "%u sala=\"%s\" pista=\"%s\"\n", c->sessao,
+                  textoDe(s->mapa->nomes[s->atual]), textoDe(s->mapa->pistas[s->atual]));
+        MEDIR_FIM(MET_MOVER, t0);
+        CONTAR_METRICA(CONT_ALOCACOES_MOVIMENTO, alocacoesHeap - alocacoes);
+        break;
+    case 'e':
+    case 'd':
+        if (moverSessao(s, c->tipo) == MOVIMENTO_OK) {
+            coletarPistaDaSala(s);
+            anotarDiario(t, c->sessao, c->tipo);
+            responder(t, "%u sala=\"%s\" pista=\"%s\"\n", c->sessao,
+                      textoDe(s->mapa->nomes[s->atual]), textoDe(s->mapa->pistas[s->atual]));
+        } else {
+            responder(t, "%u invalido\n", c->sessao);
+        }
+        MEDIR_FIM(MET_MOVER, t0);
+        CONTAR_METRICA(CONT_ALOCACOES_MOVIMENTO, alocacoesHeap - alocacoes);
+        break;
+    case CMD_PISTAS: {
+        CursorPistas cursor;
+        cursorNaPosicao(&cursor, &s->pistas, c->inicio);
+        responder(t, "%u pistas=%zu", c->sessao, s->pistasColetadas);
+        if (c->inicio || c->quantidade != UINT32_MAX) responder(t, " inicio=%u", c->inicio);
+        IdTexto p;
+        uint32_t i = 0;
+        for (; i < c->quantidade && (p = proximaPista(&cursor)) != TEXTO_NENHUM; ++i)
+            responder(t, " | %s", textoDe(p));
+        responder(t, "\n");
+        MEDIR_FIM(MET_PERCORRER, t0);
+        CONTAR_METRICA(CONT_PISTAS_PERCORRIDAS, i);
+        break;
+    }
+    case CMD_CONTAR:
+        responder(t, "%u contar=%zu\n", c->sessao,
+                  contarPistasComPrefixo(&s->pistas, c->texto));
+        break;
+    case CMD_BUSCAR:
+    case CMD_PREFIXO: {
+        IdTexto achadas[BUSCA_MAXIMA + 1];
+        size_t n = c->tipo == CMD_BUSCAR ? buscarNasPistas(s, c->texto, achadas, BUSCA_MAXIMA + 1)
+                                         : buscarPistasPorPrefixo(s, c->texto, achadas, BUSCA_MAXIMA + 1);
+        responder(t, "%u %s=%zu", c->sessao, c->tipo == CMD_BUSCAR ? "buscar" : "prefixo",
+                  n > BUSCA_MAXIMA ? (size_t)BUSCA_MAXIMA : n);
+        for (size_t i = 0; i < n && i < BUSCA_MAXIMA; ++i) responder(t, " | %s", textoDe(achadas[i]));
+        responder(t, n > BUSCA_MAXIMA ? " | ...\n" : "\n");
+        break;
+    }
+    case CMD_SUSPEITO: {
+        IdTexto achadas[BUSCA_MAXIMA];
+        size_t n = pistasColetadasContra(s, c->acusado, achadas, BUSCA_MAXIMA);
+        responder(t, "%u suspeito=%d", c->sessao, verificarSuspeitoFinal(s, c->acusado));
+        for (size_t i = 0; i < n; ++i) responder(t, " | %s", textoDe(achadas[i]));
+        responder(t, "\n");
+        break;
+    }
+    case CMD_PLACAR: {
+        uint32_t topo[3];
+        uint32_t n = topoDoPlacar(&s->placar, 3, topo);
+        responder(t, "%u placar", c->sessao);
+        for (uint32_t i = 0; i < n; ++i)
+            responder(t, " | %s=%u", textoDe(t->servidor->tabela->suspeitos[topo[i]]),
+                      s->placar.contagem[topo[i]]);
+        responder(t, "\n");
+        break;
+    }
+    case CMD_ACUSAR: {
+        uint32_t cont = pistasContra(s, c->acusado);
+        responder(t, "%u contra=%u veredito=%s\n", c->sessao, cont,
+                  cont >= PISTAS_PARA_CONDENAR ? "aceita" : "rejeitada");
+        anotarDiario(t, c->sessao, CMD_ACUSAR);
+        fecharSessao(t, c->sessao);
+        return;
+    }
+    default:
+        responder(t, "%u fim\n", c->sessao);
+        anotarDiario(t, c->sessao, CMD_FIM);
+        fecharSessao(t, c->sessao);
+        if (t->servidor->movimentosPorSessao > 0)
+            atomic_fetch_sub(&t->servidor->sessoesAtivas, 1);
+        return;
+    }
+    if (t->servidor->movimentosPorSessao > 0) {
+        size_t local = c->sessao / (uint32_t)t->servidor->nTrabalhadores;
+        registrarLatencia(t, agoraSeg() - c->enviadoEm);
+        t->movimentos[local]++;
+        proximoComandoCarga(t, c->sessao, s);
+    }
+}
+
+static void* rotinaTrabalhador(void *arg) {
+    Trabalhador *t = (Trabalhador*) arg;
+    Comando lote[64];
+    size_t n;
+    while ((n = desenfileirar(&t->fila, lote, 64)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            executarComando(t, &lote[i]);
+            free(lote[i].texto);
+        }
+        if (t->nDiario) gravarDiario(t);
+        // só descarrega quando a fila esvaziou, agrupando respostas
+        pthread_mutex_lock(&t->fila.trava);
+        int vazia = t->fila.quantidade == 0;
+        pthread_mutex_unlock(&t->fila.trava);
+        if (vazia) descarregarSaida(t);
+    }
+    descarregarSaida(t);
+    return NULL;
+}
+
+static void iniciarServidor(Servidor *sv, const Mapa *mapa, const TabelaHash *tabela,
+                            int nTrabalhadores, long movimentosPorSessao) {
+    sv->mapa = mapa;
+    sv->tabela = tabela;
+    sv->nTrabalhadores = nTrabalhadores;
+    sv->movimentosPorSessao = movimentosPorSessao;
+    atomic_init(&sv->sessoesAtivas, 0);
+    pthread_mutex_init(&sv->travaSaida, NULL);
+    sv->trabalhadores = (Trabalhador*) calloc((size_t)nTrabalhadores, sizeof(Trabalhador));
+    if (!sv->trabalhadores) { fprintf(stderr, "Erro: malloc trabalhadores\n"); exit(1); }
+    for (int i = 0; i < nTrabalhadores; ++i) {
+        Trabalhador *t = &sv->trabalhadores[i];
+        t->servidor = sv;
+        t->fdDiario = -1;
+        t->semente = 0x9E3779B97F4A7C15ULL * (uint64_t)(i + 1);
+        t->saida = (char*) malloc(SAIDA_TRABALHADOR);
+        if (!t->saida) { fprintf(stderr, "Erro: malloc saida\n"); exit(1); }
+        iniciarFila(&t->fila);
+    }
+}
+
+static void despacharComando(Servidor *sv, const Comando *c) {
+    enfileirar(&sv->trabalhadores[c->sessao % (uint32_t)sv->nTrabalhadores].fila, c);
+}
+
+static void rodarTrabalhadores(Servidor *sv) {
+    for (int i = 0; i < sv->nTrabalhadores; ++i)
+        pthread_create(&sv->trabalhadores[i].thread, NULL, rotinaTrabalhador, &sv->trabalhadores[i]);
+}
+
+static void pararServidor(Servidor *sv) {
+    for (int i = 0; i < sv->nTrabalhadores; ++i) encerrarFila(&sv->trabalhadores[i].fila);
+    for (int i = 0; i < sv->nTrabalhadores; ++i) pthread_join(sv->trabalhadores[i].thread, NULL);
+}
+
+static void liberarServidor(Servidor *sv) {
+    for (int i = 0; i < sv->nTrabalhadores; ++i) {
+        Trabalhador *t = &sv->trabalhadores[i];
+        for (size_t k = 0; k < t->capSessoes; ++k) {
+            if (!t->sessoes[k]) continue;
+            encerrarSessao(t->sessoes[k]);
+            free(t->sessoes[k]);
+        }
+        free(t->sessoes);
+        free(t->movimentos);
+        free(t->saida);
+        free(t->latencias);
+        free(t->diario);
+        if (t->fdDiario >= 0) close(t->fdDiario);
+        destruirFila(&t->fila);
+    }
+    free(sv->trabalhadores);
+    pthread_mutex_destroy(&sv->travaSaida);
+}
+
+// -----------------------------
+// Diário das sessões (--diario <dir>)
+// Cada trabalhador guarda o estado das suas sessões em dois
+// arquivos: uma foto (sala atual e ids das pistas coletadas de cada
+// sessão) e um diário só de acréscimo com os comandos que mudaram
+// alguma sessão depois dela. Um movimento custa um registro de 16
+// bytes, gravado com write() no fim do lote e antes das respostas;
+// a cada 'registrosPorFoto' registros o trabalhador tira uma foto
+// nova e esvazia o diário. Restaurar é ler a foto e repetir só a
+// cauda do diário, sem reserializar nada por movimento.
+//
+// Os nomes dos arquivos levam a época (e<E>-t<w>.foto/.diario) e o
+// 'manifesto' diz qual época vale e com quantos trabalhadores. Ao
+// subir, o servidor lê a época anterior repartindo as sessões pelo
+// número atual de trabalhadores, grava as fotos da época nova, troca
+// o manifesto e só então apaga os arquivos antigos: uma queda em
+// qualquer ponto deixa uma época inteira no disco.
+//
+// write() basta para sobreviver à queda do processo; fsync só é
+// feito nas fotos e no manifesto, então uma queda da máquina perde
+// no máximo o que foi registrado desde a última foto.
+// -----------------------------
+#define VERSAO_DIARIO 1
+#define REGISTROS_POR_FOTO 4096
+#define CAMINHO_MAXIMO 1024
+
+typedef struct CabecalhoDiario {
+    char magica[8];        // "DQDIARIO"
+    uint32_t versao;
+    uint32_t trabalhador;
+    uint64_t epoca;
+    uint64_t impressao;    // da mansão: o diário só vale para ela
+} CabecalhoDiario;
+
+typedef struct CabecalhoFoto {
+    char magica[8];        // "DQFOTO\0\0"
+    uint32_t versao;
+    uint32_t trabalhador;
+    uint64_t epoca;
+    uint64_t impressao;
+    uint64_t seq;          // último registro do diário já incluído na foto
+    uint64_t nSessoes;
+} CabecalhoFoto;
+// Depois do cabeçalho, por sessão (inteiros em LEB128): id, sala,
+// número de pistas e os ids das pistas em ordem crescente, cada um
+// como diferença para o anterior.
+
+// Identifica a mansão pela navegação, pelas pistas das salas e pelo
+// tamanho do pool, que juntos fixam os ids gravados nas fotos.
+static uint64_t impressaoMansao(const Mapa *mapa) {
+    uint64_t h = hash_palavras((const char*)mapa->filhos, mapa->nSalas * sizeof(FilhosSala));
+    h = misturar64(h ^ hash_palavras((const char*)mapa->pistas, mapa->nSalas * sizeof(IdTexto)));
+    h = misturar64(h ^ ((uint64_t)mapa->nSalas << 32 | mapa->raiz));
+    return misturar64(h ^ pool.quantidade);
+}
+
+static void caminhoDiario(char *destino, const char *dir, uint64_t epoca, int trabalhador,
+                          const char *extensao) {
+    int n = snprintf(destino, CAMINHO_MAXIMO, "%s/e%llu-t%d.%s", dir,
+                     (unsigned long long)epoca, trabalhador, extensao);
+    if (n < 0 || n >= CAMINHO_MAXIMO) { fprintf(stderr, "Erro: caminho do diario longo demais\n"); exit(1); }
+}
+
+static void escreverTudo(int fd, const void *dados, size_t tamanho, const char *nome) {
+    const char *p = (const char*) dados;
+    while (tamanho > 0) {
+        ssize_t n = write(fd, p, tamanho);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror(nome);
+            exit(1);
+        }
+        p += n;
+        tamanho -= (size_t)n;
+    }
+}
+
+static void escreverVarint(FILE *f, uint64_t v) {
+    unsigned char buf[10];
+    size_t n = 0;
+    while (v >= 0x80) { buf[n++] = (unsigned char)(v | 0x80); v >>= 7; }
+    buf[n++] = (unsigned char)v;
+    fwrite(buf, 1, n, f);
+}
+
+// Retorna 0 se o número passar do fim ou de 64 bits.
+static int lerVarint(const unsigned char **p, const unsigned char *fim, uint64_t *v) {
+    uint64_t x = 0;
+    for (unsigned desloc = 0; *p < fim && desloc < 64; desloc += 7) {
+        unsigned char b = *(*p)++;
+        x |= (uint64_t)(b & 0x7F) << desloc;
+        if (!(b & 0x80)) { *v = x; return 1; }
+    }
+    return 0;
+}
+
+// Grava (fsync) e troca atomicamente o arquivo 'caminho' pelo temporário.
+static void publicarArquivo(FILE *f, const char *temp, const char *caminho) {
+    if (fflush(f) != 0 || fsync(fileno(f)) != 0) { perror(temp); exit(1); }
+    fclose(f);
+    if (rename(temp, caminho) != 0) { perror(caminho); exit(1); }
+}
+
+// -----------------------------
+// fotografarTrabalhador()
+// Foto das sessões abertas do trabalhador, incluindo tudo até o
+// registro 'seqDiario'.
+// -----------------------------
+static void fotografarTrabalhador(Trabalhador *t) {
+    Servidor *sv = t->servidor;
+    int w = (int)(t - sv->trabalhadores);
+    char caminho[CAMINHO_MAXIMO], temp[CAMINHO_MAXIMO + 4];
+    caminhoDiario(caminho, sv->dirDiario, sv->epoca, w, "foto");
+    snprintf(temp, sizeof temp, "%s.tmp", caminho);
+    FILE *f = fopen(temp, "wb");
+    if (!f) { perror(temp); exit(1); }
+
+    CabecalhoFoto cab;
+    memset(&cab, 0, sizeof cab);
+    memcpy(cab.magica, "DQFOTO", 6);
+    cab.versao = VERSAO_DIARIO;
+    cab.trabalhador = (uint32_t)w;
+    cab.epoca = sv->epoca;
+    cab.impressao = sv->impressao;
+    cab.seq = t->seqDiario;
+    for (size_t k = 0; k < t->capSessoes; ++k) cab.nSessoes += t->sessoes[k] != NULL;
+    fwrite(&cab, sizeof cab, 1, f);
+
+    for (size_t k = 0; k < t->capSessoes; ++k) {
+        const Sessao *s = t->sessoes[k];
+        if (!s) continue;
+        escreverVarint(f, k * (uint64_t)sv->nTrabalhadores + (uint64_t)w);
+        escreverVarint(f, s->atual);
+        escreverVarint(f, s->pistasColetadas);
+        IdTexto anterior = 0;
+        for (uint32_t p = 0; p < s->capColetadas / 64; ++p) {
+            for (uint64_t m = s->coletadas[p]; m; m &= m - 1) {
+                IdTexto pista = p * 64 + (IdTexto)__builtin_ctzll(m);
+                escreverVarint(f, pista - anterior);
+                anterior = pista;
+            }
+        }
+    }
+    publicarArquivo(f, temp, caminho);
+}
+
+// -----------------------------
+// gravarDiario()
+// Acrescenta ao arquivo os registros do buffer. Passado o limite,
+// tira uma foto e volta o diário ao cabeçalho; se cair entre as
+// duas coisas, os registros já cobertos pela foto são pulados.
+// -----------------------------
+static void gravarDiario(Trabalhador *t) {
+    MEDIR_INICIO(t0);
+    escreverTudo(t->fdDiario, t->diario, t->nDiario * sizeof(RegistroDiario), "Erro: diario");
+    MEDIR_FIM(MET_SAIDA, t0);
+    t->registrosDesdeFoto += t->nDiario;
+    t->nDiario = 0;
+    if (t->registrosDesdeFoto >= (uint64_t)t->servidor->registrosPorFoto) {
+        fotografarTrabalhador(t);
+        if (ftruncate(t->fdDiario, sizeof(CabecalhoDiario)) != 0) { perror("Erro: diario"); exit(1); }
+        t->registrosDesdeFoto = 0;
+    }
+}
+
+// Cria o diário vazio da época atual (O_APPEND: cada write vai ao fim,
+// também depois do ftruncate de uma foto).
+static void abrirDiario(Trabalhador *t) {
+    Servidor *sv = t->servidor;
+    int w = (int)(t - sv->trabalhadores);
+    char caminho[CAMINHO_MAXIMO];
+    caminhoDiario(caminho, sv->dirDiario, sv->epoca, w, "diario");
+    t->fdDiario = open(caminho, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (t->fdDiario < 0) { perror(caminho); exit(1); }
+    CabecalhoDiario cab;
+    memset(&cab, 0, sizeof cab);
+    memcpy(cab.magica, "DQDIARIO", 8);
+    cab.versao = VERSAO_DIARIO;
+    cab.trabalhador = (uint32_t)w;
+    cab.epoca = sv->epoca;
+    cab.impressao = sv->impressao;
+    escreverTudo(t->fdDiario, &cab, sizeof cab, caminho);
+}
+
+// Repete um registro do diário na sessão, agora no trabalhador que
+// a atende com o número atual de threads.
+static void repetirRegistro(Servidor *sv, uint32_t id, char tipo) {
+    Trabalhador *t = &sv->trabalhadores[id % (uint32_t)sv->nTrabalhadores];
+    Sessao *s;
+    switch (tipo) {
+    case CMD_NOVO:
+        s = sessaoDoTrabalhador(t, id, 1);
+        reiniciarSessao(s);
+        coletarPistaDaSala(s);
+        break;
+    case 'e':
+    case 'd':
+        s = sessaoDoTrabalhador(t, id, 0);
+        if (s && moverSessao(s, tipo) == MOVIMENTO_OK) coletarPistaDaSala(s);
+        break;
+    default:
+        fecharSessao(t, id);
+        break;
+    }
+}
+
+static void arquivoInvalido(const char *caminho, const char *motivo) {
+    fprintf(stderr, "Erro: %s: %s\n", caminho, motivo);
+    exit(1);
+}
+
+// -----------------------------
+// restaurarTrabalhador()
+// Carrega a foto do trabalhador 'w' da época 'epoca' e repete a
+// cauda do diário dele. Retorna o número de registros repetidos.
+// -----------------------------
+static uint64_t restaurarTrabalhador(Servidor *sv, uint64_t epoca, int w) {
+    char caminho[CAMINHO_MAXIMO];
+    size_t tamanho;
+
+    caminhoDiario(caminho, sv->dirDiario, epoca, w, "foto");
+    unsigned char *foto = (unsigned char*) lerArquivoInteiro(caminho, &tamanho);
+    if (!foto) exit(1);
+    CabecalhoFoto cf;
+    if (tamanho < sizeof cf) arquivoInvalido(caminho, "foto truncada");
+    memcpy(&cf, foto, sizeof cf);
+    if (memcmp(cf.magica, "DQFOTO\0\0", 8) != 0 || cf.versao != VERSAO_DIARIO ||
+        cf.trabalhador != (uint32_t)w || cf.epoca != epoca)
+        arquivoInvalido(caminho, "nao e uma foto desta epoca");
+    if (cf.impressao != sv->impressao) arquivoInvalido(caminho, "foto de outra mansao");
+
+    const unsigned char *p = foto + sizeof cf, *fim = foto + tamanho;
+    IdTexto *pistas = NULL;
+    size_t capPistas = 0;
+    for (uint64_t i = 0; i < cf.nSessoes; ++i) {
+        uint64_t id, sala, n;
+        if (!lerVarint(&p, fim, &id) || !lerVarint(&p, fim, &sala) || !lerVarint(&p, fim, &n) ||
+            id > UINT32_MAX || n > pool.quantidade)
+            arquivoInvalido(caminho, "foto corrompida");
+        if (n > capPistas) {
+            capPistas = n;
+            pistas = (IdTexto*) realloc(pistas, capPistas * sizeof(IdTexto));
+            if (!pistas) { fprintf(stderr, "Erro: realloc pistas\n"); exit(1); }
+        }
+        uint64_t pista = 0;
+        for (uint64_t j = 0; j < n; ++j) {
+            uint64_t delta;
+            if (!lerVarint(&p, fim, &delta) || (j > 0 && delta == 0) || delta >= pool.quantidade)
+                arquivoInvalido(caminho, "foto corrompida");
+            pista += delta;
+            pistas[j] = (IdTexto)pista;
+        }
+        Trabalhador *t = &sv->trabalhadores[id % (uint64_t)sv->nTrabalhadores];
+        Sessao *s = sessaoDoTrabalhador(t, (uint32_t)id, 1);
+        if (sala > UINT32_MAX || restaurarSessao(s, (uint32_t)sala, pistas, (size_t)n) != 0)
+            arquivoInvalido(caminho, "sala ou pista inexistente na mansao");
+    }
+    free(pistas);
+    free(foto);
+
+    caminhoDiario(caminho, sv->dirDiario, epoca, w, "diario");
+    unsigned char *diario = (unsigned char*) lerArquivoInteiro(caminho, &tamanho);
+    if (!diario) exit(1);
+    CabecalhoDiario cd;
+    if (tamanho < sizeof cd) arquivoInvalido(caminho, "diario truncado");
+    memcpy(&cd, diario, sizeof cd);
+    if (memcmp(cd.magica, "DQDIARIO", 8) != 0 || cd.versao != VERSAO_DIARIO ||
+        cd.trabalhador != (uint32_t)w || cd.epoca != epoca)
+        arquivoInvalido(caminho, "nao e um diario desta epoca");
+    if (cd.impressao != sv->impressao) arquivoInvalido(caminho, "diario de outra mansao");
+
+    // registros até cf.seq já estão na foto (o diário pode não ter
+    // sido esvaziado depois dela); um registro pela metade ou fora de
+    // sequência só pode ser o último write, interrompido pela queda
+    size_t nRegistros = (tamanho - sizeof cd) / sizeof(RegistroDiario), validos = 0;
+    uint64_t repetidos = 0, esperado = 0;
+    for (; validos < nRegistros; ++validos) {
+        RegistroDiario r;
+        memcpy(&r, diario + sizeof cd + validos * sizeof r, sizeof r);
+        uint64_t seq = r.seqTipo >> 8;
+        if (r.verificacao != verificacaoRegistro(&r) || (validos > 0 && seq != esperado)) break;
+        esperado = seq + 1;
+        if (seq <= cf.seq) continue;
+        if (repetidos == 0 && seq != cf.seq + 1) arquivoInvalido(caminho, "diario nao continua a foto");
+        repetirRegistro(sv, r.sessao, (char)(r.seqTipo & 0xFF));
+        repetidos++;
+    }
+    size_t sobra = tamanho - sizeof cd - validos * sizeof(RegistroDiario);
+    if (sobra) fprintf(stderr, "Aviso: %s: %zu bytes incompletos no fim ignorados\n", caminho, sobra);
+    free(diario);
+    return repetidos;
+}
+
+// -----------------------------
+// prepararDiario()
+// Liga o diário em 'dir' antes de os trabalhadores começarem. Com
+// 'restaurar', recupera as sessões da época gravada no manifesto
+// (com qualquer número de trabalhadores); depois abre uma época nova.
+// -----------------------------
+static void prepararDiario(Servidor *sv, const char *dir, long registrosPorFoto, int restaurar) {
+    sv->dirDiario = dir;
+    sv->registrosPorFoto = registrosPorFoto;
+    sv->impressao = impressaoMansao(sv->mapa);
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) { perror(dir); exit(1); }
+
+    char manifesto[CAMINHO_MAXIMO], temp[CAMINHO_MAXIMO + 4];
+    int n = snprintf(manifesto, sizeof manifesto, "%s/manifesto", dir);
+    if (n < 0 || n >= (int)sizeof manifesto) { fprintf(stderr, "Erro: caminho do diario longo demais\n"); exit(1); }
+    unsigned long long epoca = 0;
+    int nAntigos = 0;
+    FILE *f = fopen(manifesto, "r");
+    if (f) {
+        if (fscanf(f, "DQDIARIO %llu %d", &epoca, &nAntigos) != 2 || nAntigos < 1)
+            arquivoInvalido(manifesto, "manifesto invalido");
+        fclose(f);
+    }
+
+    if (restaurar && nAntigos > 0) {
+        double t0 = agoraSeg();
+        uint64_t repetidos = 0, sessoes = 0;
+        for (int w = 0; w < nAntigos; ++w) repetidos += restaurarTrabalhador(sv, epoca, w);
+        for (int i = 0; i < sv->nTrabalhadores; ++i)
+            for (size_t k = 0; k < sv->trabalhadores[i].capSessoes; ++k)
+                sessoes += sv->trabalhadores[i].sessoes[k] != NULL;
+        fprintf(stderr, "diario: %llu sessoes e %llu registros da epoca %llu (%d trabalhadores) em %.1f ms\n",
+                (unsigned long long)sessoes, (unsigned long long)repetidos, epoca, nAntigos,
+                (agoraSeg() - t0) * 1e3);
+    }
+
+    sv->epoca = epoca + 1;
+    for (int i = 0; i < sv->nTrabalhadores; ++i) {
+        Trabalhador *t = &sv->trabalhadores[i];
+        t->seqDiario = 0;
+        t->registrosDesdeFoto = 0;
+        fotografarTrabalhador(t);
+        abrirDiario(t);
+    }
+
+    snprintf(temp, sizeof temp, "%s.tmp", manifesto);
+    f = fopen(temp, "w");
+    if (!f) { perror(temp); exit(1); }
+    fprintf(f, "DQDIARIO %llu %d\n", (unsigned long long)sv->epoca, sv->nTrabalhadores);
+    publicarArquivo(f, temp, manifesto);
+    int fdDir = open(dir, O_RDONLY);
+    if (fdDir >= 0) { fsync(fdDir); close(fdDir); }
+
+    char caminho[CAMINHO_MAXIMO];
+    for (int w = 0; w < nAntigos; ++w) {
+        caminhoDiario(caminho, dir, epoca, w, "foto");
+        unlink(caminho);
+        caminhoDiario(caminho, dir, epoca, w, "diario");
+        unlink(caminho);
+    }
+}
+
+static int numeroDeNucleos(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+// Converte uma linha do protocolo em comando. Retorna 0 se inválida.
+static int lerComando(char *linha, Comando *c) {
+    char *fim;
+    unsigned long id = strtoul(linha, &fim, 10);
+    if (fim == linha) return 0;
+    char *cmd = aparar(fim);
+    c->sessao = (uint32_t)id;
+    c->acusado = TEXTO_NENHUM;
+    c->enviadoEm = 0.0;
+    c->inicio = 0;
+    c->quantidade = UINT32_MAX;
+    c->texto = NULL;
+    if (strcmp(cmd, "novo") == 0) c->tipo = CMD_NOVO;
+    else if (strcmp(cmd, "e") == 0 || strcmp(cmd, "d") == 0) c->tipo = cmd[0];
+    else if (strcmp(cmd, "pistas") == 0) c->tipo = CMD_PISTAS;
+    else if (strncmp(cmd, "pistas", 6) == 0 && isspace((unsigned char)cmd[6])) {
+        unsigned long inicio, quantidade;
+        if (sscanf(cmd + 6, "%lu %lu", &inicio, &quantidade) != 2 ||
+            inicio > UINT32_MAX || quantidade > UINT32_MAX)
+            return 0;
+        c->tipo = CMD_PISTAS;
+        c->inicio = (uint32_t)inicio;
+        c->quantidade = (uint32_t)quantidade;
+    } else if ((strncmp(cmd, "contar", 6) == 0 && isspace((unsigned char)cmd[6])) ||
+               (strncmp(cmd, "buscar", 6) == 0 && isspace((unsigned char)cmd[6])) ||
+               (strncmp(cmd, "prefixo", 7) == 0 && isspace((unsigned char)cmd[7]))) {
+        c->tipo = cmd[0] == 'c' ? CMD_CONTAR : cmd[0] == 'b' ? CMD_BUSCAR : CMD_PREFIXO;
+        c->texto = strdup(aparar(cmd + (cmd[0] == 'p' ? 7 : 6)));
+        if (!c->texto) { fprintf(stderr, "Erro: malloc comando\n"); exit(1); }
+    } else if (strcmp(cmd, "placar") == 0) c->tipo = CMD_PLACAR;
+    else if (strcmp(cmd, "s") == 0 || strcmp(cmd, "fim") == 0) c->tipo = CMD_FIM;
+    else if (strncmp(cmd, "acusar", 6) == 0 && (cmd[6] == ' ' || cmd[6] == '\t')) {
+        c->tipo = CMD_ACUSAR;
+        c->acusado = buscarTexto(aparar(cmd + 6));   // só leitura do pool
+    } else if (strncmp(cmd, "suspeito", 8) == 0 && isspace((unsigned char)cmd[8])) {
+        c->tipo = CMD_SUSPEITO;
+        c->acusado = buscarTexto(aparar(cmd + 8));
+    } else return 0;
+    return 1;
+}
+
+// -----------------------------
+// executarServidor()
+// ./mestre --servidor [--threads N] [--diario DIR [--foto N]]
+// Lê comandos do stdin até EOF e os distribui entre os trabalhadores.
+// Com --diario, retoma as sessões gravadas em DIR e continua
+// gravando nele, com uma foto a cada N registros por trabalhador.
+// -----------------------------
+int executarServidor(int argc, char *argv[]) {
+    int nThreads = numeroDeNucleos();
+    const char *dirDiario = NULL;
+    long registrosPorFoto = REGISTROS_POR_FOTO;
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) nThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--diario") == 0 && i + 1 < argc) dirDiario = argv[++i];
+        else if (strcmp(argv[i], "--foto") == 0 && i + 1 < argc) registrosPorFoto = atol(argv[++i]);
+    }
+    if (nThreads < 1) nThreads = 1;
+    if (registrosPorFoto < 1) registrosPorFoto = 1;
+
+    Mansao mansao;
+    abrirMansao(&mansao, arquivoMansao);
+
+    Servidor sv;
+    iniciarServidor(&sv, &mansao.mapa, &mansao.tabela, nThreads, 0);
+    if (dirDiario) prepararDiario(&sv, dirDiario, registrosPorFoto, 1);
+    rodarTrabalhadores(&sv);
+    // getline: um comando longo (busca, acusação) chega inteiro
+    char *linha = NULL;
+    size_t capLinha = 0;
+    Comando c;
+    while (getline(&linha, &capLinha, stdin) >= 0) {
+        if (lerComando(linha, &c)) {
+            despacharComando(&sv, &c);
+        } else if (*aparar(linha)) {
+            pthread_mutex_lock(&sv.travaSaida);
+            printf("erro comando invalido: %s\n", aparar(linha));
+            fflush(stdout);
+            pthread_mutex_unlock(&sv.travaSaida);
+        }
+    }
+    free(linha);
+    pararServidor(&sv);
+    liberarServidor(&sv);
+    fecharMansao(&mansao);
+    liberarPool();
+    return 0;
+}
+
+static int compararDouble(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// -----------------------------
+// executarCarga()
+// ./mestre --carga [sessoes] [movimentos] [--threads N] [--diario DIR [--foto N]]
+// Cada sessão simulada mantém um comando pendente por vez (laço
+// fechado): ao terminar um movimento, o próximo entra na fila do
+// mesmo trabalhador. Mede a latência de cada movimento (espera na
+// fila + execução) para 1, 2, 4, ... threads até o número de núcleos.
+// Com --diario, cada rodada grava o diário (sem restaurar nada),
+// para medir o custo dele.
+// -----------------------------
+int executarCarga(int argc, char *argv[]) {
+    long nSessoes = 1000, movimentos = 200;
+    int maxThreads = numeroDeNucleos();
+    const char *dirDiario = NULL;
+    long registrosPorFoto = REGISTROS_POR_FOTO;
+    int posicional = 0;
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) maxThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--diario") == 0 && i + 1 < argc) dirDiario = argv[++i];
+        else if (strcmp(argv[i], "--foto") == 0 && i + 1 < argc) registrosPorFoto = atol(argv[++i]);
+        else if (posicional++ == 0) nSessoes = atol(argv[i]);
+        else movimentos = atol(argv[i]);
+    }
+    if (nSessoes < 1 || movimentos < 1 || maxThreads < 1 || registrosPorFoto < 1) {
+        fprintf(stderr, "Uso: --carga [sessoes] [movimentos] [--threads N] [--diario DIR [--foto N]]\n");
+        return 1;
+    }
+
+    Mansao mansao;
+    abrirMansao(&mansao, arquivoMansao);
+
+    printf("%-8s %-9s %12s %14s %10s %10s\n",
+           "threads", "sessoes", "movimentos", "movimentos/s", "p50 (us)", "p99 (us)");
+    for (int nThreads = 1; ; nThreads *= 2) {
+        if (nThreads > maxThreads) nThreads = maxThreads;
+        Servidor sv;
+        iniciarServidor(&sv, &mansao.mapa, &mansao.tabela, nThreads, movimentos);
+        if (dirDiario) prepararDiario(&sv, dirDiario, registrosPorFoto, 0);
+        atomic_store(&sv.sessoesAtivas, nSessoes);
+        double t0 = agoraSeg();
+        for (long id = 0; id < nSessoes; ++id) {
+            Comando c = { (uint32_t)id, CMD_NOVO, TEXTO_NENHUM, t0, 0, UINT32_MAX, NULL };
+            despacharComando(&sv, &c);
+        }
+        rodarTrabalhadores(&sv);
+        // espera todas as sessões simuladas chegarem ao comando de fim
+        while (atomic_load(&sv.sessoesAtivas) > 0)
+            usleep(1000);
+        pararServidor(&sv);
+        double dt = agoraSeg() - t0;
+
+        size_t total = 0;
+        for (int i = 0; i < nThreads; ++i) total += sv.trabalhadores[i].nLatencias;
+        double *todas = (double*) malloc((total ? total : 1) * sizeof(double));
+        if (!todas) { fprintf(stderr, "Erro: malloc latencias\n"); return 1; }
+        size_t k = 0;
+        for (int i = 0; i < nThreads; ++i) {
+            memcpy(todas + k, sv.trabalhadores[i].latencias,
+                   sv.trabalhadores[i].nLatencias * sizeof(double));
+            k += sv.trabalhadores[i].nLatencias;
+        }
+        qsort(todas, total, sizeof(double), compararDouble);
+        double p50 = total ? todas[total / 2] : 0.0;
+        double p99 = total ? todas[(size_t)(total * 0.99)] : 0.0;
+        printf("%-8d %-9ld %12zu %14.0f %10.2f %10.2f\n",
+               nThreads, nSessoes, total, total / dt, p50 * 1e6, p99 * 1e6);
+        free(todas);
+        liberarServidor(&sv);
+        if (nThreads == maxThreads) break;
+    }
+
+    fecharMansao(&mansao);
+    liberarPool();
+    return 0;
+}
+
+// -----------------------------
+// Análise de rotas (modo --rotas)
+// Como o mapa é uma árvore percorrida só para baixo a partir da
+// entrada, cada sessão possível é o caminho da raiz até a sala em
+// que o jogador sai: há exatamente uma rota por sala alcançável.
+// A análise percorre todas elas e, para cada suspeito, diz se
+// alguma rota reúne PISTAS_PARA_CONDENAR pistas contra ele, quantas
+// rotas o condenam e qual é a rota mínima (menos movimentos).
+//
+// Busca em profundidade paralela com roubo de trabalho: cada
+// analista usa sua própria deque como pilha (tira do fim) e, sem
+// trabalho, rouba do início da deque de outro (as salas mais
+// antigas, perto da raiz, com subárvores maiores). Quem rouba uma
+// sala reconstrói o estado da rota subindo pelos pais. Cada
+// analista acumula resultados próprios, somados só depois do join,
+// então não há trava global.
+// -----------------------------
+typedef struct DequeRotas {
+    uint32_t *itens;
+    size_t cap, inicio, fim;   // roubo em 'inicio', dono em 'fim'
+    pthread_mutex_t trava;
+} DequeRotas;
+
+// Um passo da rota atual e o que ele mudou no estado.
+typedef struct PassoRota {
+    uint32_t sala;
+    uint32_t condenou;     // suspeitos da pista que chegaram ao limite aqui
+    uint8_t pistaNova;     // pista ainda não vista nesta rota
+} PassoRota;
+
+typedef struct AnaliseRotas AnaliseRotas;
+
+typedef struct AnalistaRotas {
+    pthread_t thread;
+    AnaliseRotas *analise;
+    DequeRotas deque;
+    uint64_t semente;
+    // estado da rota atual (raiz .. sala corrente)
+    PassoRota *caminho;
+    size_t topo, capCaminho;
+    uint32_t *contagem;         // suspeito -> pistas distintas na rota
+    uint32_t *vezes;            // pista -> ocorrências na rota
+    uint32_t *condenados;       // suspeitos já condenáveis na rota (pilha)
+    uint32_t nCondenados;
+    uint32_t pistasNaRota;
+    // resultados próprios
+    uint32_t *melhorSala;       // suspeito -> sala final da rota mínima
+    uint32_t *melhorProfundidade;
+    uint64_t *rotasQueCondenam;
+    size_t visitadas;
+} AnalistaRotas;
+
+struct AnaliseRotas {
+    const Mapa *mapa;
+    const TabelaHash *tabela;
+    uint32_t *pai;              // sala -> pai (SALA_NENHUMA na raiz)
+    uint64_t *tamanho;          // sala -> salas na subárvore
+    uint32_t nTextos;
+    uint32_t alcancaveis;
+    int listar;                 // imprime cada rota (só com 1 analista)
+    int nAnalistas;
+    AnalistaRotas *analistas;
+    atomic_long restantes;      // salas ainda não visitadas
+};
+
+// -----------------------------
+// prepararArvore()
+// Pais e tamanhos das subárvores por busca em largura a partir da
+// raiz. Retorna o número de salas alcançáveis, ou 0 se o mapa não
+// for uma árvore (sala com dois pais, ciclo ou filho inválido).
+// -----------------------------
+static uint32_t prepararArvore(const Mapa *mapa, uint32_t *pai, uint64_t *tamanho) {
+    uint32_t *ordem = (uint32_t*) malloc((size_t)mapa->nSalas * sizeof(uint32_t));
+    if (!ordem) { fprintf(stderr, "Erro: malloc rotas\n"); exit(1); }
+    for (uint32_t i = 0; i < mapa->nSalas; ++i) pai[i] = SALA_NENHUMA;
+    uint32_t n = 0;
+    ordem[n++] = mapa->raiz;
+    for (uint32_t k = 0; k < n; ++k) {
+        uint32_t u = ordem[k];
+        uint32_t f[2] = { mapa->filhos[u].esq, mapa->filhos[u].dir };
+        for (int j = 0; j < 2; ++j) {
+            if (f[j] == SALA_NENHUMA) continue;
+            if (f[j] >= mapa->nSalas || f[j] == mapa->raiz || pai[f[j]] != SALA_NENHUMA) {
+                free(ordem);
+                return 0;
+            }
+            pai[f[j]] = u;
+            ordem[n++] = f[j];
+        }
+    }
+    // de trás para a frente, cada sala soma sua subárvore no pai
+    for (uint32_t k = 0; k < n; ++k) tamanho[ordem[k]] = 1;
+    for (uint32_t k = n; k-- > 1; ) tamanho[pai[ordem[k]]] += tamanho[ordem[k]];
+    free(ordem);
+    return n;
+}
+
+static void colocarNaDeque(DequeRotas *d, uint32_t sala) {
+    pthread_mutex_lock(&d->trava);
+    if (d->fim == d->cap) {
+        if (d->inicio > 0) {
+            memmove(d->itens, d->itens + d->inicio, (d->fim - d->inicio) * sizeof(uint32_t));
+            d->fim -= d->inicio;
+            d->inicio = 0;
+        }
+        if (d->fim == d->cap) {
+            d->cap *= 2;
+            d->itens = (uint32_t*) realloc(d->itens, d->cap * sizeof(uint32_t));
+            if (!d->itens) { fprintf(stderr, "Erro: realloc deque\n"); exit(1); }
+        }
+    }
+    d->itens[d->fim++] = sala;
+    pthread_mutex_unlock(&d->trava);
+}
+
+// Dono: tira do fim (a sala empilhada por último).
+static int tirarDoFim(DequeRotas *d, uint32_t *sala) {
+    pthread_mutex_lock(&d->trava);
+    int ok = d->fim > d->inicio;
+    if (ok) *sala = d->itens[--d->fim];
+    if (d->fim == d->inicio) d->inicio = d->fim = 0;
+    pthread_mutex_unlock(&d->trava);
+    return ok;
+}
+
+// Ladrão: tira do início (a sala mais antiga).
+static int roubarDoInicio(DequeRotas *d, uint32_t *sala) {
+    pthread_mutex_lock(&d->trava);
+    int ok = d->fim > d->inicio;
+    if (ok) *sala = d->itens[d->inicio++];
+    if (d->fim == d->inicio) d->inicio = d->fim = 0;
+    pthread_mutex_unlock(&d->trava);
+    return ok;
+}
+
+// Entra na sala v (filha da última sala da rota) e atualiza as contagens.
+// Com 'registrar' zero (rota refeita até uma sala roubada) só o estado
+// muda: as rotas daquelas salas já foram contadas por quem as visitou.
+static void aplicarSala(AnalistaRotas *a, uint32_t v, int registrar) {
+    const AnaliseRotas *an = a->analise;
+    PassoRota p = { v, 0, 0 };
+    IdTexto pista = an->mapa->pistas[v];
+    if (pista != TEXTO_NENHUM && pista < an->nTextos && a->vezes[pista]++ == 0) {
+        p.pistaNova = 1;
+        a->pistasNaRota++;
+        const uint32_t *suspeitos;
+        uint32_t n = suspeitosDaPista(an->tabela, pista, &suspeitos);
+        for (uint32_t i = 0; i < n; ++i) {
+            uint32_t k = suspeitos[i];
+            if (++a->contagem[k] == PISTAS_PARA_CONDENAR) {
+                // primeira sala da rota em que k fica condenável: toda rota
+                // que termina na subárvore dela também o condena
+                uint32_t profundidade = (uint32_t)a->topo;
+                p.condenou++;
+                a->condenados[a->nCondenados++] = k;
+                if (!registrar) continue;
+                a->rotasQueCondenam[k] += an->tamanho[v];
+                if (profundidade < a->melhorProfundidade[k] ||
+                    (profundidade == a->melhorProfundidade[k] && v < a->melhorSala[k])) {
+                    a->melhorProfundidade[k] = profundidade;
+                    a->melhorSala[k] = v;
+                }
+            }
+        }
+    }
+    if (a->topo == a->capCaminho) {
+        a->capCaminho *= 2;
+        a->caminho = (PassoRota*) realloc(a->caminho, a->capCaminho * sizeof(PassoRota));
+        if (!a->caminho) { fprintf(stderr, "Erro: realloc rota\n"); exit(1); }
+    }
+    a->caminho[a->topo++] = p;
+}
+
+// Sai da última sala da rota, desfazendo o que ela mudou.
+static void desfazerSala(AnalistaRotas *a) {
+    PassoRota p = a->caminho[--a->topo];
+    if (!p.pistaNova) {
+        IdTexto pista = a->analise->mapa->pistas[p.sala];
+        if (pista != TEXTO_NENHUM && pista < a->analise->nTextos) a->vezes[pista]--;
+        return;
+    }
+    IdTexto pista = a->analise->mapa->pistas[p.sala];
+    a->vezes[pista]--;
+    a->pistasNaRota--;
+    const uint32_t *suspeitos;
+    uint32_t n = suspeitosDaPista(a->analise->tabela, pista, &suspeitos);
+    for (uint32_t i = 0; i < n; ++i) a->contagem[suspeitos[i]]--;
+    a->nCondenados -= p.condenou;
+}
+
+// Deixa a rota atual terminando no pai de v: volta até ele ou, se a
+// rota ficou vazia (sala roubada), refaz o caminho desde a raiz.
+static void posicionarNoPai(AnalistaRotas *a, uint32_t v) {
+    const AnaliseRotas *an = a->analise;
+    uint32_t p = an->pai[v];
+    while (a->topo > 0 && a->caminho[a->topo - 1].sala != p) desfazerSala(a);
+    if (a->topo > 0 || p == SALA_NENHUMA) return;
+    size_t n = 0;
+    for (uint32_t u = p; u != SALA_NENHUMA; u = an->pai[u]) n++;
+    uint32_t *subida = (uint32_t*) malloc(n * sizeof(uint32_t));
+    if (!subida) { fprintf(stderr, "Erro: malloc rota\n"); exit(1); }
+    n = 0;
+    for (uint32_t u = p; u != SALA_NENHUMA; u = an->pai[u]) subida[n++] = u;
+    while (n > 0) aplicarSala(a, subida[--n], 0);
+    free(subida);
+}
+
+// Movimentos de uma rota ("e d e"); 'caminho' vai da raiz à sala final.
+static void imprimirMovimentos(const Mapa *mapa, const uint32_t *caminho, size_t n) {
+    if (n <= 1) { printf("(sair no inicio)"); return; }
+    for (size_t i = 1; i < n; ++i)
+        printf("%s%c", i > 1 ? " " : "", mapa->filhos[caminho[i - 1]].esq == caminho[i] ? 'e' : 'd');
+}
+
+static void listarRota(const AnalistaRotas *a) {
+    const Mapa *mapa = a->analise->mapa;
+    uint32_t *salas = (uint32_t*) malloc(a->topo * sizeof(uint32_t));
+    if (!salas) { fprintf(stderr, "Erro: malloc rota\n"); exit(1); }
+    for (size_t i = 0; i < a->topo; ++i) salas[i] = a->caminho[i].sala;
+    printf("rota=\"");
+    imprimirMovimentos(mapa, salas, a->topo);
+    printf("\" sala_final=\"%s\" pistas=%u condena=\"",
+           textoDe(mapa->nomes[salas[a->topo - 1]]), a->pistasNaRota);
+    for (uint32_t i = 0; i < a->nCondenados; ++i)
+        printf("%s%s", i ? ", " : "", textoDe(a->analise->tabela->suspeitos[a->condenados[i]]));
+    printf("\"\n");
+    free(salas);
+}
+
+static void* rotinaAnalista(void *arg) {
+    AnalistaRotas *a = (AnalistaRotas*) arg;
+    AnaliseRotas *an = a->analise;
+    long semBaixar = 0;   // visitas ainda não descontadas de 'restantes'
+    while (atomic_load(&an->restantes) > 0) {
+        uint32_t v;
+        if (!tirarDoFim(&a->deque, &v)) {
+            if (semBaixar) { atomic_fetch_sub(&an->restantes, semBaixar); semBaixar = 0; }
+            int achou = 0;
+            int inicio = (int)(proximoAleatorio(&a->semente) % (uint64_t)an->nAnalistas);
+            for (int k = 0; k < an->nAnalistas && !achou; ++k) {
+                AnalistaRotas *vitima = &an->analistas[(inicio + k) % an->nAnalistas];
+                if (vitima != a) achou = roubarDoInicio(&vitima->deque, &v);
+            }
+            if (!achou) { sched_yield(); continue; }
+        }
+        posicionarNoPai(a, v);
+        aplicarSala(a, v, 1);
+        if (an->listar) listarRota(a);
+        a->visitadas++;
+        if (++semBaixar == 4096) { atomic_fetch_sub(&an->restantes, semBaixar); semBaixar = 0; }
+        // direita primeiro para a esquerda sair antes (mesma ordem do jogo)
+        FilhosSala f = an->mapa->filhos[v];
+        if (f.dir != SALA_NENHUMA) colocarNaDeque(&a->deque, f.dir);
+        if (f.esq != SALA_NENHUMA) colocarNaDeque(&a->deque, f.esq);
+    }
+    if (semBaixar) atomic_fetch_sub(&an->restantes, semBaixar);
+    while (a->topo > 0) desfazerSala(a);
+    return NULL;
+}
+
+// -----------------------------
+// executarRotas()
+// ./mestre [--mapa arq.dqm] --rotas [--threads N] [--listar]
+// -----------------------------
+int executarRotas(int argc, char *argv[]) {
+    int nThreads = numeroDeNucleos(), listar = 0;
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) nThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--listar") == 0) listar = 1;
+        else {
+            fprintf(stderr, "Uso: --rotas [--threads N] [--listar]\n");
+            return 1;
+        }
+    }
+    if (nThreads < 1) nThreads = 1;
+    if (listar) nThreads = 1;   // rotas impressas na ordem do percurso
+
+    Mansao mansao;
+    abrirMansao(&mansao, arquivoMansao);
+    const Mapa *mapa = &mansao.mapa;
+    const TabelaHash *tabela = &mansao.tabela;
+    uint32_t nSusp = tabela->nSuspeitos;
+
+    AnaliseRotas an;
+    memset(&an, 0, sizeof(an));
+    an.mapa = mapa;
+    an.tabela = tabela;
+    an.nTextos = (uint32_t) pool.quantidade;
+    an.listar = listar;
+    an.nAnalistas = nThreads;
+    an.pai = (uint32_t*) malloc((size_t)mapa->nSalas * sizeof(uint32_t));
+    an.tamanho = (uint64_t*) malloc((size_t)mapa->nSalas * sizeof(uint64_t));
+    an.analistas = (AnalistaRotas*) calloc((size_t)nThreads, sizeof(AnalistaRotas));
+    if (!an.pai || !an.tamanho || !an.analistas) { fprintf(stderr, "Erro: malloc rotas\n"); exit(1); }
+    an.alcancaveis = prepararArvore(mapa, an.pai, an.tamanho);
+    if (an.alcancaveis == 0) {
+        fprintf(stderr, "Erro: o mapa nao e uma arvore (sala com dois caminhos de entrada)\n");
+        exit(1);
+    }
+    atomic_init(&an.restantes, (long)an.alcancaveis);
+
+    for (int i = 0; i < nThreads; ++i) {
+        AnalistaRotas *a = &an.analistas[i];
+        a->analise = &an;
+        a->semente = 0x9E3779B97F4A7C15ULL * (uint64_t)(i + 1);
+        a->deque.cap = 1024;
+        a->deque.itens = (uint32_t*) malloc(a->deque.cap * sizeof(uint32_t));
+        pthread_mutex_init(&a->deque.trava, NULL);
+        a->capCaminho = 64;
+        a->caminho = (PassoRota*) malloc(a->capCaminho * sizeof(PassoRota));
+        a->contagem = (uint32_t*) calloc(nSusp + 1, sizeof(uint32_t));
+        a->vezes = (uint32_t*) calloc(an.nTextos + 1, sizeof(uint32_t));
+        a->condenados = (uint32_t*) malloc((nSusp + 1) * sizeof(uint32_t));
+        a->melhorSala = (uint32_t*) malloc((nSusp + 1) * sizeof(uint32_t));
+        a->melhorProfundidade = (uint32_t*) malloc((nSusp + 1) * sizeof(uint32_t));
+        a->rotasQueCondenam = (uint64_t*) calloc(nSusp + 1, sizeof(uint64_t));
+        if (!a->deque.itens || !a->caminho || !a->contagem || !a->vezes || !a->condenados ||
+            !a->melhorSala || !a->melhorProfundidade || !a->rotasQueCondenam) {
+            fprintf(stderr, "Erro: malloc analista\n");
+            exit(1);
+        }
+        for (uint32_t k = 0; k < nSusp; ++k) {
+            a->melhorSala[k] = SALA_NENHUMA;
+            a->melhorProfundidade[k] = UINT32_MAX;
+        }
+    }
+    colocarNaDeque(&an.analistas[0].deque, mapa->raiz);
+
+    double t0 = agoraSeg();
+    for (int i = 1; i < nThreads; ++i)
+        pthread_create(&an.analistas[i].thread, NULL, rotinaAnalista, &an.analistas[i]);
+    rotinaAnalista(&an.analistas[0]);
+    for (int i = 1; i < nThreads; ++i) pthread_join(an.analistas[i].thread, NULL);
+    double dt = agoraSeg() - t0;
+
+    // junta os resultados de cada analista
+    AnalistaRotas *total = &an.analistas[0];
+    for (int i = 1; i < nThreads; ++i) {
+        AnalistaRotas *a = &an.analistas[i];
+        total->visitadas += a->visitadas;
+        for (uint32_t k = 0; k < nSusp; ++k) {
+            total->rotasQueCondenam[k] += a->rotasQueCondenam[k];
+            if (a->melhorProfundidade[k] < total->melhorProfundidade[k] ||
+                (a->melhorProfundidade[k] == total->melhorProfundidade[k] &&
+                 a->melhorSala[k] < total->melhorSala[k])) {
+                total->melhorProfundidade[k] = a->melhorProfundidade[k];
+                total->melhorSala[k] = a->melhorSala[k];
+            }
+        }
+    }
+    if (total->visitadas != an.alcancaveis)
+        fprintf(stderr, "aviso: %zu rotas visitadas de %u\n", total->visitadas, an.alcancaveis);
+
+    printf("rotas=%u threads=%d tempo=%.3f s (%.0f rotas/s)\n",
+           an.alcancaveis, nThreads, dt, dt > 0 ? an.alcancaveis / dt : 0.0);
+    printf("%-24s %-10s %18s  %s\n", "suspeito", "condenavel", "rotas_que_condenam", "rota_minima");
+    for (uint32_t k = 0; k < nSusp; ++k) {
+        printf("%-24s %-10s %18llu  ", textoDe(tabela->suspeitos[k]),
+               total->rotasQueCondenam[k] ? "sim" : "nao",
+               (unsigned long long) total->rotasQueCondenam[k]);
+        uint32_t v = total->melhorSala[k];
+        if (v == SALA_NENHUMA) { printf("-\n"); continue; }
+        uint32_t n = total->melhorProfundidade[k] + 1;
+        uint32_t *caminho = (uint32_t*) malloc((size_t)n * sizeof(uint32_t));
+        if (!caminho) { fprintf(stderr, "Erro: malloc rota\n"); exit(1); }
+        for (uint32_t i = n, u = v; i-- > 0; u = an.pai[u]) caminho[i] = u;
+        printf("\"");
+        imprimirMovimentos(mapa, caminho, n);
+        printf("\" (%s)\n", textoDe(mapa->nomes[v]));
+        free(caminho);
+    }
+
+    for (int i = 0; i < nThreads; ++i) {
+        AnalistaRotas *a = &an.analistas[i];
+        pthread_mutex_destroy(&a->deque.trava);
+        free(a->deque.itens); free(a->caminho); free(a->contagem); free(a->vezes);
+        free(a->condenados); free(a->melhorSala); free(a->melhorProfundidade);
+        free(a->rotasQueCondenam);
+    }
+    free(an.analistas);
+    free(an.pai);
+    free(an.tamanho);
+    fecharMansao(&mansao);
+    liberarPool();
+    return 0;
+}
+
+// -----------------------------
+// Grafo de salas (modo --grafo)
+// O Mapa é uma árvore: duas saídas por sala e nenhuma volta, o que
+// obriga a simular corredores com salas de passagem. O grafo aceita
+// qualquer número de saídas com nome por sala, inclusive voltas e
+// ciclos, em formato CSR (linhas esparsas comprimidas): as saídas da
+// sala s ocupam as posições inicio[s] .. inicio[s + 1] de 'destino'
+// e 'rotulo', todas num único vetor ordenado pela sala de origem. A
+// transposta (quem tem saída para cada sala) fica ao lado no mesmo
+// formato, para as buscas que andam de trás para frente.
+// Montado por contagem em O(salas + saídas), sem ordenar.
+// -----------------------------
+typedef struct SaidaSala {
+    uint32_t origem;
+    uint32_t destino;
+    IdTexto nome;              // "norte", "escada", "voltar"...
+} SaidaSala;
+
+typedef struct GrafoSalas {
+    uint32_t nSalas;
+    uint64_t nSaidas;
+    uint64_t *inicio;          // nSalas + 1 posições
+    uint32_t *destino;
+    IdTexto *rotulo;
+    uint64_t *inicioEntradas;  // transposta, também nSalas + 1
+    uint32_t *origem;
+    IdTexto *nomes;            // nome de cada sala (ou NULL)
+} GrafoSalas;
+
+// -----------------------------
+// montarGrafo()
+// Monta o CSR a partir das saídas em qualquer ordem; as saídas de
+// uma mesma sala mantêm a ordem da lista. 'nomes' (pode ser NULL)
+// passa a pertencer ao grafo.
+// -----------------------------
+void montarGrafo(GrafoSalas *g, uint32_t nSalas, const SaidaSala *saidas, uint64_t n,
+                 IdTexto *nomes) {
+    size_t m = n ? (size_t)n : 1;
+    g->nSalas = nSalas;
+    g->nSaidas = n;
+    g->inicio = (uint64_t*) calloc((size_t)nSalas + 1, sizeof(uint64_t));
+    g->inicioEntradas = (uint64_t*) calloc((size_t)nSalas + 1, sizeof(uint64_t));
+    g->destino = (uint32_t*) malloc(m * sizeof(uint32_t));
+    g->rotulo = (IdTexto*) malloc(m * sizeof(IdTexto));
+    g->origem = (uint32_t*) malloc(m * sizeof(uint32_t));
+    g->nomes = nomes;
+    if (!g->inicio || !g->inicioEntradas || !g->destino || !g->rotulo || !g->origem) {
+        fprintf(stderr, "Erro: malloc grafo\n");
+        exit(1);
+    }
+    for (uint64_t i = 0; i < n; ++i) {
+        g->inicio[saidas[i].origem + 1]++;
+        g->inicioEntradas[saidas[i].destino + 1]++;
+    }
+    for (uint32_t s = 0; s < nSalas; ++s) {
+        g->inicio[s + 1] += g->inicio[s];
+        g->inicioEntradas[s + 1] += g->inicioEntradas[s];
+    }
+    // distribui usando inicio[s] como cursor: ao fim ele aponta para
+    // o começo da sala s + 1, e um deslocamento restaura os inícios
+    for (uint64_t i = 0; i < n; ++i) {
+        uint64_t p = g->inicio[saidas[i].origem]++;
+        g->destino[p] = saidas[i].destino;
+        g->rotulo[p] = saidas[i].nome;
+        g->origem[g->inicioEntradas[saidas[i].destino]++] = saidas[i].origem;
+    }
+    memmove(g->inicio + 1, g->inicio, (size_t)nSalas * sizeof(uint64_t));
+    memmove(g->inicioEntradas + 1, g->inicioEntradas, (size_t)nSalas * sizeof(uint64_t));
+    g->inicio[0] = g->inicioEntradas[0] = 0;
+}
+
+void liberarGrafo(GrafoSalas *g) {
+    free(g->inicio);
+    free(g->destino);
+    free(g->rotulo);
+    free(g->inicioEntradas);
+    free(g->origem);
+    free(g->nomes);
+    memset(g, 0, sizeof(*g));
+}
+
+// -----------------------------
+// grafoDoMapa()
+// O mapa em árvore como grafo: saídas "esquerda" e "direita" como
+// no jogo e, em cada filho, uma saída "voltar" para a sala de cima.
+// -----------------------------
+void grafoDoMapa(const Mapa *mapa, GrafoSalas *g) {
+    SaidaSala *saidas = (SaidaSala*) malloc(4 * (size_t)mapa->nSalas * sizeof(SaidaSala));
+    IdTexto *nomes = (IdTexto*) malloc((size_t)mapa->nSalas * sizeof(IdTexto));
+    if (!saidas || !nomes) { fprintf(stderr, "Erro: malloc grafo\n"); exit(1); }
+    IdTexto esquerda = internar("esquerda"), direita = internar("direita");
+    IdTexto voltar = internar("voltar");
+    uint64_t n = 0;
+    for (uint32_t i = 0; i < mapa->nSalas; ++i) {
+        FilhosSala f = mapa->filhos[i];
+        if (f.esq != SALA_NENHUMA) {
+            saidas[n++] = (SaidaSala){ i, f.esq, esquerda };
+            saidas[n++] = (SaidaSala){ f.esq, i, voltar };
+        }
+        if (f.dir != SALA_NENHUMA) {
+            saidas[n++] = (SaidaSala){ i, f.dir, direita };
+            saidas[n++] = (SaidaSala){ f.dir, i, voltar };
+        }
+    }
+    memcpy(nomes, mapa->nomes, (size_t)mapa->nSalas * sizeof(IdTexto));
+    montarGrafo(g, mapa->nSalas, saidas, n, nomes);
+    free(saidas);
+}
+
+// -----------------------------
+// lerGrafo()
+// Descrição em texto no formato de --converter, mais saídas livres:
+//   sala <nome>[;<pista>;<sala à esquerda>;<sala à direita>]
+//   saida <sala>;<nome da saída>;<sala de chegada>
+// Esquerda e direita viram saídas "esquerda" e "direita"; voltas
+// e ciclos são declarados com 'saida'. Linhas 'pista' são aceitas
+// e ignoradas, então uma descrição de mansão serve sem mudanças.
+// Retorna 0 ou 1 (erro já relatado).
+// -----------------------------
+int lerGrafo(const char *arquivo, GrafoSalas *g) {
+    size_t tamanho;
+    char *texto = lerArquivoInteiro(arquivo, &tamanho);
+    if (!texto) return 1;
+    // até resolver os nomes, origem e destino guardam ids de nomes
+    uint64_t nSaidas = 0, capSaidas = 1024;
+    uint32_t nSalas = 0, capSalas = 1024;
+    SaidaSala *saidas = (SaidaSala*) malloc(capSaidas * sizeof(SaidaSala));
+    IdTexto *nomes = (IdTexto*) malloc(capSalas * sizeof(IdTexto));
+    if (!saidas || !nomes) { fprintf(stderr, "Erro: malloc grafo\n"); exit(1); }
+    IdTexto esquerda = internar("esquerda"), direita = internar("direita");
+    int erro = 0, numero = 0;
+    char *linha = texto;
+    while (linha && *linha && !erro) {
+        char *prox = strchr(linha, '\n');
+        if (prox) *prox++ = '\0';
+        numero++;
+        char *l = aparar(linha);
+        linha = prox;
+        if (*l == '\0' || *l == '#' || strncmp(l, "pista ", 6) == 0) continue;
+        char *campos[4] = { "", "", "", "" };
+        SaidaSala novas[2];
+        int nNovas = 0;
+        if (strncmp(l, "sala ", 5) == 0) {
+            dividirCampos(l + 5, campos, 4);
+            if (*campos[0] == '\0') {
+                fprintf(stderr, "Erro: linha %d: sala sem nome\n", numero);
+                erro = 1;
+                break;
+            }
+            if (nSalas == capSalas) {
+                capSalas *= 2;
+                nomes = (IdTexto*) realloc(nomes, capSalas * sizeof(IdTexto));
+                if (!nomes) { fprintf(stderr, "Erro: realloc grafo\n"); exit(1); }
+            }
+            IdTexto nome = internar(campos[0]);
+            nomes[nSalas++] = nome;
+            if (*campos[2]) novas[nNovas++] = (SaidaSala){ nome, internar(campos[2]), esquerda };
+            if (*campos[3]) novas[nNovas++] = (SaidaSala){ nome, internar(campos[3]), direita };
+        } else if (strncmp(l, "saida ", 6) == 0) {
+            if (dividirCampos(l + 6, campos, 4) != 3 || !*campos[0] || !*campos[1] || !*campos[2]) {
+                fprintf(stderr, "Erro: linha %d: esperado 'saida <sala>;<nome>;<sala de chegada>'\n",
+                        numero);
+                erro = 1;
+                break;
+            }
+            novas[nNovas++] = (SaidaSala){ internar(campos[0]), internar(campos[2]),
+                                           internar(campos[1]) };
+        } else {
+            fprintf(stderr, "Erro: linha %d: esperado 'sala', 'saida' ou 'pista'\n", numero);
+            erro = 1;
+            break;
+        }
+        for (int k = 0; k < nNovas; ++k) {
+            if (nSaidas == capSaidas) {
+                capSaidas *= 2;
+                saidas = (SaidaSala*) realloc(saidas, capSaidas * sizeof(SaidaSala));
+                if (!saidas) { fprintf(stderr, "Erro: realloc grafo\n"); exit(1); }
+            }
+            saidas[nSaidas++] = novas[k];
+        }
+    }
+    if (!erro && nSalas == 0) {
+        fprintf(stderr, "Erro: nenhuma sala declarada em %s\n", arquivo);
+        erro = 1;
+    }
+    uint32_t *salaDoNome = NULL;
+    if (!erro) {
+        salaDoNome = (uint32_t*) malloc(pool.quantidade * sizeof(uint32_t));
+        if (!salaDoNome) { fprintf(stderr, "Erro: malloc grafo\n"); exit(1); }
+        for (IdTexto i = 0; i < pool.quantidade; ++i) salaDoNome[i] = SALA_NENHUMA;
+        for (uint32_t i = 0; i < nSalas && !erro; ++i) {
+            if (salaDoNome[nomes[i]] != SALA_NENHUMA) {
+                fprintf(stderr, "Erro: sala '%s' declarada duas vezes\n", textoDe(nomes[i]));
+                erro = 1;
+            }
+            salaDoNome[nomes[i]] = i;
+        }
+        for (uint64_t i = 0; i < nSaidas && !erro; ++i) {
+            uint32_t de = salaDoNome[saidas[i].origem], para = salaDoNome[saidas[i].destino];
+            if (de == SALA_NENHUMA || para == SALA_NENHUMA) {
+                fprintf(stderr, "Erro: sala '%s' (saida '%s' de '%s') nao declarada\n",
+                        textoDe(de == SALA_NENHUMA ? saidas[i].origem : saidas[i].destino),
+                        textoDe(saidas[i].nome), textoDe(saidas[i].origem));
+                erro = 1;
+            }
+            saidas[i].origem = de;
+            saidas[i].destino = para;
+        }
+    }
+    if (!erro) montarGrafo(g, nSalas, saidas, nSaidas, nomes);
+    else free(nomes);
+    free(salaDoNome);
+    free(saidas);
+    free(texto);
+    return erro;
+}
+
+// -----------------------------
+// Buscas em largura sobre o grafo
+// Memória de trabalho reaproveitada entre consultas. Cada lado da
+// busca marca as salas com a época da consulta, então começar uma
+// consulta nova não limpa nada: uma rota curta num grafo enorme
+// custa o que ela visita, não o tamanho do grafo.
+// -----------------------------
+typedef struct LadoBusca {
+    uint32_t *marca;           // época em que a sala foi alcançada
+    uint32_t *distancia;
+    uint32_t *vizinho;         // sala pela qual foi alcançada
+    uint32_t *fila;
+} LadoBusca;
+
+typedef struct BuscaGrafo {
+    LadoBusca lado[2];         // 0: da origem pelas saídas; 1: do destino pelas entradas
+    uint32_t *caminho;
+    uint64_t *visitadas;       // bitsets do alcance (uma palavra por 64 salas)
+    uint64_t *fronteira;
+    uint64_t *proxima;
+    uint32_t epoca;
+    uint32_t nSalas;
+} BuscaGrafo;
+
+void iniciarBuscaGrafo(BuscaGrafo *b, const GrafoSalas *g) {
+    size_t n = g->nSalas ? g->nSalas : 1, palavras = (n + 63) / 64;
+    for (int k = 0; k < 2; ++k) {
+        LadoBusca *l = &b->lado[k];
+        l->marca = (uint32_t*) calloc(n, sizeof(uint32_t));
+        l->distancia = (uint32_t*) malloc(n * sizeof(uint32_t));
+        l->vizinho = (uint32_t*) malloc(n * sizeof(uint32_t));
+        l->fila = (uint32_t*) malloc(n * sizeof(uint32_t));
+        if (!l->marca || !l->distancia || !l->vizinho || !l->fila) {
+            fprintf(stderr, "Erro: malloc busca no grafo\n");
+            exit(1);
+        }
+    }
+    b->caminho = (uint32_t*) malloc(n * sizeof(uint32_t));
+    b->visitadas = (uint64_t*) malloc(palavras * sizeof(uint64_t));
+    b->fronteira = (uint64_t*) malloc(palavras * sizeof(uint64_t));
+    b->proxima = (uint64_t*) malloc(palavras * sizeof(uint64_t));
+    if (!b->caminho || !b->visitadas || !b->fronteira || !b->proxima) {
+        fprintf(stderr, "Erro: malloc busca no grafo\n");
+        exit(1);
+    }
+    b->epoca = 0;
+    b->nSalas = g->nSalas;
+}
+
+void liberarBuscaGrafo(BuscaGrafo *b) {
+    for (int k = 0; k < 2; ++k) {
+        free(b->lado[k].marca);
+        free(b->lado[k].distancia);
+        free(b->lado[k].vizinho);
+        free(b->lado[k].fila);
+    }
+    free(b->caminho);
+    free(b->visitadas);
+    free(b->fronteira);
+    free(b->proxima);
+}
+
+static uint32_t novaEpoca(BuscaGrafo *b) {
+    if (++b->epoca == 0) {     // deu a volta: marcas antigas voltariam a valer
+        for (int k = 0; k < 2; ++k) memset(b->lado[k].marca, 0, b->nSalas * sizeof(uint32_t));
+        b->epoca = 1;
+    }
+    return b->epoca;
+}
+
+// Nome de uma saída de 'de' que leva a 'para'.
+static IdTexto saidaEntre(const GrafoSalas *g, uint32_t de, uint32_t para) {
+    for (uint64_t e = g->inicio[de]; e < g->inicio[de + 1]; ++e)
+        if (g->destino[e] == para) return g->rotulo[e];
+    return TEXTO_NENHUM;
+}
+
+// -----------------------------
+// rotaMaisCurta()
+// Menor número de movimentos de 'de' até 'para'. Busca em largura
+// bidirecional: a partir da origem pelas saídas e do destino pelas
+// entradas, expandindo um nível inteiro do lado com a fila menor.
+// No primeiro nível em que os lados se tocam, toda sala de encontro
+// dá uma rota de comprimento mínimo (nenhuma sala estava nos dois
+// lados antes, então nenhuma rota é mais curta). Com fator de
+// ramificação d e distância L, visita cerca de 2 d^(L/2) salas em
+// vez de d^L.
+// Retorna o número de salas da rota (0: sem caminho) e aponta
+// *caminho para elas, da origem ao destino, na memória de 'b'.
+// -----------------------------
+uint32_t rotaMaisCurta(const GrafoSalas *g, BuscaGrafo *b, uint32_t de, uint32_t para,
+                       const uint32_t **caminho) {
+    *caminho = b->caminho;
+    if (de == para) { b->caminho[0] = de; return 1; }
+    uint32_t epoca = novaEpoca(b);
+    uint32_t inicioFila[2] = { 0, 0 }, fimFila[2] = { 1, 1 }, nivel[2] = { 0, 0 };
+    uint32_t partida[2] = { de, para };
+    for (int k = 0; k < 2; ++k) {
+        LadoBusca *l = &b->lado[k];
+        l->marca[partida[k]] = epoca;
+        l->distancia[partida[k]] = 0;
+        l->vizinho[partida[k]] = SALA_NENHUMA;
+        l->fila[0] = partida[k];
+    }
+    uint32_t melhor = UINT32_MAX, encontro = SALA_NENHUMA;
+    while (melhor == UINT32_MAX && inicioFila[0] < fimFila[0] && inicioFila[1] < fimFila[1]) {
+        int k = fimFila[0] - inicioFila[0] <= fimFila[1] - inicioFila[1] ? 0 : 1;
+        LadoBusca *l = &b->lado[k];
+        const LadoBusca *outro = &b->lado[1 - k];
+        const uint64_t *inicio = k == 0 ? g->inicio : g->inicioEntradas;
+        const uint32_t *vizinhos = k == 0 ? g->destino : g->origem;
+        uint32_t fimNivel = fimFila[k];
+        nivel[k]++;
+        for (uint32_t i = inicioFila[k]; i < fimNivel; ++i) {
+            uint32_t u = l->fila[i];
+            for (uint64_t e = inicio[u]; e < inicio[u + 1]; ++e) {
+                uint32_t v = vizinhos[e];
+                if (l->marca[v] == epoca) continue;
+                l->marca[v] = epoca;
+                l->distancia[v] = nivel[k];
+                l->vizinho[v] = u;
+                l->fila[fimFila[k]++] = v;
+                if (outro->marca[v] == epoca && nivel[k] + outro->distancia[v] < melhor) {
+                    melhor = nivel[k] + outro->distancia[v];
+                    encontro = v;
+                }
+            }
+        }
+        inicioFila[k] = fimNivel;
+    }
+    if (melhor == UINT32_MAX) return 0;
+    // origem .. encontro pelos vizinhos do lado 0 (de trás para frente),
+    // depois encontro .. destino pelos do lado 1
+    uint32_t n = b->lado[0].distancia[encontro] + 1;
+    uint32_t i = n;
+    for (uint32_t s = encontro; s != SALA_NENHUMA; s = b->lado[0].vizinho[s]) b->caminho[--i] = s;
+    for (uint32_t s = b->lado[1].vizinho[encontro]; s != SALA_NENHUMA; s = b->lado[1].vizinho[s])
+        b->caminho[n++] = s;
+    return n;
+}
+
+// -----------------------------
+// alcanceGrafo()
+// Quantas salas são alcançáveis a partir de 'de' (incluindo ela) e
+// em quantos movimentos no máximo (*profundidade). Busca em largura
+// que troca de direção (Beamer): de cima para baixo, cada sala da
+// fronteira olha suas saídas; quando a fronteira tem mais saídas do
+// que as entradas das salas não visitadas / ALFA_GRAFO, passa a
+// olhar de baixo para cima: cada sala não visitada procura, pelas
+// entradas, alguém na fronteira e para no primeiro. Volta quando a
+// fronteira cai abaixo de salas / BETA_GRAFO. Nos níveis do meio
+// de um grafo com ciclos isso evita examinar quase todas as saídas
+// só para descobrir que o destino já foi visitado.
+// otimizarDirecao = 0 fica sempre de cima para baixo.
+// -----------------------------
+#define ALFA_GRAFO 14
+#define BETA_GRAFO 24
+
+static inline int bitLigado(const uint64_t *bits, uint32_t i) {
+    return (bits[i >> 6] >> (i & 63)) & 1;
+}
+
+static inline void ligarBit(uint64_t *bits, uint32_t i) {
+    bits[i >> 6] |= 1ull << (i & 63);
+}
+
+uint64_t alcanceGrafo(const GrafoSalas *g, BuscaGrafo *b, uint32_t de, int otimizarDirecao,
+                      uint32_t *profundidade) {
+    size_t palavras = ((size_t)g->nSalas + 63) / 64;
+    memset(b->visitadas, 0, palavras * sizeof(uint64_t));
+    uint32_t *fila = b->lado[0].fila, *proximaFila = b->lado[1].fila;
+    uint32_t nFila = 1;
+    fila[0] = de;
+    ligarBit(b->visitadas, de);
+    uint64_t alcancadas = 1;
+    // saídas da fronteira e entradas das salas ainda não visitadas
+    uint64_t saidasFronteira = g->inicio[de + 1] - g->inicio[de];
+    uint64_t entradasRestantes = g->nSaidas - (g->inicioEntradas[de + 1] - g->inicioEntradas[de]);
+    int deBaixo = 0;
+    uint32_t niveis = 0;
+    while (nFila > 0) {
+        if (otimizarDirecao && !deBaixo && saidasFronteira > entradasRestantes / ALFA_GRAFO) {
+            memset(b->fronteira, 0, palavras * sizeof(uint64_t));
+            for (uint32_t i = 0; i < nFila; ++i) ligarBit(b->fronteira, fila[i]);
+            deBaixo = 1;
+        }
+        uint32_t nProxima = 0;
+        saidasFronteira = 0;
+        if (!deBaixo) {
+            for (uint32_t i = 0; i < nFila; ++i) {
+                uint32_t u = fila[i];
+                for (uint64_t e = g->inicio[u]; e < g->inicio[u + 1]; ++e) {
+                    uint32_t v = g->destino[e];
+                    if (bitLigado(b->visitadas, v)) continue;
+                    ligarBit(b->visitadas, v);
+                    proximaFila[nProxima++] = v;
+                    saidasFronteira += g->inicio[v + 1] - g->inicio[v];
+                    entradasRestantes -= g->inicioEntradas[v + 1] - g->inicioEntradas[v];
+                }
+            }
+            uint32_t *t = fila; fila = proximaFila; proximaFila = t;
+        } else {
+            memset(b->proxima, 0, palavras * sizeof(uint64_t));
+            for (size_t w = 0; w < palavras; ++w) {
+                uint64_t livres = ~b->visitadas[w];
+                if (w == palavras - 1 && (g->nSalas & 63))
+                    livres &= (1ull << (g->nSalas & 63)) - 1;
+                while (livres) {
+                    uint32_t v = (uint32_t)(w * 64 + (size_t)__builtin_ctzll(livres));
+                    livres &= livres - 1;
+                    for (uint64_t e = g->inicioEntradas[v]; e < g->inicioEntradas[v + 1]; ++e) {
+                        if (!bitLigado(b->fronteira, g->origem[e])) continue;
+                        ligarBit(b->proxima, v);
+                        nProxima++;
+                        saidasFronteira += g->inicio[v + 1] - g->inicio[v];
+                        entradasRestantes -= g->inicioEntradas[v + 1] - g->inicioEntradas[v];
+                        break;
+                    }
+                }
+            }
+            for (size_t w = 0; w < palavras; ++w) b->visitadas[w] |= b->proxima[w];
+            uint64_t *t = b->fronteira; b->fronteira = b->proxima; b->proxima = t;
+            if (nProxima < g->nSalas / BETA_GRAFO) {
+                // fronteira pequena de novo: volta para a fila
+                uint32_t n = 0;
+                for (size_t w = 0; w < palavras; ++w)
+                    for (uint64_t bits = b->fronteira[w]; bits; bits &= bits - 1)
+                        fila[n++] = (uint32_t)(w * 64 + (size_t)__builtin_ctzll(bits));
+                deBaixo = 0;
+            }
+        }
+        nFila = nProxima;
+        alcancadas += nProxima;
+        if (nProxima) niveis++;
+    }
+    if (profundidade) *profundidade = niveis;
+    return alcancadas;
+}
+
+// -----------------------------
+// executarGrafo()
+// ./mestre [--mapa arq.dqm] --grafo [descricao.txt]
+// Monta o grafo da descrição (ver lerGrafo()) ou, sem ela, o da
+// mansão com as voltas, e responde consultas lidas da entrada,
+// uma por linha ('#' comenta):
+//   rota <sala>;<sala>     menor rota, com o nome de cada saída
+//   alcance <sala>         salas alcançáveis e a maior distância
+// Uma sala é dada pelo nome ou por #<posição> (mansões geradas
+// repetem nomes).
+// -----------------------------
+static uint32_t salaDaConsulta(const GrafoSalas *g, const uint32_t *salaDoNome, uint32_t nIds,
+                               const char *texto) {
+    if (texto[0] == '#' && isdigit((unsigned char)texto[1])) {
+        char *fim;
+        unsigned long i = strtoul(texto + 1, &fim, 10);
+        return *fim == '\0' && i < g->nSalas ? (uint32_t)i : SALA_NENHUMA;
+    }
+    IdTexto id = buscarTexto(texto);
+    return id != TEXTO_NENHUM && id < nIds ? salaDoNome[id] : SALA_NENHUMA;
+}
+
+static void imprimirSalaGrafo(const GrafoSalas *g, uint32_t s) {
+    if (g->nomes && g->nomes[s] != TEXTO_NENHUM) printf("%s", textoDe(g->nomes[s]));
+    else printf("#%u", s);
+}
+
+int executarGrafo(int argc, char *argv[]) {
+    if (argc > 1) {
+        fprintf(stderr, "Uso: --grafo [descricao.txt]\n");
+        return 1;
+    }
+    Mansao mansao;
+    int temMansao = argc == 0;
+    GrafoSalas grafo;
+    double t0 = agoraSeg();
+    if (temMansao) {
+        abrirMansao(&mansao, arquivoMansao);
+        grafoDoMapa(&mansao.mapa, &grafo);
+    } else if (lerGrafo(argv[0], &grafo)) {
+        liberarPool();
+        return 1;
+    }
+    fprintf(stderr, "grafo: %u salas, %llu saidas em %.1f ms\n", grafo.nSalas,
+            (unsigned long long)grafo.nSaidas, (agoraSeg() - t0) * 1e3);
+
+    // nome -> sala (a primeira com o nome)
+    uint32_t nIds = pool.quantidade;
+    uint32_t *salaDoNome = (uint32_t*) malloc((size_t)nIds * sizeof(uint32_t));
+    if (!salaDoNome) { fprintf(stderr, "Erro: malloc grafo\n"); exit(1); }
+    for (uint32_t i = 0; i < nIds; ++i) salaDoNome[i] = SALA_NENHUMA;
+    for (uint32_t s = grafo.nSalas; s-- > 0; )
+        if (grafo.nomes[s] != TEXTO_NENHUM) salaDoNome[grafo.nomes[s]] = s;
+
+    BuscaGrafo busca;
+    iniciarBuscaGrafo(&busca, &grafo);
+    char linha[2 * MAX_NOME + 16];
+    while (fgets(linha, sizeof(linha), stdin)) {
+        char *l = aparar(linha);
+        if (*l == '\0' || *l == '#') continue;
+        if (strncmp(l, "rota ", 5) == 0) {
+            char *campos[2] = { "", "" };
+            int nCampos = dividirCampos(l + 5, campos, 2);
+            uint32_t de = salaDaConsulta(&grafo, salaDoNome, nIds, campos[0]);
+            uint32_t para = nCampos == 2 ? salaDaConsulta(&grafo, salaDoNome, nIds, campos[1])
+                                         : SALA_NENHUMA;
+            if (de == SALA_NENHUMA || para == SALA_NENHUMA) {
+                printf("erro: sala desconhecida '%s'\n", de == SALA_NENHUMA ? campos[0] : campos[1]);
+                continue;
+            }
+            const uint32_t *caminho;
+            uint32_t n = rotaMaisCurta(&grafo, &busca, de, para, &caminho);
+            imprimirSalaGrafo(&grafo, de);
+            printf(" -> ");
+            imprimirSalaGrafo(&grafo, para);
+            if (n == 0) {
+                printf(": sem caminho\n");
+                continue;
+            }
+            printf(": %u movimentos: ", n - 1);
+            imprimirSalaGrafo(&grafo, caminho[0]);
+            for (uint32_t i = 1; i < n; ++i) {
+                printf(" -(%s)-> ", textoDe(saidaEntre(&grafo, caminho[i - 1], caminho[i])));
+                imprimirSalaGrafo(&grafo, caminho[i]);
+            }
+            printf("\n");
+        } else if (strncmp(l, "alcance ", 8) == 0) {
+            char *nome = aparar(l + 8);
+            uint32_t de = salaDaConsulta(&grafo, salaDoNome, nIds, nome);
+            if (de == SALA_NENHUMA) {
+                printf("erro: sala desconhecida '%s'\n", nome);
+                continue;
+            }
+            uint32_t profundidade;
+            uint64_t n = alcanceGrafo(&grafo, &busca, de, 1, &profundidade);
+            printf("alcance ");
+            imprimirSalaGrafo(&grafo, de);
+            printf(": %llu salas, ate %u movimentos\n", (unsigned long long)n, profundidade);
+        } else {
+            printf("erro: esperado 'rota <sala>;<sala>' ou 'alcance <sala>'\n");
+        }
+    }
+    liberarBuscaGrafo(&busca);
+    free(salaDoNome);
+    liberarGrafo(&grafo);
+    if (temMansao) fecharMansao(&mansao);
+    liberarPool();
+    return 0;
+}
+
+// -----------------------------
+// Benchmark da BST de pistas (modo --bench-pistas)
+// Compara a BST original sem balanceamento com a AVL atual
+// nas cargas ordenada, inversa e aleatória.
+// -----------------------------
+// BST sem balanceamento (comportamento anterior), iterativa para que
+// a carga ordenada não estoure a pilha durante a medição.
+static void inserirPistaSemBalanceamento(ArvorePistas *arv, IdTexto pista) {
+    RefPista novo = novoNoPista(arv);
+    PistaNode *n = NO_PISTA(arv, novo);
+    n->pista = pista;
+    n->altura = 1;
+    n->tamanho = 1;
+    n->esq = n->dir = PISTA_NULA;
+    if (arv->raiz == PISTA_NULA) { arv->raiz = novo; return; }
+    PistaNode *cur = NO_PISTA(arv, arv->raiz);
+    while (1) {
+        RefPista *lado = compararPistas(pista, cur->pista) < 0 ? &cur->esq : &cur->dir;
+        if (*lado == PISTA_NULA) { *lado = novo; return; }
+        cur = NO_PISTA(arv, *lado);
+    }
+}
+
+static int alturaReal(const ArvorePistas *arv) {
+    // medida iterativa por níveis (BST degenerada pode ter milhares de níveis)
+    if (arv->raiz == PISTA_NULA) return 0;
+    int cap = 1024, ini = 0, fim = 0, altura = 0;
+    RefPista *fila = (RefPista*) malloc(cap * sizeof(RefPista));
+    if (!fila) { fprintf(stderr, "Erro: malloc benchmark\n"); exit(1); }
+    fila[fim++] = arv->raiz;
+    while (ini < fim) {
+        int nivelFim = fim;
+        altura++;
+        while (ini < nivelFim) {
+            const PistaNode *n = NO_PISTA(arv, fila[ini++]);
+            RefPista filhos[2] = { n->esq, n->dir };
+            for (int k = 0; k < 2; ++k) {
+                if (filhos[k] == PISTA_NULA) continue;
+                if (fim == cap) {
+                    RefPista *nova = (RefPista*) realloc(fila, 2 * cap * sizeof(RefPista));
+                    if (!nova) { fprintf(stderr, "Erro: realloc benchmark\n"); exit(1); }
+                    fila = nova; cap *= 2;
+                }
+                fila[fim++] = filhos[k];
+            }
+        }
+    }
+    free(fila);
+    return altura;
+}
+
+static void medirInsercoes(const char *rotulo, const IdTexto *chaves, int n,
+                           void (*inserir)(ArvorePistas*, IdTexto)) {
+    ArvorePistas arv;
+    iniciarArvorePistas(&arv);
+    double t0 = agoraSeg();
+    for (int i = 0; i < n; ++i) inserir(&arv, chaves[i]);
+    double dt = agoraSeg() - t0;
+    printf("  %-18s n=%-8d %10.3f ms  %8.1f ns/insercao  altura=%d\n",
+           rotulo, n, dt * 1e3, dt * 1e9 / n, alturaReal(&arv));
+    liberarArvorePistas(&arv);
+}
+
+int benchPistas(int nAvl, int nSemBal) {
+    int n = nAvl > nSemBal ? nAvl : nSemBal;
+    IdTexto *ordenadas = (IdTexto*) malloc((size_t)n * sizeof(IdTexto));
+    IdTexto *carga = (IdTexto*) malloc((size_t)n * sizeof(IdTexto));
+    if (!ordenadas || !carga) { fprintf(stderr, "Erro: malloc benchmark\n"); return 1; }
+    // textos internados antes da medição
+    char texto[MAX_PISTA];
+    for (int i = 0; i < n; ++i) {
+        snprintf(texto, MAX_PISTA, "Pista %09d encontrada no cômodo", i);
+        ordenadas[i] = internar(texto);
+    }
+
+    const char *nomes[] = { "ordenada", "inversa", "aleatoria" };
+    srand(12345);
+    for (int w = 0; w < 3; ++w) {
+        printf("Carga %s:\n", nomes[w]);
+        for (int modo = 0; modo < 2; ++modo) {
+            int m = modo == 0 ? nSemBal : nAvl;
+            // gera as m chaves da carga a partir das m primeiras pistas ordenadas
+            for (int i = 0; i < m; ++i)
+                carga[i] = ordenadas[w == 1 ? m - 1 - i : i];
+            if (w == 2) {
+                for (int i = m - 1; i > 0; --i) {
+                    int j = (int)(((unsigned long)rand() * (RAND_MAX + 1UL) + rand()) % (i + 1));
+                    IdTexto tmp = carga[i];
+                    carga[i] = carga[j];
+                    carga[j] = tmp;
+                }
+            }
+            if (modo == 0) medirInsercoes("antes (BST)", carga, m, inserirPistaSemBalanceamento);
+            else           medirInsercoes("depois (AVL)", carga, m, inserirPista);
+        }
+    }
+    free(ordenadas);
+    free(carga);
+    return 0;
+}
+
+// -----------------------------
+// Benchmark da tabela hash (modo --bench-hash)
+// Compara a tabela encadeada fixa de 101 listas (versão anterior)
+// com a tabela de endereçamento aberto, para tamanhos crescentes,
+// e mede as buscas por id com e sem o filtro de Bloom.
+// -----------------------------
+#define HASH_ANTIGA_TAM 101
+
+typedef struct NoEncadeado {
+    char pista[MAX_PISTA];
+    char suspeito[MAX_NOME];
+    struct NoEncadeado *prox;
+} NoEncadeado;
+
+static const char* buscarEncadeada(NoEncadeado *tab[], const char *pista) {
+    for (NoEncadeado *n = tab[hash_djb2(pista) % HASH_ANTIGA_TAM]; n; n = n->prox)
+        if (strcmp(n->pista, pista) == 0) return n->suspeito;
+    return NULL;
+}
+
+int benchHash(size_t nMax) {
+    char chave[MAX_PISTA];
+    const size_t consultas = 200000;
+    printf("%-10s %-10s %12s %12s %8s %10s %8s\n",
+           "n", "tabela", "ns/acerto", "ns/falha", "carga", "sond.media", "sond.max");
+    for (size_t n = 1000; n <= nMax; n *= 10) {
+        // versão anterior: só até 100 mil (cada busca percorre n/101 nós)
+        if (n <= 100000) {
+            NoEncadeado *tab[HASH_ANTIGA_TAM] = { 0 };
+            for (size_t i = 0; i < n; ++i) {
+                NoEncadeado *no = (NoEncadeado*) malloc(sizeof(NoEncadeado));
+                if (!no) { fprintf(stderr, "Erro: malloc benchmark\n"); return 1; }
+                snprintf(no->pista, MAX_PISTA, "Pista numero %zu do caso", i);
+                snprintf(no->suspeito, MAX_NOME, "Suspeito %zu", i % 97);
+                unsigned long idx = hash_djb2(no->pista) % HASH_ANTIGA_TAM;
+                no->prox = tab[idx];
+                tab[idx] = no;
+            }
+            size_t q = consultas / (n / 1000);
+            size_t achados = 0;
+            double t0 = agoraSeg();
+            for (size_t i = 0; i < q; ++i) {
+                snprintf(chave, MAX_PISTA, "Pista numero %zu do caso", (i * 7919) % n);
+                achados += buscarEncadeada(tab, chave) != NULL;
+            }
+            double tAcerto = (agoraSeg() - t0) / q;
+            t0 = agoraSeg();
+            for (size_t i = 0; i < q; ++i) {
+                snprintf(chave, MAX_PISTA, "Pista ausente %zu", i);
+                achados += buscarEncadeada(tab, chave) != NULL;
+            }
+            double tFalha = (agoraSeg() - t0) / q;
+            printf("%-10zu %-10s %12.1f %12.1f %8s %10s %8s\n",
+                   n, "encadeada", tAcerto * 1e9, tFalha * 1e9, "-", "-", "-");
+            if (achados != q) fprintf(stderr, "aviso: %zu acertos de %zu\n", achados, q);
+            for (int b = 0; b < HASH_ANTIGA_TAM; ++b)
+                while (tab[b]) { NoEncadeado *p = tab[b]; tab[b] = p->prox; free(p); }
+        }
+
+        TabelaHash t;
+        inicializarHash(&t);
+        char suspeito[MAX_NOME];
+        for (size_t i = 0; i < n; ++i) {
+            snprintf(chave, MAX_PISTA, "Pista numero %zu do caso", i);
+            snprintf(suspeito, MAX_NOME, "Suspeito %zu", i % 97);
+            inserirNaHash(&t, chave, suspeito);
+        }
+        size_t achados = 0;
+        double t0 = agoraSeg();
+        for (size_t i = 0; i < consultas; ++i) {
+            snprintf(chave, MAX_PISTA, "Pista numero %zu do caso", (i * 7919) % n);
+            achados += encontrarSuspeito(&t, chave) != NULL;
+        }
+        double tAcerto = (agoraSeg() - t0) / consultas;
+        t0 = agoraSeg();
+        for (size_t i = 0; i < consultas; ++i) {
+            snprintf(chave, MAX_PISTA, "Pista ausente %zu", i);
+            achados += encontrarSuspeito(&t, chave) != NULL;
+        }
+        double tFalha = (agoraSeg() - t0) / consultas;
+        EstatisticasHash est;
+        estatisticasHash(&t, &est);
+        printf("%-10zu %-10s %12.1f %12.1f %8.3f %10.3f %8zu\n",
+               n, "aberta", tAcerto * 1e9, tFalha * 1e9,
+               est.fatorCarga, est.sondagemMedia, est.sondagemMaxima);
+        if (achados != consultas) fprintf(stderr, "aviso: %zu acertos de %zu\n", achados, consultas);
+
+        // mesmas chaves congeladas no hash perfeito: uma sondagem por busca
+        congelarHash(&t);
+        achados = 0;
+        t0 = agoraSeg();
+        for (size_t i = 0; i < consultas; ++i) {
+            snprintf(chave, MAX_PISTA, "Pista numero %zu do caso", (i * 7919) % n);
+            achados += encontrarSuspeito(&t, chave) != NULL;
+        }
+        tAcerto = (agoraSeg() - t0) / consultas;
+        t0 = agoraSeg();
+        for (size_t i = 0; i < consultas; ++i) {
+            snprintf(chave, MAX_PISTA, "Pista ausente %zu", i);
+            achados += encontrarSuspeito(&t, chave) != NULL;
+        }
+        tFalha = (agoraSeg() - t0) / consultas;
+        printf("%-10zu %-10s %12.1f %12.1f %8.3f %10.3f %8d\n",
+               n, "perfeita", tAcerto * 1e9, tFalha * 1e9, 1.0, 1.0, 1);
+        if (achados != consultas) fprintf(stderr, "aviso: %zu acertos de %zu\n", achados, consultas);
+
+        // por id, como nas sessões. As falhas acima nem chegam à
+        // tabela (o texto não está no pool); aqui são pistas do pool
+        // sem suspeito (textos de sala, pistas falsas), sem e com o
+        // filtro; abaixo de FILTRO_MINIMO_BYTES ele é montado só aqui
+        int filtroSoNoBench = !t.filtro.nBlocos;
+        if (filtroSoNoBench) construirFiltro(&t, n);
+        IdTexto *presentes = (IdTexto*) malloc(n * sizeof(IdTexto));
+        IdTexto *ausentes = (IdTexto*) malloc(n * sizeof(IdTexto));
+        if (!presentes || !ausentes) { fprintf(stderr, "Erro: malloc benchmark\n"); return 1; }
+        size_t passaram = 0;
+        for (size_t i = 0; i < n; ++i) {
+            presentes[i] = t.entradas[i].pista;
+            snprintf(chave, MAX_PISTA, "Pista sem suspeito %zu", i);
+            ausentes[i] = internar(chave);
+            passaram += filtroPodeTer(&t.filtro, hashFixo(ausentes[i], t.semente));
+        }
+        // ordem aleatória, lida em sequência: só as buscas saltam na memória
+        uint64_t estado = 0x51A7E5ull;
+        for (size_t i = n; i > 1; --i) {
+            size_t j = proximoAleatorio(&estado) % i;
+            IdTexto p = presentes[i - 1]; presentes[i - 1] = presentes[j]; presentes[j] = p;
+            p = ausentes[i - 1]; ausentes[i - 1] = ausentes[j]; ausentes[j] = p;
+        }
+        FiltroPistas filtro = t.filtro;
+        for (int comFiltro = 0; comFiltro <= 1; ++comFiltro) {
+            t.filtro.nBlocos = comFiltro ? filtro.nBlocos : 0;
+            const uint32_t *lista;
+            achados = 0;
+            t0 = agoraSeg();
+            for (size_t i = 0; i < consultas; ++i)
+                achados += suspeitosDaPista(&t, presentes[i % n], &lista);
+            tAcerto = (agoraSeg() - t0) / consultas;
+            t0 = agoraSeg();
+            for (size_t i = 0; i < consultas; ++i)
+                achados += suspeitosDaPista(&t, ausentes[i % n], &lista);
+            tFalha = (agoraSeg() - t0) / consultas;
+            printf("%-10zu %-10s %12.1f %12.1f %8s %10s %8s\n",
+                   n, comFiltro ? "id+filtro" : "id", tAcerto * 1e9, tFalha * 1e9, "-", "-", "-");
+            if (achados != consultas) fprintf(stderr, "aviso: %zu acertos de %zu\n", achados, consultas);
+        }
+        t.filtro = filtro;
+        estatisticasHash(&t, &est);
+        printf("%-10s filtro %zu KiB, %.1f bits/pista, falsos positivos %.3f%% estimados, %.3f%% medidos%s\n",
+               "", est.bitsFiltro / 8192, est.bitsPorPista, est.falsoPositivoFiltro * 100.0,
+               100.0 * passaram / n, filtroSoNoBench ? " (montado só para a medição)" : "");
+        free(presentes);
+        free(ausentes);
+        liberarHash(&t);
+    }
+    return 0;
+}
+
+// -----------------------------
+// Benchmark de hash de textos (modo --bench-textos)
+// Frases de pista em português (UTF-8, com acentos), curtas e
+// longas, passadas por cada função de hash: vazão e qualidade.
+// Qualidade é o número de pares que colidem usando só os b bits
+// baixos ou só os b bits altos do hash (2^b >= número de chaves),
+// dividido pelo esperado para um hash uniforme: perto de 1 é bom.
+// -----------------------------
+typedef struct FuncaoHashTexto {
+    const char *nome;
+    uint64_t (*calcular)(const char *texto, size_t tamanho);
+} FuncaoHashTexto;
+
+static uint64_t djb2ComTamanho(const char *texto, size_t tamanho) {
+    (void)tamanho;
+    return hash_djb2(texto);
+}
+
+static const FuncaoHashTexto funcoesHashTexto[] = {
+    { "djb2", djb2ComTamanho },
+    { "palavras", hash_palavras },
+};
+#define N_FUNCOES_HASH (sizeof(funcoesHashTexto) / sizeof(funcoesHashTexto[0]))
+
+static const char *palavrasPista[] = {
+    "pegadas", "úmidas", "passadeira", "livro", "receitas", "rasgado", "talher", "gaveteiro",
+    "pedaço", "tecido", "encharcado", "página", "arrancada", "anotações", "frasco", "resíduo",
+    "químico", "lenço", "bordado", "iniciais", "relógio", "parado", "às", "três", "horas",
+    "cinzas", "lareira", "chave", "dourada", "fechadura", "forçada", "janela", "entreaberta",
+    "marca", "batom", "xícara", "chá", "veneno", "carta", "perfume", "francês", "bengala",
+    "quebrada", "botão", "paletó", "fio", "cabelo", "ruivo", "mancha", "óleo", "tapete",
+    "vidro", "estilhaçado", "diário", "secreto", "cômoda", "gaveta", "sótão", "porão",
+    "açúcar", "herança", "testamento", "assinatura", "falsificada", "luvas", "couro",
+    "mordomo", "jardineiro", "cozinheira", "ópera", "ingresso", "escada", "vela", "apagada",
+    "castiçal", "prata", "poeira", "estante", "retrato", "moldura", "cofre", "combinação",
+    "anel", "safira", "relicário", "lâmina", "punhal", "cortina", "veludo", "sangue", "seco",
+};
+static const char *ligacoesPista[] = {
+    "de", "com", "no", "na", "do", "da", "sob", "perto", "atrás", "ao", "lado", "em", "e",
+};
+
+// Frase de pista com pelo menos 'compMin' bytes (palavras inteiras,
+// até compMax), guardada na arena.
+static char* gerarFrasePista(Arena *arena, int compMin, int compMax, uint64_t *rng) {
+    char buf[1024];
+    if (compMax > (int)sizeof(buf) - 32) compMax = (int)sizeof(buf) - 32;
+    int alvo = compMin + (int)(proximoAleatorio(rng) % (uint64_t)(compMax - compMin + 1));
+    int n = 0;
+    while (n < alvo) {
+        const char *w = (n > 0 && proximoAleatorio(rng) % 3 == 0)
+            ? ligacoesPista[proximoAleatorio(rng) % (sizeof(ligacoesPista) / sizeof(ligacoesPista[0]))]
+            : palavrasPista[proximoAleatorio(rng) % (sizeof(palavrasPista) / sizeof(palavrasPista[0]))];
+        n += snprintf(buf + n, sizeof(buf) - (size_t)n, n ? " %s" : "%s", w);
+    }
+    if (buf[0] >= 'a' && buf[0] <= 'z') buf[0] = (char)(buf[0] - 'a' + 'A');
+    char *texto = (char*) arenaAlocarAlinhado(arena, (size_t)n + 1, 1);
+    memcpy(texto, buf, (size_t)n + 1);
+    return texto;
+}
+
+static int compararTextos(const void *a, const void *b) {
+    return strcmp(*(const char *const*)a, *(const char *const*)b);
+}
+
+static int compararU64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Pares que colidem no balde (hashes ordenados por balde) / esperado.
+static double paresColididos(uint64_t *baldes, size_t n, int bits) {
+    qsort(baldes, n, sizeof(uint64_t), compararU64);
+    double pares = 0;
+    for (size_t i = 0, j; i < n; i = j) {
+        for (j = i + 1; j < n && baldes[j] == baldes[i]; ++j) {}
+        pares += (double)(j - i) * (double)(j - i - 1) / 2;
+    }
+    double esperado = (double)n * (double)(n - 1) / 2 / (double)((uint64_t)1 << bits);
+    return esperado > 0 ? pares / esperado : 0.0;
+}
+
+int benchTextos(size_t n) {
+    static const struct { const char *nome; int compMin, compMax; } grupos[] = {
+        { "curtas", 12, 48 }, { "longas", 120, 400 },
+    };
+    const int repeticoes = 5;
+    uint64_t rng = 42;
+    char **textos = (char**) malloc(n * sizeof(char*));
+    size_t *tamanhos = (size_t*) malloc(n * sizeof(size_t));
+    uint64_t *hashes = (uint64_t*) malloc(n * sizeof(uint64_t));
+    uint64_t *baldes = (uint64_t*) malloc(n * sizeof(uint64_t));
+    if (!textos || !tamanhos || !hashes || !baldes || n < 2) {
+        fprintf(stderr, "Erro: parametros de benchmark invalidos\n");
+        return 1;
+    }
+    printf("%-7s %-9s %9s %9s %9s %8s %10s %9s %9s\n", "textos", "funcao", "chaves",
+           "bytes/ch", "ns/chave", "GB/s", "colisoes64", "baixos", "altos");
+    for (size_t g = 0; g < sizeof(grupos) / sizeof(grupos[0]); ++g) {
+        Arena arena;
+        inicializarArena(&arena);
+        for (size_t i = 0; i < n; ++i)
+            textos[i] = gerarFrasePista(&arena, grupos[g].compMin, grupos[g].compMax, &rng);
+        // só chaves distintas: colisões entre textos iguais não contam
+        qsort(textos, n, sizeof(char*), compararTextos);
+        size_t k = 0;
+        for (size_t i = 0; i < n; ++i)
+            if (k == 0 || strcmp(textos[i], textos[k - 1]) != 0) textos[k++] = textos[i];
+        // embaralha para a ordem não favorecer nenhum padrão de acesso
+        for (size_t i = k - 1; i > 0; --i) {
+            size_t j = proximoAleatorio(&rng) % (i + 1);
+            char *t = textos[i]; textos[i] = textos[j]; textos[j] = t;
+        }
+        size_t bytes = 0;
+        for (size_t i = 0; i < k; ++i) bytes += tamanhos[i] = strlen(textos[i]);
+        int bits = 1;
+        while (((size_t)1 << bits) < k) bits++;
+
+        for (size_t f = 0; f < N_FUNCOES_HASH; ++f) {
+            const FuncaoHashTexto *fn = &funcoesHashTexto[f];
+            volatile uint64_t sorvedouro = 0;
+            double t0 = agoraSeg();
+            for (int r = 0; r < repeticoes; ++r)
+                for (size_t i = 0; i < k; ++i) sorvedouro += fn->calcular(textos[i], tamanhos[i]);
+            double dt = agoraSeg() - t0;
+            (void)sorvedouro;
+            for (size_t i = 0; i < k; ++i) hashes[i] = fn->calcular(textos[i], tamanhos[i]);
+            qsort(hashes, k, sizeof(uint64_t), compararU64);
+            size_t colisoes = 0;
+            for (size_t i = 1; i < k; ++i) colisoes += hashes[i] == hashes[i - 1];
+            for (size_t i = 0; i < k; ++i) baldes[i] = hashes[i] & (((uint64_t)1 << bits) - 1);
+            double baixos = paresColididos(baldes, k, bits);
+            for (size_t i = 0; i < k; ++i) baldes[i] = hashes[i] >> (64 - bits);
+            double altos = paresColididos(baldes, k, bits);
+            printf("%-7s %-9s %9zu %9.1f %9.1f %8.2f %10zu %9.3f %9.3f\n",
+                   grupos[g].nome, fn->nome, k, (double)bytes / k,
+                   dt * 1e9 / ((double)k * repeticoes), (double)bytes * repeticoes / dt / 1e9,
+                   colisoes, baixos, altos);
+        }
+        arenaLiberar(&arena);
+    }
+    free(textos); free(tamanhos); free(hashes); free(baldes);
+    return 0;
+}
+
+// -----------------------------
+// Benchmark da busca textual (modo --bench-busca)
+// Indexa n frases de pista em português e mede consultas por
+// trecho e por prefixo: as primeiras 50 ocorrências (o que a
+// interface pede), todas, e a varredura de todas as pistas que
+// o índice evita.
+// -----------------------------
+int benchBusca(size_t n) {
+    static const char *consultas[] = {
+        "frasco", "Resíduo Químico", "xicara de cha", "lamina", "FORÇADA", "anel de safira",
+        "perto do porao", "ao", "zzz",
+    };
+    static const char *prefixos[] = { "p", "Pó", "lenco bordado", "Carta" };
+    uint64_t rng = 42;
+    Arena arena;
+    inicializarArena(&arena);
+    IdTexto *ids = (IdTexto*) malloc(n * sizeof(IdTexto));
+    IdTexto *achadas = (IdTexto*) malloc(50 * sizeof(IdTexto));
+    if (!ids || !achadas || n == 0) { fprintf(stderr, "Erro: parametros de benchmark invalidos\n"); return 1; }
+    for (size_t i = 0; i < n; ++i) ids[i] = internar(gerarFrasePista(&arena, 12, 64, &rng));
+
+    IndiceTexto ind;
+    iniciarIndiceTexto(&ind);
+    double t0 = agoraSeg();
+    for (size_t i = 0; i < n; ++i) indexarPista(&ind, ids[i]);
+    double dt = agoraSeg() - t0;
+    size_t bytes = ind.textos.bytes + ind.capListas * sizeof(ListaTrigrama) +
+                   ind.cap * (sizeof(IdTexto) + sizeof(char*)) +
+                   ind.indice.capacidade * (sizeof(uint32_t) + 1);
+    uint32_t densas = 0;
+    for (uint32_t i = 0; i < ind.nListas; ++i) {
+        densas += ind.listas[i].bits != NULL;
+        bytes += ind.listas[i].cap * (ind.listas[i].bits ? sizeof(uint64_t) : sizeof(uint32_t));
+    }
+    // o gerador repete frases: o índice guarda cada pista recebida
+    uint64_t *vistas = (uint64_t*) calloc(pool.quantidade / 64 + 1, sizeof(uint64_t));
+    if (!vistas) { fprintf(stderr, "Erro: malloc benchmark\n"); return 1; }
+    size_t distintas = 0;
+    for (size_t i = 0; i < n; ++i) {
+        distintas += !(vistas[ids[i] / 64] >> (ids[i] % 64) & 1);
+        vistas[ids[i] / 64] |= 1ull << (ids[i] % 64);
+    }
+    free(vistas);
+    printf("%zu pistas (%zu textos distintos), %u trigramas (%u em mapa de bits): %.1f ns/pista ao indexar, %.1f MB\n",
+           n, distintas, ind.nListas, densas, dt * 1e9 / n, bytes / 1e6);
+    printf("%-8s %-18s %10s %12s %12s %12s\n", "tipo", "consulta", "achadas",
+           "us (50)", "us (todas)", "us (varredura)");
+    for (size_t q = 0; q < sizeof(consultas) / sizeof(consultas[0]) + sizeof(prefixos) / sizeof(prefixos[0]); ++q) {
+        int prefixo = q >= sizeof(consultas) / sizeof(consultas[0]);
+        const char *c = prefixo ? prefixos[q - sizeof(consultas) / sizeof(consultas[0])] : consultas[q];
+        size_t (*buscar)(const IndiceTexto*, const char*, IdTexto*, size_t) =
+            prefixo ? buscarPrefixo : buscarTrecho;
+        const int reps = 20;
+        t0 = agoraSeg();
+        for (int r = 0; r < reps; ++r) buscar(&ind, c, achadas, 50);
+        double t50 = (agoraSeg() - t0) / reps;
+        t0 = agoraSeg();
+        size_t total = buscar(&ind, c, NULL, SIZE_MAX);
+        double tTodas = agoraSeg() - t0;
+        char *norm = (char*) malloc(strlen(c) + 1);
+        if (!norm) { fprintf(stderr, "Erro: malloc benchmark\n"); return 1; }
+        normalizarTexto(c, norm);
+        t0 = agoraSeg();
+        size_t varridas = buscarPorVarredura(&ind, norm, prefixo, NULL, SIZE_MAX);
+        double tVarredura = agoraSeg() - t0;
+        free(norm);
+        printf("%-8s %-18s %10zu %12.1f %12.1f %12.1f\n", prefixo ? "prefixo" : "trecho", c, total,
+               t50 * 1e6, tTodas * 1e6, tVarredura * 1e6);
+        if (varridas != total) fprintf(stderr, "aviso: indice achou %zu, varredura %zu\n", total, varridas);
+    }
+    liberarIndiceTexto(&ind);
+    arenaLiberar(&arena);
+    liberarPool();
+    free(ids);
+    free(achadas);
+    return 0;
+}
+
+// -----------------------------
+// Benchmark de alocação (modo --bench-arena)
+// Monta um mapa de n salas (árvore completa, cada sala com pista)
+// e coleta todas as pistas na BST, primeiro com um malloc por nó
+// e liberação nó a nó (versão anterior), depois com arenas.
+// Cada variante roda num processo filho para medir o pico de RSS
+// isoladamente.
+// -----------------------------
+static size_t alocacoesMalloc = 0;
+
+static void* mallocContado(size_t tamanho) {
+    void *p = malloc(tamanho);
+    if (!p) { fprintf(stderr, "Erro: malloc benchmark\n"); exit(1); }
+    alocacoesMalloc++;
+    return p;
+}
+
+// Nó da versão anterior: um malloc por pista, filhos por ponteiro.
+typedef struct NoPistaMalloc {
+    IdTexto pista;
+    int altura;
+    struct NoPistaMalloc *esq;
+    struct NoPistaMalloc *dir;
+} NoPistaMalloc;
+
+static int alturaMalloc(const NoPistaMalloc *n) {
+    return n ? n->altura : 0;
+}
+
+static NoPistaMalloc* girarMalloc(NoPistaMalloc *n, int paraDireita) {
+    NoPistaMalloc *f = paraDireita ? n->esq : n->dir;
+    if (paraDireita) { n->esq = f->dir; f->dir = n; }
+    else             { n->dir = f->esq; f->esq = n; }
+    for (NoPistaMalloc *x = n; ; x = f) {
+        int he = alturaMalloc(x->esq), hd = alturaMalloc(x->dir);
+        x->altura = 1 + (he > hd ? he : hd);
+        if (x == f) break;
+    }
+    return f;
+}
+
+static NoPistaMalloc* inserirPistaMalloc(NoPistaMalloc *raiz, IdTexto pista) {
+    if (raiz == NULL) {
+        NoPistaMalloc *n = (NoPistaMalloc*) mallocContado(sizeof(NoPistaMalloc));
+        n->pista = pista;
+        n->altura = 1;
+        n->esq = n->dir = NULL;
+        return n;
+    }
+    if (compararPistas(pista, raiz->pista) < 0)
+        raiz->esq = inserirPistaMalloc(raiz->esq, pista);
+    else
+        raiz->dir = inserirPistaMalloc(raiz->dir, pista);
+    int he = alturaMalloc(raiz->esq), hd = alturaMalloc(raiz->dir);
+    raiz->altura = 1 + (he > hd ? he : hd);
+    if (he - hd > 1) {
+        if (alturaMalloc(raiz->esq->esq) < alturaMalloc(raiz->esq->dir))
+            raiz->esq = girarMalloc(raiz->esq, 0);
+        return girarMalloc(raiz, 1);
+    }
+    if (hd - he > 1) {
+        if (alturaMalloc(raiz->dir->dir) < alturaMalloc(raiz->dir->esq))
+            raiz->dir = girarMalloc(raiz->dir, 1);
+        return girarMalloc(raiz, 0);
+    }
+    return raiz;
+}
+
+// Libera sem recursão nem pilha: enquanto a raiz tem filho esquerdo,
+// gira à direita (o filho sobe); sem ele, libera a raiz e segue pela
+// direita. Cada nó sobe no máximo uma vez, então é O(n) mesmo numa
+// árvore degenerada.
+static void liberarPistasMalloc(NoPistaMalloc *raiz) {
+    while (raiz) {
+        NoPistaMalloc *e = raiz->esq;
+        if (e) {
+            raiz->esq = e->dir;
+            e->dir = raiz;
+            raiz = e;
+        } else {
+            NoPistaMalloc *d = raiz->dir;
+            free(raiz);
+            raiz = d;
+        }
+    }
+}
+
+static void liberarMapaMalloc(Sala *raiz) {
+    while (raiz) {
+        Sala *e = raiz->esq;
+        if (e) {
+            raiz->esq = e->dir;
+            e->dir = raiz;
+            raiz = e;
+        } else {
+            Sala *d = raiz->dir;
+            free(raiz);
+            raiz = d;
+        }
+    }
+}
+
+static void executarVarianteAlocacao(int usarArena, size_t n) {
+    Arena arenaMapa;
+    ArvorePistas arvore;
+    inicializarArena(&arenaMapa);
+    iniciarArvorePistas(&arvore);
+    Sala **salas = (Sala**) malloc(n * sizeof(Sala*));
+    if (!salas) { fprintf(stderr, "Erro: malloc benchmark\n"); exit(1); }
+    char nome[MAX_NOME], pista[MAX_PISTA];
+
+    double t0 = agoraSeg();
+    for (size_t i = 0; i < n; ++i) {
+        snprintf(nome, MAX_NOME, "Sala %zu", i);
+        snprintf(pista, MAX_PISTA, "Pista deixada na sala %zu", i);
+        if (usarArena) {
+            salas[i] = criarSala(&arenaMapa, nome, pista);
+        } else {
+            Sala *s = (Sala*) mallocContado(sizeof(Sala));
+            s->nome = internar(nome);
+            s->pista = internar(pista);
+            s->esq = s->dir = NULL;
+            salas[i] = s;
+        }
+        if (i > 0) {
+            Sala *pai = salas[(i - 1) / 2];
+            if (i % 2) pai->esq = salas[i]; else pai->dir = salas[i];
+        }
+    }
+    NoPistaMalloc *raiz = NULL;
+    size_t alocacoesPistas = alocacoesHeap;
+    for (size_t i = 0; i < n; ++i) {
+        if (usarArena) inserirPista(&arvore, salas[i]->pista);
+        else raiz = inserirPistaMalloc(raiz, salas[i]->pista);
+    }
+    alocacoesPistas = alocacoesHeap - alocacoesPistas;
+    double tMontagem = agoraSeg() - t0;
+
+    size_t alocacoes = usarArena ? arenaMapa.blocos + alocacoesPistas : alocacoesMalloc;
+    t0 = agoraSeg();
+    if (usarArena) {
+        liberarArvorePistas(&arvore);
+        arenaLiberar(&arenaMapa);
+    } else {
+        liberarPistasMalloc(raiz);
+        liberarMapaMalloc(salas[0]);
+    }
+    double tLiberacao = agoraSeg() - t0;
+    // o pool é o mesmo nas duas variantes: fica fora da medição
+    liberarPool();
+    free(salas);
+
+    printf("  %-8s salas=%zu  alocacoes=%zu  montagem=%.1f ms  liberacao=%.2f ms",
+           usarArena ? "arena" : "malloc", n, alocacoes, tMontagem * 1e3, tLiberacao * 1e3);
+    fflush(stdout);
+}
+
+int benchArena(size_t n) {
+    if (n == 0) return 1;
+    printf("Mapa de %zu salas + BST com todas as pistas:\n", n);
+    for (int usarArena = 0; usarArena < 2; ++usarArena) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0) { perror("fork"); return 1; }
+        if (pid == 0) {
+            executarVarianteAlocacao(usarArena, n);
+            _exit(0);
+        }
+        int status;
+        struct rusage uso;
+        if (wait4(pid, &status, 0, &uso) < 0) { perror("wait4"); return 1; }
+        printf("  pico RSS=%.1f MiB\n", uso.ru_maxrss / 1024.0);
+    }
+    return 0;
+}
+
+// -----------------------------
+// Suíte de benchmarks (modo --bench)
+// Gera uma mansão sintética (número de salas, de pistas e de
+// suspeitos e faixa de comprimento das pistas configuráveis) e
+// mede cada kernel em ns/op, alocações/op e, quando o kernel
+// permite perf_event_open, falhas de cache/op.
+// -----------------------------
+typedef struct ConfigBench {
+    size_t salas;
+    size_t pistas;
+    size_t suspeitos;
+    int compMin, compMax;    // comprimento das pistas (uniforme)
+    int repeticoes;
+    uint64_t semente;
+} ConfigBench;
+
+typedef struct Medicao {
+    double inicio;
+    size_t alocacoes;
+} Medicao;
+
+static int fdFalhasCache = -1;   // contador de hardware (-1 se indisponível)
+
+static void abrirContadorCache(void) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fdFalhasCache = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+static void comecarMedicao(Medicao *m) {
+#ifdef __linux__
+    if (fdFalhasCache >= 0) {
+        ioctl(fdFalhasCache, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fdFalhasCache, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+    m->alocacoes = alocacoesHeap;
+    m->inicio = agoraSeg();
+}
+
+static void terminarMedicao(const Medicao *m, const char *kernel, size_t ops) {
+    double dt = agoraSeg() - m->inicio;
+    size_t alocacoes = alocacoesHeap - m->alocacoes;
+    char falhas[32] = "-";
+#ifdef __linux__
+    if (fdFalhasCache >= 0) {
+        uint64_t v;
+        ioctl(fdFalhasCache, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fdFalhasCache, &v, sizeof(v)) == (ssize_t)sizeof(v))
+            snprintf(falhas, sizeof(falhas), "%.3f", ops ? (double)v / ops : 0.0);
+    }
+#endif
+    if (ops == 0) ops = 1;
+    printf("%-28s %10zu %12.1f %10.4f %14s\n",
+           kernel, ops, dt * 1e9 / ops, (double)alocacoes / ops, falhas);
+}
+
+// Texto sintético: prefixo numerado (garante unicidade) completado
+// com sílabas até um comprimento sorteado em [compMin, compMax].
+static char* gerarTextoSintetico(Arena *arena, const char *prefixo, size_t i,
+                                 int compMin, int compMax, uint64_t *rng) {
+    static const char *silabas[] = { "ca", "de", "ta", "pe", "lo", "ra", "mi", "so",
+                                     "ma", "ri", "es", "nho", "gu", "ar", "do", " " };
+    int alvo = compMin;
+    if (compMax > compMin)
+        alvo += (int)(proximoAleatorio(rng) % (uint64_t)(compMax - compMin + 1));
+    if (alvo > MAX_PISTA - 1) alvo = MAX_PISTA - 1;
+    char buf[MAX_PISTA];
+    int n = snprintf(buf, sizeof(buf), "%s %zu ", prefixo, i);
+    if (n > alvo) alvo = n;
+    while (n < alvo) {
+        const char *s = silabas[proximoAleatorio(rng) % 16];
+        while (*s && n < alvo) buf[n++] = *s++;
+    }
+    while (buf[n - 1] == ' ') n--;   // sem espaço no fim: aparar() o cortaria nas buscas
+    buf[n] = '\0';
+    char *texto = (char*) arenaAlocarAlinhado(arena, (size_t)n + 1, 1);
+    memcpy(texto, buf, (size_t)n + 1);
+    return texto;
+}
+
+// Monta 'n' salas em 'salas' numa árvore binária aleatória: cada sala
+// nova ocupa uma vaga (filho livre) sorteada entre as existentes.
+static void montarMapaSintetico(Arena *arena, Sala **salas, char **nomes, char **pistas,
+                                const ConfigBench *cfg, size_t *vagas, uint64_t *rng) {
+    size_t nVagas = 0;
+    for (size_t i = 0; i < cfg->salas; ++i) {
+        const char *pista = cfg->pistas ? pistas[i % cfg->pistas] : "";
+        salas[i] = criarSala(arena, nomes[i], pista);
+        if (i > 0) {
+            size_t v = proximoAleatorio(rng) % nVagas;
+            Sala *pai = salas[vagas[v] >> 1];
+            if (vagas[v] & 1) pai->dir = salas[i]; else pai->esq = salas[i];
+            vagas[v] = vagas[--nVagas];
+        }
+        vagas[nVagas++] = i << 1;
+        vagas[nVagas++] = (i << 1) | 1;
+    }
+}
+
+static int somarVisita(IdTexto pista, void *contexto) {
+    *(uint64_t*)contexto += pista;
+    return 0;
+}
+
+int executarBench(int argc, char *argv[]) {
+    ConfigBench cfg = { 100000, 50000, 100, 16, 64, 5, 42 };
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "--salas") == 0 && i + 1 < argc) cfg.salas = (size_t)atol(argv[++i]);
+        else if (strcmp(argv[i], "--pistas") == 0 && i + 1 < argc) cfg.pistas = (size_t)atol(argv[++i]);
+        else if (strcmp(argv[i], "--suspeitos") == 0 && i + 1 < argc) cfg.suspeitos = (size_t)atol(argv[++i]);
+        else if (strcmp(argv[i], "--comprimento") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d:%d", &cfg.compMin, &cfg.compMax) != 2)
+                cfg.compMax = cfg.compMin;
+        }
+        else if (strcmp(argv[i], "--repeticoes") == 0 && i + 1 < argc) cfg.repeticoes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--semente") == 0 && i + 1 < argc) cfg.semente = strtoull(argv[++i], NULL, 10);
+        else {
+            fprintf(stderr, "Erro: opcao desconhecida '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    if (cfg.salas == 0 || cfg.pistas == 0 || cfg.suspeitos == 0 || cfg.repeticoes <= 0 ||
+        cfg.compMin < 1 || cfg.compMax < cfg.compMin) {
+        fprintf(stderr, "Erro: parametros de benchmark invalidos\n");
+        return 1;
+    }
+    uint64_t rng = cfg.semente ? cfg.semente : 1;
+
+    // geradores: textos ficam numa arena própria, fora das medições
+    Arena arenaTextos;
+    inicializarArena(&arenaTextos);
+    char **nomes = (char**) malloc(cfg.salas * sizeof(char*));
+    char **pistas = (char**) malloc(cfg.pistas * sizeof(char*));
+    char **ausentes = (char**) malloc(cfg.pistas * sizeof(char*));
+    char **suspeitos = (char**) malloc(cfg.suspeitos * sizeof(char*));
+    IdTexto *idsPistas = (IdTexto*) malloc(cfg.pistas * sizeof(IdTexto));
+    Sala **salas = (Sala**) malloc(cfg.salas * sizeof(Sala*));
+    size_t *vagas = (size_t*) malloc((cfg.salas + 1) * 2 * sizeof(size_t));
+    if (!nomes || !pistas || !ausentes || !suspeitos || !idsPistas || !salas || !vagas) {
+        fprintf(stderr, "Erro: malloc benchmark\n");
+        return 1;
+    }
+    for (size_t i = 0; i < cfg.salas; ++i)
+        nomes[i] = gerarTextoSintetico(&arenaTextos, "Sala", i, 1, 1, &rng);
+    for (size_t i = 0; i < cfg.pistas; ++i) {
+        pistas[i] = gerarTextoSintetico(&arenaTextos, "Pista", i, cfg.compMin, cfg.compMax, &rng);
+        ausentes[i] = gerarTextoSintetico(&arenaTextos, "Ausente", i, cfg.compMin, cfg.compMax, &rng);
+    }
+    for (size_t i = 0; i < cfg.suspeitos; ++i)
+        suspeitos[i] = gerarTextoSintetico(&arenaTextos, "Suspeito", i, 1, 1, &rng);
+
+    abrirContadorCache();
+    printf("salas=%zu pistas=%zu suspeitos=%zu comprimento=%d:%d repeticoes=%d semente=%llu\n",
+           cfg.salas, cfg.pistas, cfg.suspeitos, cfg.compMin, cfg.compMax, cfg.repeticoes,
+           (unsigned long long)cfg.semente);
+    if (fdFalhasCache < 0)
+        printf("(contador de falhas de cache indisponivel: perf_event_open recusado)\n");
+    printf("%-28s %10s %12s %10s %14s\n", "kernel", "ops", "ns/op", "aloc/op", "falhas_cache/op");
+
+    Medicao m;
+    size_t R = (size_t)cfg.repeticoes;
+
+    // cada função de hash sobre os textos das pistas
+    volatile uint64_t sorvedouro = 0;
+    size_t *tamPistas = (size_t*) malloc(cfg.pistas * sizeof(size_t));
+    if (!tamPistas) { fprintf(stderr, "Erro: malloc benchmark\n"); return 1; }
+    for (size_t i = 0; i < cfg.pistas; ++i) tamPistas[i] = strlen(pistas[i]);
+    for (size_t f = 0; f < N_FUNCOES_HASH; ++f) {
+        char kernel[32];
+        snprintf(kernel, sizeof(kernel), "hash %s", funcoesHashTexto[f].nome);
+        comecarMedicao(&m);
+        for (size_t r = 0; r < R; ++r)
+            for (size_t i = 0; i < cfg.pistas; ++i)
+                sorvedouro += funcoesHashTexto[f].calcular(pistas[i], tamPistas[i]);
+        terminarMedicao(&m, kernel, R * cfg.pistas);
+    }
+    free(tamPistas);
+
+    // criarSala: a primeira montagem interna os textos; as demais só
+    // encontram os ids já existentes
+    Arena arenaMapa, arenaRascunho;
+    inicializarArena(&arenaMapa);
+    inicializarArena(&arenaRascunho);
+    comecarMedicao(&m);
+    montarMapaSintetico(&arenaMapa, salas, nomes, pistas, &cfg, vagas, &rng);
+    terminarMedicao(&m, "criarSala (internando)", cfg.salas);
+    Sala *raizMapa = salas[0];
+    Sala **rascunho = (Sala**) malloc(cfg.salas * sizeof(Sala*));
+    if (!rascunho) { fprintf(stderr, "Erro: malloc benchmark\n"); return 1; }
+    comecarMedicao(&m);
+    for (size_t r = 0; r < R; ++r) {
+        arenaReiniciar(&arenaRascunho);
+        montarMapaSintetico(&arenaRascunho, rascunho, nomes, pistas, &cfg, vagas, &rng);
+    }
+    terminarMedicao(&m, "criarSala", R * cfg.salas);
+    free(rascunho);
+
+    // tabela hash pista -> suspeito
+    TabelaHash tabela;
+    inicializarHash(&tabela);
+    comecarMedicao(&m);
+    for (size_t i = 0; i < cfg.pistas; ++i)
+        inserirNaHash(&tabela, pistas[i], suspeitos[proximoAleatorio(&rng) % cfg.suspeitos]);
+    terminarMedicao(&m, "inserirNaHash", cfg.pistas);
+    for (size_t i = 0; i < cfg.pistas; ++i) idsPistas[i] = buscarTexto(pistas[i]);
+
+    size_t achados = 0;
+    comecarMedicao(&m);
+    for (size_t r = 0; r < R; ++r)
+        for (size_t i = 0; i < cfg.pistas; ++i)
+            achados += encontrarSuspeito(&tabela, pistas[(i * 7919) % cfg.pistas]) != NULL;
+    terminarMedicao(&m, "encontrarSuspeito (acerto)", R * cfg.pistas);
+    comecarMedicao(&m);
+    for (size_t r = 0; r < R; ++r)
+        for (size_t i = 0; i < cfg.pistas; ++i)
+            achados += encontrarSuspeito(&tabela, ausentes[i]) != NULL;
+    terminarMedicao(&m, "encontrarSuspeito (falha)", R * cfg.pistas);
+    if (achados != R * cfg.pistas)
+        fprintf(stderr, "aviso: %zu acertos de %zu\n", achados, R * cfg.pistas);
+
+    // consulta por id (a usada no jogo), antes e depois de congelar
+    long soma = 0;
+    comecarMedicao(&m);
+    for (size_t r = 0; r < R; ++r)
+        for (size_t i = 0; i < cfg.pistas; ++i)
+            soma += suspeitoDaPista(&tabela, idsPistas[(i * 7919) % cfg.pistas]);
+    terminarMedicao(&m, "suspeitoDaPista (aberta)", R * cfg.pistas);
+    comecarMedicao(&m);
+    congelarHash(&tabela);
+    terminarMedicao(&m, "congelarHash", cfg.pistas);
+    comecarMedicao(&m);
+    for (size_t r = 0; r < R; ++r)
+        for (size_t i = 0; i < cfg.pistas; ++i)
+            soma -= suspeitoDaPista(&tabela, idsPistas[(i * 7919) % cfg.pistas]);
+    terminarMedicao(&m, "suspeitoDaPista (perfeita)", R * cfg.pistas);
+    if (soma != 0) fprintf(stderr, "aviso: hash perfeito diverge da tabela aberta\n");
+
+    // BST de pistas: todas as pistas em ordem aleatória
+    for (size_t i = cfg.pistas - 1; i > 0; --i) {
+        size_t j = proximoAleatorio(&rng) % (i + 1);
+        IdTexto t = idsPistas[i]; idsPistas[i] = idsPistas[j]; idsPistas[j] = t;
+    }
+    ArvorePistas arvore;
+    iniciarArvorePistas(&arvore);
+    comecarMedicao(&m);
+    for (size_t r = 0; r < R; ++r) {
+        esvaziarArvorePistas(&arvore);
+        for (size_t i = 0; i < cfg.pistas; ++i)
+            inserirPista(&arvore, idsPistas[i]);
+    }
+    terminarMedicao(&m, "inserirPista", R * cfg.pistas);
+
+    // percurso completo em ordem, como exibirPistas() faz
+    size_t visitadas = 0;
+    uint64_t somaVisitas = 0;
+    comecarMedicao(&m);
+    for (size_t r = 0; r < R; ++r) visitadas += percorrerPistas(&arvore, NULL, somarVisita, &somaVisitas);
+    terminarMedicao(&m, "percorrerPistas (por pista)", visitadas);
+    sorvedouro += somaVisitas;
+
+    // paginação: 50 pistas a partir de uma posição sorteada, pelo
+    // cursor (O(log n + página)) e por percurso em ordem desde a
+    // primeira pista
+    size_t lidas = 0, paginas = R * 1000, paginasPercurso = R * 10;
+    CursorPistas cursor;
+    comecarMedicao(&m);
+    for (size_t k = 0; k < paginas; ++k) {
+        cursorNaPosicao(&cursor, &arvore, proximoAleatorio(&rng) % cfg.pistas);
+        for (int i = 0; i < 50 && proximaPista(&cursor) != TEXTO_NENHUM; ++i) lidas++;
+    }
+    terminarMedicao(&m, "pagina de 50 (cursor)", paginas);
+    comecarMedicao(&m);
+    for (size_t k = 0; k < paginasPercurso; ++k) {
+        size_t inicio = proximoAleatorio(&rng) % cfg.pistas;
+        cursorNaPosicao(&cursor, &arvore, 0);
+        for (size_t i = 0; i < inicio; ++i) proximaPista(&cursor);
+        for (int i = 0; i < 50 && proximaPista(&cursor) != TEXTO_NENHUM; ++i) lidas++;
+    }
+    terminarMedicao(&m, "pagina de 50 (percurso)", paginasPercurso);
+    static const char *prefixos[] = { "Pista 1", "Pista 2", "Pista 3", "Pista 42", "Pista 7" };
+    comecarMedicao(&m);
+    for (size_t k = 0; k < paginas; ++k) lidas += contarPistasComPrefixo(&arvore, prefixos[k % 5]);
+    terminarMedicao(&m, "contarPistasComPrefixo", paginas);
+    sorvedouro += lidas;
+
+    // placar de todos os suspeitos com todas as pistas coletadas: pista
+    // a pista pela BST consultando a tabela, e pelo índice inverso (E
+    // e contagem de bits contra o bitset das pistas, como na sessão)
+    uint32_t nBits = (pool.quantidade + 63) / 64 * 64;
+    uint64_t *todasPistas = (uint64_t*) calloc(nBits / 64, sizeof(uint64_t));
+    uint32_t *contagens = (uint32_t*) malloc(tabela.nSuspeitos * sizeof(uint32_t));
+    uint32_t *contagensBst = (uint32_t*) malloc(tabela.nSuspeitos * sizeof(uint32_t));
+    if (!todasPistas || !contagens || !contagensBst) { fprintf(stderr, "Erro: malloc benchmark\n"); return 1; }
+    for (size_t i = 0; i < cfg.pistas; ++i) todasPistas[idsPistas[i] / 64] |= 1ull << (idsPistas[i] % 64);
+    comecarMedicao(&m);
+    for (size_t r = 0; r < R; ++r) {
+        memset(contagensBst, 0, tabela.nSuspeitos * sizeof(uint32_t));
+        cursorNaPosicao(&cursor, &arvore, 0);
+        for (IdTexto p; (p = proximaPista(&cursor)) != TEXTO_NENHUM; ) {
+            const uint32_t *lista;
+            uint32_t n = suspeitosDaPista(&tabela, p, &lista);
+            for (uint32_t j = 0; j < n; ++j) contagensBst[lista[j]]++;
+        }
+    }
+    terminarMedicao(&m, "placar pista a pista (BST)", R * cfg.pistas);
+    comecarMedicao(&m);
+    for (size_t r = 0; r < R; ++r) pontuarSuspeitos(&tabela, todasPistas, nBits, contagens);
+    terminarMedicao(&m, "pontuarSuspeitos (por pista)", R * cfg.pistas);
+    if (memcmp(contagens, contagensBst, tabela.nSuspeitos * sizeof(uint32_t)) != 0)
+        fprintf(stderr, "aviso: pontuarSuspeitos diverge da contagem pela BST\n");
+    long total = 0;
+    comecarMedicao(&m);
+    for (uint32_t k = 0; k < tabela.nSuspeitos; ++k)
+        total += contarPistasDoSuspeito(&tabela, k, todasPistas, nBits);
+    terminarMedicao(&m, "contarPistasDoSuspeito", tabela.nSuspeitos);
+    if ((size_t)total != cfg.pistas)
+        fprintf(stderr, "aviso: %ld pistas contadas de %zu\n", total, cfg.pistas);
+    free(todasPistas);
+    free(contagensBst);
+
+    // macro: sessões que descem da raiz até uma folha por caminhos
+    // aleatórios e acusam um suspeito (custo por movimento)
+    Mapa mapa;
+    compilarMapa(raizMapa, &mapa);
+    Sessao sessao;
+    iniciarSessao(&sessao, &mapa, &tabela);
+    size_t movimentos = 0, sessoes = R * 1000;
+    comecarMedicao(&m);
+    for (size_t k = 0; k < sessoes; ++k) {
+        reiniciarSessao(&sessao);
+        coletarPistaDaSala(&sessao);
+        while (1) {
+            const FilhosSala *a = &mapa.filhos[sessao.atual];
+            int temEsq = a->esq != SALA_NENHUMA, temDir = a->dir != SALA_NENHUMA;
+            if (!temEsq && !temDir) break;
+            char opc = temEsq && temDir ? ((proximoAleatorio(&rng) & 1) ? 'e' : 'd')
+                                        : (temEsq ? 'e' : 'd');
+            moverSessao(&sessao, opc);
+            coletarPistaDaSala(&sessao);
+            movimentos++;
+        }
+        sorvedouro += pistasContra(&sessao, tabela.suspeitos[k % tabela.nSuspeitos]);
+    }
+    terminarMedicao(&m, "sessao aleatoria (movimento)", movimentos);
+    // o placar incremental da última sessão confere com o índice inverso
+    pontuarSuspeitos(&tabela, sessao.coletadas, sessao.capColetadas, contagens);
+    for (uint32_t k = 0; k < tabela.nSuspeitos; ++k)
+        if (contagens[k] != sessao.placar.contagem[k]) {
+            fprintf(stderr, "aviso: placar da sessao diverge de pontuarSuspeitos\n");
+            break;
+        }
+    free(contagens);
+    (void)sorvedouro;
+
+    encerrarSessao(&sessao);
+    free(mapa.memoria);
+    liberarArvorePistas(&arvore);
+    liberarHash(&tabela);
+    arenaLiberar(&arenaRascunho);
+    arenaLiberar(&arenaMapa);
+    arenaLiberar(&arenaTextos);
+    liberarPool();
+    free(nomes); free(pistas); free(ausentes); free(suspeitos);
+    free(idsPistas); free(salas); free(vagas);
+    if (fdFalhasCache >= 0) close(fdFalhasCache);
+    return 0;
+}
+
+// -----------------------------
+// Benchmark de layout do mapa (modo --bench-mapa)
+// Mesma árvore aleatória de n salas em três formas: nós Sala
+// ligados por ponteiros (alocados na ordem de criação, como no
+// jogo), registros de 16 bytes indexados por posição (pré-ordem)
+// e o Mapa achatado em vetores. Mede o percurso completo em
+// profundidade e descidas aleatórias da raiz até uma folha.
+// -----------------------------
+typedef struct RegistroSala {   // layout de registro único, só para comparação
+    IdTexto nome;
+    IdTexto pista;
+    uint32_t esq;
+    uint32_t dir;
+} RegistroSala;
+
+// Pilha de posições/ponteiros que cresce sob demanda.
+typedef struct PilhaBench {
+    void *itens;
+    size_t cap;
+} PilhaBench;
+
+static void* garantirPilha(PilhaBench *p, size_t usados, size_t tamItem) {
+    if (usados + 2 > p->cap) {
+        p->cap = p->cap ? p->cap * 2 : 1024;
+        p->itens = realloc(p->itens, p->cap * tamItem);
+        if (!p->itens) { fprintf(stderr, "Erro: realloc benchmark\n"); exit(1); }
+    }
+    return p->itens;
+}
+
+static uint64_t percorrerPonteiros(Sala *raiz, PilhaBench *p, size_t *visitadas) {
+    uint64_t soma = 0;
+    size_t topo = 0;
+    Sala **pilha = (Sala**) garantirPilha(p, 0, sizeof(Sala*));
+    pilha[topo++] = raiz;
+    while (topo > 0) {
+        Sala *s = pilha[--topo];
+        soma += s->pista;
+        (*visitadas)++;
+        pilha = (Sala**) garantirPilha(p, topo, sizeof(Sala*));
+        if (s->dir) pilha[topo++] = s->dir;
+        if (s->esq) pilha[topo++] = s->esq;
+    }
+    return soma;
+}
+
+static uint64_t percorrerRegistros(const RegistroSala *r, uint32_t raiz, PilhaBench *p, size_t *visitadas) {
+    uint64_t soma = 0;
+    size_t topo = 0;
+    uint32_t *pilha = (uint32_t*) garantirPilha(p, 0, sizeof(uint32_t));
+    pilha[topo++] = raiz;
+    while (topo > 0) {
+        uint32_t i = pilha[--topo];
+        soma += r[i].pista;
+        (*visitadas)++;
+        pilha = (uint32_t*) garantirPilha(p, topo, sizeof(uint32_t));
+        if (r[i].dir != SALA_NENHUMA) pilha[topo++] = r[i].dir;
+        if (r[i].esq != SALA_NENHUMA) pilha[topo++] = r[i].esq;
+    }
+    return soma;
+}
+
+static uint64_t percorrerMapa(const Mapa *m, PilhaBench *p, size_t *visitadas) {
+    uint64_t soma = 0;
+    size_t topo = 0;
+    uint32_t *pilha = (uint32_t*) garantirPilha(p, 0, sizeof(uint32_t));
+    pilha[topo++] = m->raiz;
+    while (topo > 0) {
+        uint32_t i = pilha[--topo];
+        soma += m->pistas[i];
+        (*visitadas)++;
+        pilha = (uint32_t*) garantirPilha(p, topo, sizeof(uint32_t));
+        if (m->filhos[i].dir != SALA_NENHUMA) pilha[topo++] = m->filhos[i].dir;
+        if (m->filhos[i].esq != SALA_NENHUMA) pilha[topo++] = m->filhos[i].esq;
+    }
+    return soma;
+}
+
+int benchMapa(size_t n) {
+    if (n == 0 || n >= SALA_NENHUMA) { fprintf(stderr, "Erro: numero de salas invalido\n"); return 1; }
+    uint64_t rng = 0x5EED;
+    // árvore aleatória: cada sala nova ocupa uma vaga sorteada; os ids
+    // de nome e pista são sintéticos (não passam pelo pool)
+    Arena arena;
+    inicializarArena(&arena);
+    Sala **salas = (Sala**) malloc(n * sizeof(Sala*));
+    size_t *vagas = (size_t*) malloc((n + 1) * 2 * sizeof(size_t));
+    if (!salas || !vagas) { fprintf(stderr, "Erro: malloc benchmark\n"); return 1; }
+    size_t nVagas = 0;
+    for (size_t i = 0; i < n; ++i) {
+        Sala *s = (Sala*) arenaAlocar(&arena, sizeof(Sala));
+        s->nome = (IdTexto)(i + 1);
+        s->pista = (IdTexto)(proximoAleatorio(&rng) % 1000);
+        s->esq = s->dir = NULL;
+        salas[i] = s;
+        if (i > 0) {
+            size_t v = proximoAleatorio(&rng) % nVagas;
+            Sala *pai = salas[vagas[v] >> 1];
+            if (vagas[v] & 1) pai->dir = s; else pai->esq = s;
+            vagas[v] = vagas[--nVagas];
+        }
+        vagas[nVagas++] = i << 1;
+        vagas[nVagas++] = (i << 1) | 1;
+    }
+    free(vagas);
+    Sala *raiz = salas[0];
+    free(salas);
+
+    Mapa mapa;
+    compilarMapa(raiz, &mapa);
+    RegistroSala *registros = (RegistroSala*) malloc(n * sizeof(RegistroSala));
+    if (!registros) { fprintf(stderr, "Erro: malloc benchmark\n"); return 1; }
+    for (size_t i = 0; i < n; ++i)
+        registros[i] = (RegistroSala){ mapa.nomes[i], mapa.pistas[i],
+                                       mapa.filhos[i].esq, mapa.filhos[i].dir };
+
+    abrirContadorCache();
+    printf("salas=%zu  bytes/sala: ponteiros=%zu registros=%zu vetores=%zu (+%zu pista)\n",
+           n, sizeof(Sala), sizeof(RegistroSala), sizeof(FilhosSala), sizeof(IdTexto));
+    if (fdFalhasCache < 0)
+        printf("(contador de falhas de cache indisponivel: perf_event_open recusado)\n");
+    printf("%-28s %10s %12s %10s %14s\n", "kernel", "ops", "ns/op", "aloc/op", "falhas_cache/op");
+
+    PilhaBench pilha = { NULL, 0 };
+    Medicao m;
+    size_t visitadas;
+    uint64_t somas[3];
+    visitadas = 0;
+    comecarMedicao(&m);
+    somas[0] = percorrerPonteiros(raiz, &pilha, &visitadas);
+    terminarMedicao(&m, "percurso: ponteiros", visitadas);
+    visitadas = 0;
+    comecarMedicao(&m);
+    somas[1] = percorrerRegistros(registros, 0, &pilha, &visitadas);
+    terminarMedicao(&m, "percurso: registros", visitadas);
+    visitadas = 0;
+    comecarMedicao(&m);
+    somas[2] = percorrerMapa(&mapa, &pilha, &visitadas);
+    terminarMedicao(&m, "percurso: vetores", visitadas);
+    if (somas[0] != somas[1] || somas[1] != somas[2])
+        fprintf(stderr, "aviso: percursos divergem\n");
+
+    // descidas aleatórias até uma folha (só os filhos são lidos)
+    const size_t descidas = 200000;
+    size_t passos = 0;
+    uint64_t destino = 0;
+    uint64_t semente = rng;
+    comecarMedicao(&m);
+    for (size_t k = 0; k < descidas; ++k) {
+        Sala *s = raiz;
+        while (s->esq || s->dir) {
+            s = s->esq && s->dir ? ((proximoAleatorio(&rng) & 1) ? s->dir : s->esq)
+                                 : (s->esq ? s->esq : s->dir);
+            passos++;
+        }
+        destino += s->nome;
+    }
+    terminarMedicao(&m, "descida: ponteiros", passos);
+    rng = semente;
+    passos = 0;
+    uint64_t destinoRegistros = 0;
+    comecarMedicao(&m);
+    for (size_t k = 0; k < descidas; ++k) {
+        uint32_t i = 0;
+        while (registros[i].esq != SALA_NENHUMA || registros[i].dir != SALA_NENHUMA) {
+            const RegistroSala *r = &registros[i];
+            i = r->esq != SALA_NENHUMA && r->dir != SALA_NENHUMA
+                ? ((proximoAleatorio(&rng) & 1) ? r->dir : r->esq)
+                : (r->esq != SALA_NENHUMA ? r->esq : r->dir);
+            passos++;
+        }
+        destinoRegistros += registros[i].nome;
+    }
+    terminarMedicao(&m, "descida: registros", passos);
+    rng = semente;
+    passos = 0;
+    uint64_t destinoMapa = 0;
+    comecarMedicao(&m);
+    for (size_t k = 0; k < descidas; ++k) {
+        uint32_t i = mapa.raiz;
+        while (1) {
+            FilhosSala f = mapa.filhos[i];
+            if (f.esq == SALA_NENHUMA && f.dir == SALA_NENHUMA) break;
+            i = f.esq != SALA_NENHUMA && f.dir != SALA_NENHUMA
+                ? ((proximoAleatorio(&rng) & 1) ? f.dir : f.esq)
+                : (f.esq != SALA_NENHUMA ? f.esq : f.dir);
+            passos++;
+        }
+        destinoMapa += mapa.nomes[i];
+    }
+    terminarMedicao(&m, "descida: vetores", passos);
+    if (destino != destinoMapa || destino != destinoRegistros)
+        fprintf(stderr, "aviso: descidas divergem\n");
+
+    free(pilha.itens);
+    free(registros);
+    free(mapa.memoria);
+    arenaLiberar(&arena);
+    if (fdFalhasCache >= 0) close(fdFalhasCache);
+    return 0;
+}
+
+// -----------------------------
+// Benchmark do grafo de salas (modo --bench-grafo)
+// Grafo sintético com voltas e ciclos: um corredor circular (cada
+// sala com "frente" para a seguinte) e portas para salas sorteadas,
+// toda saída com a sua "voltar". Mede a montagem do CSR, o alcance
+// a partir da sala 0 nas duas estratégias e rotas entre pares
+// sorteados; as rotas são conferidas contra uma busca simples.
+// -----------------------------
+// Distância por busca em largura comum, só a partir da origem.
+static uint32_t distanciaSimples(const GrafoSalas *g, BuscaGrafo *b, uint32_t de, uint32_t para) {
+    uint32_t epoca = novaEpoca(b);
+    LadoBusca *l = &b->lado[0];
+    uint32_t ini = 0, fim = 0;
+    l->marca[de] = epoca;
+    l->distancia[de] = 0;
+    l->fila[fim++] = de;
+    while (ini < fim) {
+        uint32_t u = l->fila[ini++];
+        if (u == para) return l->distancia[u];
+        for (uint64_t e = g->inicio[u]; e < g->inicio[u + 1]; ++e) {
+            uint32_t v = g->destino[e];
+            if (l->marca[v] == epoca) continue;
+            l->marca[v] = epoca;
+            l->distancia[v] = l->distancia[u] + 1;
+            l->fila[fim++] = v;
+        }
+    }
+    return UINT32_MAX;
+}
+
+int benchGrafo(size_t n, int grau) {
+    if (n < 2 || n >= SALA_NENHUMA || grau < 2) {
+        fprintf(stderr, "Erro: esperado --bench-grafo [salas >= 2] [grau >= 2]\n");
+        return 1;
+    }
+    uint64_t rng = 0x5EED;
+    uint64_t nSaidas = (uint64_t)n * (uint64_t)(grau & ~1);
+    SaidaSala *saidas = (SaidaSala*) malloc(nSaidas * sizeof(SaidaSala));
+    if (!saidas) { fprintf(stderr, "Erro: malloc benchmark\n"); return 1; }
+    IdTexto frente = internar("frente"), voltar = internar("voltar"), porta = internar("porta");
+    uint64_t k = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t s = (uint32_t)i, prox = (uint32_t)((i + 1) % n);
+        saidas[k++] = (SaidaSala){ s, prox, frente };
+        saidas[k++] = (SaidaSala){ prox, s, voltar };
+        for (int d = 1; d < grau / 2; ++d) {
+            uint32_t r = reduzir32(proximoAleatorio(&rng), (uint32_t)n);
+            saidas[k++] = (SaidaSala){ s, r, porta };
+            saidas[k++] = (SaidaSala){ r, s, voltar };
+        }
+    }
+
+    abrirContadorCache();
+    printf("salas=%zu  saidas=%llu  bytes/saida=%zu (+%zu na transposta)\n", n,
+           (unsigned long long)nSaidas, sizeof(uint32_t) + sizeof(IdTexto), sizeof(uint32_t));
+    if (fdFalhasCache < 0)
+        printf("(contador de falhas de cache indisponivel: perf_event_open recusado)\n");
+    printf("%-28s %10s %12s %10s %14s\n", "kernel", "ops", "ns/op", "aloc/op", "falhas_cache/op");
+    Medicao m;
+    GrafoSalas g;
+    comecarMedicao(&m);
+    montarGrafo(&g, (uint32_t)n, saidas, nSaidas, NULL);
+    terminarMedicao(&m, "montarGrafo (por saida)", nSaidas);
+    free(saidas);
+
+    BuscaGrafo b;
+    iniciarBuscaGrafo(&b, &g);
+    uint32_t prof[2];
+    uint64_t alcancadas[2];
+    comecarMedicao(&m);
+    alcancadas[0] = alcanceGrafo(&g, &b, 0, 0, &prof[0]);
+    terminarMedicao(&m, "alcance: de cima (por saida)", nSaidas);
+    comecarMedicao(&m);
+    alcancadas[1] = alcanceGrafo(&g, &b, 0, 1, &prof[1]);
+    terminarMedicao(&m, "alcance: direcao (por saida)", nSaidas);
+    if (alcancadas[0] != alcancadas[1] || prof[0] != prof[1])
+        fprintf(stderr, "aviso: alcances divergem\n");
+
+    const size_t consultas = 2000, conferidas = 20;
+    uint64_t movimentos = 0;
+    uint32_t *pares = (uint32_t*) malloc(2 * consultas * sizeof(uint32_t));
+    uint32_t *tamanhos = (uint32_t*) malloc(consultas * sizeof(uint32_t));
+    if (!pares || !tamanhos) { fprintf(stderr, "Erro: malloc benchmark\n"); return 1; }
+    for (size_t i = 0; i < 2 * consultas; ++i) pares[i] = reduzir32(proximoAleatorio(&rng), (uint32_t)n);
+    comecarMedicao(&m);
+    for (size_t i = 0; i < consultas; ++i) {
+        const uint32_t *caminho;
+        tamanhos[i] = rotaMaisCurta(&g, &b, pares[2 * i], pares[2 * i + 1], &caminho);
+        movimentos += tamanhos[i] ? tamanhos[i] - 1 : 0;
+    }
+    terminarMedicao(&m, "rotaMaisCurta (bidirecional)", consultas);
+    comecarMedicao(&m);
+    for (size_t i = 0; i < conferidas; ++i) {
+        uint32_t d = distanciaSimples(&g, &b, pares[2 * i], pares[2 * i + 1]);
+        if ((d == UINT32_MAX ? 0 : d + 1) != tamanhos[i]) fprintf(stderr, "aviso: rotas divergem\n");
+    }
+    terminarMedicao(&m, "rota por busca simples", conferidas);
+    printf("alcance: %llu salas, %u niveis; rota media: %.2f movimentos\n",
+           (unsigned long long)alcancadas[1], prof[1], (double)movimentos / consultas);
+
+    free(pares);
+    free(tamanhos);
+    liberarBuscaGrafo(&b);
+    liberarGrafo(&g);
+    liberarPool();
+    if (fdFalhasCache >= 0) close(fdFalhasCache);
+    return 0;
+}
+
+// -----------------------------
+// Benchmark do quadro de evidências (modo --bench-quadro)
+// N detetives incluem as mesmas pistas (cada pista é tentada por
+// dois detetives, em ordens sorteadas) enquanto um leitor repete
+// percurso em ordem + placar dos suspeitos. Compara o quadro sem
+// trava com a AVL das sessões protegida por uma trava de leitura e
+// escrita (e o bitset de pistas já incluídas), de 1 a N detetives:
+// vazão e cauda da latência das inclusões (com a trava, quem inclui
+// espera o percurso inteiro do leitor) e pistas lidas por segundo.
+// -----------------------------
+typedef struct CorridaQuadro {
+    const IdTexto *tentativas;
+    size_t inicio, fim;
+    QuadroPistas *quadro;      // NULL: AVL com trava
+    ArvorePistas *arvore;
+    uint64_t *incluidas;       // bitset da AVL
+    pthread_rwlock_t *trava;
+    const TabelaHash *tabela;
+    DetetiveQuadro detetive;
+    _Atomic int *terminados;
+    int nDetetives;
+    double *latencias;         // detetive: segundos por inclusão, em tentativas[inicio..fim)
+    uint64_t vistas;           // leitor: pistas lidas
+} CorridaQuadro;
+
+static void* rotinaDetetive(void *arg) {
+    CorridaQuadro *c = (CorridaQuadro*) arg;
+    double antes = agoraSeg();
+    for (size_t i = c->inicio; i < c->fim; ++i) {
+        IdTexto p = c->tentativas[i];
+        if (c->quadro) {
+            incluirNoQuadro(c->quadro, &c->detetive, p);
+        } else {
+            pthread_rwlock_wrlock(c->trava);
+            if (!(c->incluidas[p / 64] >> (p % 64) & 1)) {
+                c->incluidas[p / 64] |= 1ull << (p % 64);
+                inserirPista(c->arvore, p);
+            }
+            pthread_rwlock_unlock(c->trava);
+        }
+        double agora = agoraSeg();
+        c->latencias[i] = agora - antes;
+        antes = agora;
+    }
+    atomic_fetch_add(c->terminados, 1);
+    return NULL;
+}
+
+static void* rotinaLeitorQuadro(void *arg) {
+    CorridaQuadro *c = (CorridaQuadro*) arg;
+    uint32_t *contagens = (uint32_t*) malloc(c->tabela->nSuspeitos * sizeof(uint32_t));
+    if (!contagens) { fprintf(stderr, "Erro: malloc benchmark\n"); exit(1); }
+    uint64_t somaVisitas = 0;
+    while (atomic_load(c->terminados) < c->nDetetives) {
+        if (c->quadro) {
+            c->vistas += percorrerQuadro(c->quadro, somarVisita, &somaVisitas);
+            pontuarQuadro(c->quadro, c->tabela, contagens);
+        } else {
+            pthread_rwlock_rdlock(c->trava);
+            c->vistas += percorrerPistas(c->arvore, NULL, somarVisita, &somaVisitas);
+            memset(contagens, 0, c->tabela->nSuspeitos * sizeof(uint32_t));
+            CursorPistas cursor;
+            cursorNaPosicao(&cursor, c->arvore, 0);
+            for (IdTexto p; (p = proximaPista(&cursor)) != TEXTO_NENHUM; ) {
+                const uint32_t *lista;
+                uint32_t n = suspeitosDaPista(c->tabela, p, &lista);
+                for (uint32_t j = 0; j < n; ++j) contagens[lista[j]]++;
+            }
+            pthread_rwlock_unlock(c->trava);
+        }
+    }
+    free(contagens);
+    return NULL;
+}
+
+static int conferirOrdemQuadro(IdTexto pista, void *contexto) {
+    IdTexto *anterior = (IdTexto*) contexto;
+    if (*anterior != TEXTO_NENHUM && compararPistas(*anterior, pista) >= 0)
+        fprintf(stderr, "aviso: quadro fora de ordem\n");
+    *anterior = pista;
+    return 0;
+}
+
+int benchQuadro(int argc, char *argv[]) {
+    size_t n = 200000;
+    int maxDetetives = numeroDeNucleos() > 4 ? numeroDeNucleos() : 4;
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) maxDetetives = atoi(argv[++i]);
+        else if (isdigit((unsigned char)argv[i][0])) n = (size_t)atol(argv[i]);
+        else {
+            fprintf(stderr, "Uso: --bench-quadro [pistas] [--threads N]\n");
+            return 1;
+        }
+    }
+    if (n == 0 || maxDetetives < 1) { fprintf(stderr, "Erro: parametros invalidos\n"); return 1; }
+
+    // pistas e associações internadas antes das threads (o pool não é
+    // compartilhável durante inclusões)
+    TabelaHash tabela;
+    inicializarHash(&tabela);
+    IdTexto *ids = (IdTexto*) malloc(n * sizeof(IdTexto));
+    IdTexto *tentativas = (IdTexto*) malloc(2 * n * sizeof(IdTexto));
+    if (!ids || !tentativas) { fprintf(stderr, "Erro: malloc benchmark\n"); return 1; }
+    IdTexto suspeitos[64];
+    char texto[MAX_PISTA];
+    for (int k = 0; k < 64; ++k) {
+        snprintf(texto, sizeof(texto), "Suspeito %d", k);
+        suspeitos[k] = internar(texto);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        snprintf(texto, sizeof(texto), "Pista %09zu no quadro", i);
+        ids[i] = internar(texto);
+        inserirNaHashId(&tabela, ids[i], suspeitos[i % 64]);
+    }
+    congelarHash(&tabela);
+    uint64_t rng = 0x5EED;
+    for (int r = 0; r < 2; ++r) {
+        IdTexto *t = tentativas + (size_t)r * n;
+        memcpy(t, ids, n * sizeof(IdTexto));
+        for (size_t i = n - 1; i > 0; --i) {
+            size_t j = proximoAleatorio(&rng) % (i + 1);
+            IdTexto x = t[i]; t[i] = t[j]; t[j] = x;
+        }
+    }
+    size_t palavras = (pool.quantidade + 63) / 64;
+
+    printf("pistas=%zu (cada uma tentada por dois detetives)  no do quadro=%zu+%zu/nivel bytes\n",
+           n, sizeof(NoQuadro), sizeof(_Atomic(NoQuadro*)));
+    double *latencias = (double*) malloc(2 * n * sizeof(double));
+    if (!latencias) { fprintf(stderr, "Erro: malloc benchmark\n"); return 1; }
+    printf("%-10s %-14s %12s %12s %12s %12s\n", "detetives", "estrutura", "inclusoes/s",
+           "p99.9 (us)", "max (us)", "lidas/s");
+    for (int nDet = 1; ; nDet *= 2) {
+        if (nDet > maxDetetives) nDet = maxDetetives;
+        for (int semTrava = 1; semTrava >= 0; --semTrava) {
+            QuadroPistas quadro;
+            ArvorePistas arvore;
+            pthread_rwlock_t trava;
+            uint64_t *incluidas = (uint64_t*) calloc(palavras, sizeof(uint64_t));
+            CorridaQuadro *corridas = (CorridaQuadro*) calloc((size_t)nDet + 1, sizeof(CorridaQuadro));
+            pthread_t *threads = (pthread_t*) malloc(((size_t)nDet + 1) * sizeof(pthread_t));
+            if (!incluidas || !corridas || !threads) { fprintf(stderr, "Erro: malloc benchmark\n"); return 1; }
+            _Atomic int terminados;
+            atomic_init(&terminados, 0);
+            iniciarQuadro(&quadro);
+            iniciarArvorePistas(&arvore);
+            pthread_rwlock_init(&trava, NULL);
+            for (int t = 0; t <= nDet; ++t) {
+                CorridaQuadro *c = &corridas[t];
+                c->tentativas = tentativas;
+                c->inicio = 2 * n * (size_t)t / (size_t)nDet;
+                c->fim = 2 * n * (size_t)(t + 1) / (size_t)nDet;
+                c->quadro = semTrava ? &quadro : NULL;
+                c->arvore = &arvore;
+                c->incluidas = incluidas;
+                c->trava = &trava;
+                c->tabela = &tabela;
+                c->terminados = &terminados;
+                c->nDetetives = nDet;
+                c->latencias = latencias;
+                iniciarDetetive(&c->detetive, (uint64_t)t + 1);
+            }
+            // o último é o leitor
+            pthread_create(&threads[nDet], NULL, rotinaLeitorQuadro, &corridas[nDet]);
+            double t0 = agoraSeg();
+            for (int t = 0; t < nDet; ++t) pthread_create(&threads[t], NULL, rotinaDetetive, &corridas[t]);
+            for (int t = 0; t < nDet; ++t) pthread_join(threads[t], NULL);
+            double dt = agoraSeg() - t0;
+            pthread_join(threads[nDet], NULL);
+
+            uint64_t total = semTrava ? tamanhoQuadro(&quadro) : tamanhoPistas(&arvore);
+            IdTexto anterior = TEXTO_NENHUM;
+            if (semTrava && percorrerQuadro(&quadro, conferirOrdemQuadro, &anterior) != n)
+                fprintf(stderr, "aviso: percurso do quadro incompleto\n");
+            if (total != n) fprintf(stderr, "aviso: %llu pistas em vez de %zu\n",
+                                    (unsigned long long)total, n);
+            qsort(latencias, 2 * n, sizeof(double), compararDouble);
+            printf("%-10d %-14s %12.0f %12.1f %12.1f %12.0f\n", nDet, semTrava ? "sem trava" : "AVL + rwlock",
+                   2.0 * n / dt, latencias[(size_t)(2 * n * 0.999)] * 1e6, latencias[2 * n - 1] * 1e6,
+                   corridas[nDet].vistas / dt);
+            fflush(stdout);
+
+            liberarQuadro(&quadro);
+            for (int t = 0; t <= nDet; ++t) liberarDetetive(&corridas[t].detetive);
+            liberarArvorePistas(&arvore);
+            pthread_rwlock_destroy(&trava);
+            free(incluidas);
+            free(corridas);
+            free(threads);
+        }
+        if (nDet == maxDetetives) break;
+    }
+    free(latencias);
+    free(ids);
+    free(tentativas);
+    liberarHash(&tabela);
+    liberarPool();
+    return 0;
+}
+
+// -----------------------------
+// Gerador procedural de mansões (modo --gerar)
+// Monta, a partir de uma semente, mansões de qualquer tamanho para
+// testes de escala: forma da árvore, fração das salas com pista,
+// pistas distintas, suspeitos, suspeitos por pista e faixa de
+// comprimento dos textos das pistas.
+//
+// As salas saem em pré-ordem: a sala i com subárvore de s salas tem
+// o filho esquerdo em i + 1 (subárvore de L salas) e o direito em
+// i + 1 + L. L, o nome e a pista da sala dependem só da forma, de s
+// e de um hash de (semente, i), então cada subárvore é gerada sem
+// olhar o resto: o topo da árvore é dividido em subárvores que os
+// trabalhadores repartem entre si, e o resultado é o mesmo com
+// qualquer número de threads.
+// -----------------------------
+#define NOMES_GERADOS 1024        // nomes de sala distintos (repetem-se pela mansão)
+#define SUBARVORE_MINIMA 65536    // subárvores menores não são mais divididas
+#define TAREFAS_POR_THREAD 16
+
+typedef struct SubarvoreGerada {
+    uint32_t inicio;       // posição (pré-ordem) da raiz da subárvore
+    uint32_t tamanho;      // salas na subárvore (>= 1)
+    uint32_t profundidade; // da raiz da subárvore (a entrada tem 0)
+} SubarvoreGerada;
+
+typedef struct GeracaoMansao {
+    const ConfigGerador *cfg;
+    FilhosSala *filhos;
+    IdTexto *pistas;
+    IdTexto *nomes;
+    const IdTexto *idsPistas;    // pista j -> id no pool
+    double limiarPista;          // densidade * 2^32
+    IdTexto idsNomes[NOMES_GERADOS];
+    SubarvoreGerada *tarefas;
+    uint32_t nTarefas;
+    atomic_uint proxima;         // próxima tarefa livre
+    atomic_uint profundidade;    // maior profundidade vista
+    atomic_ulong comPista;       // salas com pista
+} GeracaoMansao;
+
+// Hash do campo 'campo' da sala (ou pista) i: um passo do splitmix64
+// na posição i * 4 + campo da sequência da semente.
+static inline uint64_t hashGerado(uint64_t semente, uint64_t i, uint64_t campo) {
+    return misturar64(semente + (i * 4 + campo) * 0x9E3779B97F4A7C15ULL);
+}
+
+// Salas da subárvore esquerda de uma subárvore de 's' salas com raiz em i.
+static uint32_t tamanhoEsquerda(const ConfigGerador *cfg, uint32_t i, uint32_t s) {
+    uint32_t resto = s - 1;
+    switch (cfg->forma) {
+    case FORMA_EQUILIBRADA:
+        return (resto + 1) / 2;
+    case FORMA_TORTA: {
+        uint32_t l = (uint32_t)(resto * cfg->inclinacao + 0.5);
+        return l > resto ? resto : l;
+    }
+    default:   // forma de uma BST com chaves em ordem aleatória
+        return (uint32_t)(((hashGerado(cfg->semente, i, 0) >> 32) * ((uint64_t)resto + 1)) >> 32);
+    }
+}
+
+// Preenche a sala i (filhos, nome e pista). Retorna 1 se ela tem pista.
+static int preencherSalaGerada(GeracaoMansao *g, uint32_t i, uint32_t esq, uint32_t dir) {
+    const ConfigGerador *cfg = g->cfg;
+    g->filhos[i].esq = esq ? i + 1 : SALA_NENHUMA;
+    g->filhos[i].dir = dir ? i + 1 + esq : SALA_NENHUMA;
+    g->nomes[i] = g->idsNomes[hashGerado(cfg->semente, i, 1) % NOMES_GERADOS];
+    uint64_t h = hashGerado(cfg->semente, i, 2);
+    if ((double)(h >> 32) < g->limiarPista) {   // bits altos: sorteio; baixos: qual pista
+        g->pistas[i] = g->idsPistas[reduzir32(h, cfg->pistas)];
+        return 1;
+    }
+    g->pistas[i] = TEXTO_NENHUM;
+    return 0;
+}
+
+// Gera a subárvore inteira em profundidade, com pilha própria.
+static void gerarSubarvore(GeracaoMansao *g, SubarvoreGerada raiz,
+                           SubarvoreGerada **pilha, size_t *cap) {
+    size_t n = 0;
+    uint32_t maxProf = 0;
+    uint64_t comPista = 0;
+    (*pilha)[n++] = raiz;
+    while (n > 0) {
+        SubarvoreGerada t = (*pilha)[--n];
+        if (t.profundidade > maxProf) maxProf = t.profundidade;
+        uint32_t esq = tamanhoEsquerda(g->cfg, t.inicio, t.tamanho);
+        uint32_t dir = t.tamanho - 1 - esq;
+        comPista += (uint64_t)preencherSalaGerada(g, t.inicio, esq, dir);
+        if (n + 2 > *cap) {
+            *cap *= 2;
+            *pilha = (SubarvoreGerada*) realloc(*pilha, *cap * sizeof(SubarvoreGerada));
+            if (!*pilha) { fprintf(stderr, "Erro: realloc gerador\n"); exit(1); }
+        }
+        if (dir) (*pilha)[n++] = (SubarvoreGerada){ t.inicio + 1 + esq, dir, t.profundidade + 1 };
+        if (esq) (*pilha)[n++] = (SubarvoreGerada){ t.inicio + 1, esq, t.profundidade + 1 };
+    }
+    atomic_fetch_add(&g->comPista, comPista);
+    unsigned atual = atomic_load(&g->profundidade);
+    while (maxProf > atual && !atomic_compare_exchange_weak(&g->profundidade, &atual, maxProf)) {}
+}
+
+static void* rotinaGerador(void *arg) {
+    GeracaoMansao *g = (GeracaoMansao*) arg;
+    size_t cap = 256;
+    SubarvoreGerada *pilha = (SubarvoreGerada*) malloc(cap * sizeof(SubarvoreGerada));
+    if (!pilha) { fprintf(stderr, "Erro: malloc gerador\n"); exit(1); }
+    unsigned k;
+    while ((k = atomic_fetch_add(&g->proxima, 1)) < g->nTarefas)
+        gerarSubarvore(g, g->tarefas[k], &pilha, &cap);
+    free(pilha);
+    return NULL;
+}
+
+// Divide o topo da árvore: enquanto houver poucas tarefas, gera a
+// raiz da maior subárvore pendente e a troca pelas filhas.
+static void dividirTopo(GeracaoMansao *g) {
+    uint32_t alvo = (uint32_t)g->cfg->threads * TAREFAS_POR_THREAD;
+    uint32_t cap = alvo + 2;
+    g->tarefas = (SubarvoreGerada*) malloc(cap * sizeof(SubarvoreGerada));
+    if (!g->tarefas) { fprintf(stderr, "Erro: malloc gerador\n"); exit(1); }
+    g->tarefas[0] = (SubarvoreGerada){ 0, g->cfg->salas, 0 };
+    g->nTarefas = 1;
+    uint64_t comPista = 0;
+    // limite de divisões: numa mansão muito torta a maior subárvore
+    // quase não encolhe, e dividir mais não cria paralelismo
+    for (uint32_t divisoes = 0; g->nTarefas < alvo && divisoes < alvo * 64; ++divisoes) {
+        uint32_t maior = 0;
+        for (uint32_t k = 1; k < g->nTarefas; ++k)
+            if (g->tarefas[k].tamanho > g->tarefas[maior].tamanho) maior = k;
+        SubarvoreGerada t = g->tarefas[maior];
+        if (t.tamanho < SUBARVORE_MINIMA) break;
+        uint32_t esq = tamanhoEsquerda(g->cfg, t.inicio, t.tamanho);
+        uint32_t dir = t.tamanho - 1 - esq;
+        comPista += (uint64_t)preencherSalaGerada(g, t.inicio, esq, dir);
+        if (t.profundidade + 1 > atomic_load(&g->profundidade))
+            atomic_store(&g->profundidade, t.profundidade + 1);
+        g->tarefas[maior] = g->tarefas[--g->nTarefas];
+        if (esq) g->tarefas[g->nTarefas++] = (SubarvoreGerada){ t.inicio + 1, esq, t.profundidade + 1 };
+        if (dir) g->tarefas[g->nTarefas++] = (SubarvoreGerada){ t.inicio + 1 + esq, dir, t.profundidade + 1 };
+    }
+    atomic_store(&g->comPista, comPista);
+}
+
+// -----------------------------
+// gerarMansao()
+// Gera a mansão em memória, já no formato de abrirMansao() (o
+// resultado pode ir direto para o jogo, as análises ou
+// salvarMansao(); libera-se com fecharMansao()). Os textos vão para
+// o pool global. Retorna a profundidade da árvore e, em *comPista,
+// quantas salas ganharam pista.
+// -----------------------------
+uint32_t gerarMansao(const ConfigGerador *cfg, Mansao *mansao, uint64_t *comPista) {
+    static const char *comodos[16] = {
+        "Biblioteca", "Cozinha", "Sala de Estar", "Jardim", "Porao", "Sotao", "Escritorio",
+        "Adega", "Quarto", "Galeria", "Capela", "Estufa", "Despensa", "Salao de Baile",
+        "Lavanderia", "Corredor"
+    };
+    memset(mansao, 0, sizeof(*mansao));
+    GeracaoMansao g;
+    memset(&g, 0, sizeof g);
+    g.cfg = cfg;
+
+    // textos: nomes de sala, pistas e suspeitos, cada um com o próprio
+    // gerador (semente, posição), para não depender da ordem
+    Arena arena;
+    inicializarArena(&arena);
+    char nome[64];
+    for (uint32_t k = 0; k < NOMES_GERADOS; ++k) {
+        snprintf(nome, sizeof nome, "%s %u", comodos[k % 16], k / 16 + 1);
+        g.idsNomes[k] = internar(nome);
+    }
+    IdTexto *idsPistas = (IdTexto*) malloc((size_t)cfg->pistas * sizeof(IdTexto));
+    IdTexto *idsSuspeitos = (IdTexto*) malloc((size_t)cfg->suspeitos * sizeof(IdTexto));
+    if (!idsPistas || !idsSuspeitos) { fprintf(stderr, "Erro: malloc gerador\n"); exit(1); }
+    for (uint32_t j = 0; j < cfg->suspeitos; ++j) {
+        uint64_t rng = hashGerado(cfg->semente, j, 3) | 1;
+        idsSuspeitos[j] = internar(gerarTextoSintetico(&arena, "Suspeito", j, 1, 1, &rng));
+    }
+    TabelaHash *tabela = &mansao->tabela;
+    inicializarHash(tabela);
+    uint32_t escolhidos[SUSPEITOS_POR_LINHA];
+    uint32_t porPista = cfg->suspeitosPorPista < cfg->suspeitos ? cfg->suspeitosPorPista : cfg->suspeitos;
+    if (porPista > SUSPEITOS_POR_LINHA) porPista = SUSPEITOS_POR_LINHA;
+    for (uint32_t j = 0; j < cfg->pistas; ++j) {
+        uint64_t rng = hashGerado(cfg->semente, j, 4) | 1;
+        idsPistas[j] = internar(gerarTextoSintetico(&arena, "Pista", j, cfg->compMin, cfg->compMax, &rng));
+        uint32_t n = 1 + (uint32_t)(proximoAleatorio(&rng) % porPista);
+        for (uint32_t k = 0; k < n; ++k) {
+            uint32_t s;
+            int repetido;
+            do {   // suspeitos distintos (n <= suspeitos)
+                s = reduzir32(proximoAleatorio(&rng), cfg->suspeitos);
+                repetido = 0;
+                for (uint32_t q = 0; q < k; ++q) repetido |= escolhidos[q] == s;
+            } while (repetido);
+            escolhidos[k] = s;
+            inserirNaHashId(tabela, idsPistas[j], idsSuspeitos[s]);
+        }
+        if (j % 65536 == 65535) arenaReiniciar(&arena);   // os textos já estão no pool
+    }
+    arenaLiberar(&arena);
+    congelarHash(tabela);
+
+    // salas: topo dividido aqui, subárvores pelos trabalhadores
+    alocarMapa(&mansao->mapa, cfg->salas);
+    g.filhos = (FilhosSala*) mansao->mapa.filhos;
+    g.pistas = (IdTexto*) mansao->mapa.pistas;
+    g.nomes = (IdTexto*) mansao->mapa.nomes;
+    g.idsPistas = idsPistas;
+    g.limiarPista = cfg->densidade * 4294967296.0;
+    dividirTopo(&g);
+    int nThreads = cfg->threads < (int)g.nTarefas ? cfg->threads : (int)g.nTarefas;
+    pthread_t *threads = (pthread_t*) malloc((size_t)nThreads * sizeof(pthread_t));
+    if (!threads) { fprintf(stderr, "Erro: malloc gerador\n"); exit(1); }
+    for (int i = 1; i < nThreads; ++i) pthread_create(&threads[i], NULL, rotinaGerador, &g);
+    rotinaGerador(&g);
+    for (int i = 1; i < nThreads; ++i) pthread_join(threads[i], NULL);
+    free(threads);
+    free(g.tarefas);
+    free(idsPistas);
+    free(idsSuspeitos);
+    if (comPista) *comPista = atomic_load(&g.comPista);
+    return atomic_load(&g.profundidade);
+}
+
+// -----------------------------
+// executarGerador()
+// ./mestre --gerar [saida.dqm] [opções]
+// Sem arquivo de saída, só gera em memória e mede o tempo.
+// -----------------------------
+int executarGerador(int argc, char *argv[]) {
+    ConfigGerador cfg = { 1000000, FORMA_ALEATORIA, 0.9, 0.5, 100000, 100, 1, 16, 64, 42,
+                          numeroDeNucleos() };
+    const char *saida = NULL;
+    int invalido = 0;
+    for (int i = 0; i < argc && !invalido; ++i) {
+        const char *valor = i + 1 < argc ? argv[i + 1] : NULL;
+        if (argv[i][0] != '-' || strcmp(argv[i], "-") == 0) {
+            if (saida) invalido = 1;
+            saida = argv[i];
+            continue;
+        }
+        if (!valor) { invalido = 1; break; }
+        ++i;
+        if (strcmp(argv[i - 1], "--salas") == 0) {
+            unsigned long long n = strtoull(valor, NULL, 10);
+            invalido = n == 0 || n >= SALA_NENHUMA;
+            cfg.salas = (uint32_t)n;
+        } else if (strcmp(argv[i - 1], "--forma") == 0) {
+            if (strcmp(valor, "equilibrada") == 0) cfg.forma = FORMA_EQUILIBRADA;
+            else if (strcmp(valor, "torta") == 0) cfg.forma = FORMA_TORTA;
+            else if (strcmp(valor, "aleatoria") == 0) cfg.forma = FORMA_ALEATORIA;
+            else invalido = 1;
+        } else if (strcmp(argv[i - 1], "--inclinacao") == 0) cfg.inclinacao = atof(valor);
+        else if (strcmp(argv[i - 1], "--densidade") == 0) cfg.densidade = atof(valor);
+        else if (strcmp(argv[i - 1], "--pistas") == 0) cfg.pistas = (uint32_t)strtoul(valor, NULL, 10);
+        else if (strcmp(argv[i - 1], "--suspeitos") == 0) cfg.suspeitos = (uint32_t)strtoul(valor, NULL, 10);
+        else if (strcmp(argv[i - 1], "--suspeitos-por-pista") == 0)
+            cfg.suspeitosPorPista = (uint32_t)strtoul(valor, NULL, 10);
+        else if (strcmp(argv[i - 1], "--comprimento") == 0) {
+            if (sscanf(valor, "%d:%d", &cfg.compMin, &cfg.compMax) != 2) cfg.compMax = cfg.compMin;
+        } else if (strcmp(argv[i - 1], "--semente") == 0) cfg.semente = strtoull(valor, NULL, 10);
+        else if (strcmp(argv[i - 1], "--threads") == 0) cfg.threads = atoi(valor);
+        else invalido = 1;
+    }
+    if (invalido || cfg.inclinacao < 0.5 || cfg.inclinacao > 1.0 || cfg.densidade < 0.0 ||
+        cfg.densidade > 1.0 || cfg.pistas == 0 || cfg.suspeitos == 0 || cfg.suspeitosPorPista == 0 ||
+        cfg.suspeitosPorPista > SUSPEITOS_POR_LINHA || cfg.compMin < 1 || cfg.compMax < cfg.compMin ||
+        cfg.threads < 1) {
+        fprintf(stderr, "Uso: --gerar [saida.dqm] [--salas N] [--forma equilibrada|torta|aleatoria]\n"
+                        "       [--inclinacao F] [--densidade F] [--pistas N] [--suspeitos N]\n"
+                        "       [--suspeitos-por-pista K] [--comprimento MIN:MAX] [--semente S] [--threads N]\n");
+        return 1;
+    }
+
+    Mansao mansao;
+    uint64_t comPista;
+    double t0 = agoraSeg();
+    uint32_t profundidade = gerarMansao(&cfg, &mansao, &comPista);
+    double dtGerar = agoraSeg() - t0;
+    fprintf(stderr, "%u salas (profundidade %u, %llu com pista), %zu pistas, %u suspeitos, "
+                    "%u textos: %.2f s com %d threads\n",
+            cfg.salas, profundidade, (unsigned long long)comPista, mansao.tabela.quantidade,
+            mansao.tabela.nSuspeitos, pool.quantidade - 1, dtGerar, cfg.threads);
+    int erro = 0;
+    if (saida) {
+        t0 = agoraSeg();
+        erro = salvarMansao(saida, &mansao.mapa, &mansao.tabela);
+        if (!erro) fprintf(stderr, "gravada em %s em %.2f s\n", saida, agoraSeg() - t0);
+    }
+    fecharMansao(&mansao);
+    liberarPool();
+    return erro;
+}
+
+// -----------------------------
+// main()
+// Monta mapa fixo, monta hash de pistas->suspeitos,
+// permite exploração, exibe pistas e conduz acusação.
+// -----------------------------
+int main(int argc, char *argv[]) {
+    // Modo de benchmark: ./mestre --bench-pistas [n_avl] [n_bst]
+    if (argc > 1 && strcmp(argv[1], "--bench-pistas") == 0) {
+        int nAvl = argc > 2 ? atoi(argv[2]) : 200000;
+        int nSemBal = argc > 3 ? atoi(argv[3]) : 20000;
+        return benchPistas(nAvl, nSemBal);
+    }
+    // ./mestre --bench-arena [n_salas]
+    if (argc > 1 && strcmp(argv[1], "--bench-arena") == 0)
+        return benchArena(argc > 2 ? (size_t)atol(argv[2]) : 1000000);
+    // ./mestre --bench-hash [n_max]
+    if (argc > 1 && strcmp(argv[1], "--bench-hash") == 0)
+        return benchHash(argc > 2 ? (size_t)atol(argv[2]) : 1000000);
+
+    // ./mestre --bench-textos [n_textos]
+    if (argc > 1 && strcmp(argv[1], "--bench-textos") == 0)
+        return benchTextos(argc > 2 ? (size_t)atol(argv[2]) : 200000);
+    // ./mestre --bench-busca [n_pistas]
+    if (argc > 1 && strcmp(argv[1], "--bench-busca") == 0)
+        return benchBusca(argc > 2 ? (size_t)atol(argv[2]) : 1000000);
+    // ./mestre --bench-mapa [n_salas]
+    if (argc > 1 && strcmp(argv[1], "--bench-mapa") == 0)
+        return benchMapa(argc > 2 ? (size_t)atol(argv[2]) : 10000000);
+    // ./mestre --bench-grafo [n_salas] [grau]
+    if (argc > 1 && strcmp(argv[1], "--bench-grafo") == 0)
+        return benchGrafo(argc > 2 ? (size_t)atol(argv[2]) : 2000000, argc > 3 ? atoi(argv[3]) : 10);
+    // ./mestre --bench-quadro [n_pistas] [--threads N]
+    if (argc > 1 && strcmp(argv[1], "--bench-quadro") == 0)
+        return benchQuadro(argc - 2, argv + 2);
+    // ./mestre --bench [--salas N] [--pistas N] [--suspeitos N]
+    //                 [--comprimento MIN:MAX] [--repeticoes R] [--semente S]
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+        return executarBench(argc - 2, argv + 2);
+
+    // ./mestre --gerar [saida.dqm] [--salas N] [--forma equilibrada|torta|aleatoria]
+    //                  [--inclinacao F] [--densidade F] [--pistas N] [--suspeitos N]
+    //                  [--suspeitos-por-pista K] [--comprimento MIN:MAX] [--semente S] [--threads N]
+    if (argc > 1 && strcmp(argv[1], "--gerar") == 0)
+        return executarGerador(argc - 2, argv + 2);
+
+    // ./mestre --converter <descricao.txt|-> <saida.dqm>
+    if (argc > 3 && strcmp(argv[1], "--converter") == 0)
+        return converterMansao(argv[2], argv[3]);
+
+    // Opções antes do modo, em qualquer ordem:
+    // ./mestre --mapa <arquivo.dqm> [modo]: joga na mansão do arquivo
+    // em vez da embutida (vale para o jogo, --script, --servidor e --carga)
+    // ./mestre --verificar [modo]: confere todo o conteúdo do .dqm de
+    // --mapa antes de usar (arquivo de fonte não confiável)
+    // ./mestre --metricas <arquivo[.json]> [--metricas-intervalo S] [modo]:
+    // grava as métricas de execução a cada S segundos (10) e na saída
+    const char *metricas = NULL;
+    double intervalo = 10.0;
+    while (argc > 1) {
+        int usados = 2;
+        if (strcmp(argv[1], "--verificar") == 0) { verificarMansao = 1; usados = 1; }
+        else if (argc <= 2) break;
+        else if (strcmp(argv[1], "--mapa") == 0) arquivoMansao = argv[2];
+        else if (strcmp(argv[1], "--metricas") == 0) metricas = argv[2];
+        else if (strcmp(argv[1], "--metricas-intervalo") == 0) intervalo = atof(argv[2]);
+        else break;
+        argv[usados] = argv[0];
+        argc -= usados;
+        argv += usados;
+    }
+    if (metricas) iniciarMetricas(metricas, intervalo);
+    // ./mestre [--mapa <arquivo.dqm>] --exportar <saida.dqm>
+    if (argc > 2 && strcmp(argv[1], "--exportar") == 0) {
+        Mansao mansao;
+        abrirMansao(&mansao, arquivoMansao);
+        int erro = salvarMansao(argv[2], &mansao.mapa, &mansao.tabela);
+        fecharMansao(&mansao);
+        liberarPool();
+        return erro;
+    }
+    // ./mestre --script <arquivo|-> [--repetir N] [--quieto]
+    if (argc > 1 && strcmp(argv[1], "--script") == 0)
+        return executarScript(argc - 2, argv + 2);
+    // ./mestre --servidor [--threads N] [--diario DIR [--foto N]]
+    if (argc > 1 && strcmp(argv[1], "--servidor") == 0)
+        return executarServidor(argc - 2, argv + 2);
+    // ./mestre --rotas [--threads N] [--listar]
+    if (argc > 1 && strcmp(argv[1], "--rotas") == 0)
+        return executarRotas(argc - 2, argv + 2);
+    // ./mestre --grafo [descricao.txt] < consultas
+    if (argc > 1 && strcmp(argv[1], "--grafo") == 0)
+        return executarGrafo(argc - 2, argv + 2);
+    // ./mestre --carga [sessoes] [movimentos] [--threads N] [--diario DIR [--foto N]]
+    if (argc > 1 && strcmp(argv[1], "--carga") == 0)
+        return executarCarga(argc - 2, argv + 2);
+
+    // 1) Montar mapa (árvore binária fixa, ou a do arquivo --mapa) e
+    // 2) tabela hash com associações pista -> suspeito
+    Mansao mansao;
+    abrirMansao(&mansao, arquivoMansao);
+    const TabelaHash *tabela = &mansao.tabela;
 
-    // 4) BST de pistas coletadas (vazia inicialmente)
-    PistaNode *raizPistas = NULL;
+    // 3) Sessão do jogador: BST de pistas coletadas (vazia inicialmente)
+    Sessao sessao;
+    iniciarSessao(&sessao, &mansao.mapa, tabela);
 
     printf("=== Detective Quest: Investigação Final ===\n");
     printf("Explore a mansão e colete pistas. Ao sair, acuse um suspeito.\n");
 
-    // 5) Exploração interativa
-    explorarSalas(hall, &raizPistas, tabela);
+    // 4) Exploração interativa
+    explorarSalas(&sessao);
 
-    // 6) Exibir pistas coletadas
+    // 5) Exibir pistas coletadas
     printf("\n--- Pistas coletadas (ordem alfabética) ---\n");
-    if (!raizPistas) {
+    if (tamanhoPistas(&sessao.pistas) == 0) {
         printf("Nenhuma pista foi coletada.\n");
     } else {
-        exibirPistas(raizPistas);
+        exibirPistas(&sessao.pistas);
+        long lider = suspeitoMaisCitado(&sessao);
+        if (lider >= 0)
+            printf("Suspeito mais citado pelas pistas: %s (%u)\n",
+                   textoDe(tabela->suspeitos[lider]), sessao.placar.contagem[lider]);
     }
 
-    // 7) Fase de acusação
+    // 6) Fase de acusação
     char acusado[MAX_NOME];
     printf("\nDigite o nome do suspeito que você deseja acusar (ex: 'Sr. Verde'): ");
     // limpar buffer restante antes de fgets
@@ -320,20 +7933,20 @@ int main() {
     if (strlen(acusado) == 0) {
         printf("Nenhum acusado informado. Encerrando.\n");
     } else {
-        int cont = verificarSuspeitoFinal(raizPistas, tabela, acusado);
+        uint32_t cont = pistasContra(&sessao, buscarTexto(acusado));
         printf("\nO acusado: %s\n", acusado);
-        printf("Número de pistas coletadas que apontam para %s: %d\n", acusado, cont);
-        if (cont >= 2) {
+        printf("Número de pistas coletadas que apontam para %s: %u\n", acusado, cont);
+        if (cont >= PISTAS_PARA_CONDENAR) {
             printf("Resultado: Há evidências suficientes. Acusação aceita!\n");
         } else {
             printf("Resultado: Evidências insuficientes. Acusação rejeitada.\n");
         }
     }
 
-    // 8) Limpeza de memória
-    liberarPistas(raizPistas);
-    liberarHash(tabela);
-    liberarMapa(hall);
+    // 7) Limpeza de memória
+    encerrarSessao(&sessao);
+    fecharMansao(&mansao);
+    liberarPool();
 
     printf("\nInvestigação encerrada. Obrigado por jogar!\n");
     return 0;
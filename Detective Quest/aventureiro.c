@@ -6,6 +6,7 @@
 // Estrutura da Sala (nó da árvore binária do mapa)
 // ---------------------------------------------------------
 typedef struct sala {
+    int id;                   // Índice da sala no bitset de pistas coletadas
     char nome[50];
     char pista[80];           // Pista encontrada na sala (opcional)
     struct sala *esq;         // Caminho à esquerda
@@ -13,14 +14,27 @@ typedef struct sala {
 } Sala;
 
 // ---------------------------------------------------------
-// Estrutura do nó da BST de pistas
+// Estrutura do nó da BST de pistas (balanceada como AVL)
 // ---------------------------------------------------------
 typedef struct pistaNode {
     char pista[80];
+    int altura;               // Altura da subárvore (folha = 1)
     struct pistaNode *esq;
     struct pistaNode *dir;
 } PistaNode;
 
+// ---------------------------------------------------------
+// Bitset de pistas coletadas, um bit por id de sala.
+// Revisitar uma sala não insere a pista de novo: a BST cresce
+// só com pistas distintas, não com o número de movimentos.
+// Alocado com o mapa já montado, a partir de totalSalas.
+// ---------------------------------------------------------
+typedef struct {
+    unsigned char *bits;
+} Coletadas;
+
+static int totalSalas = 0;    // salas criadas (ids 0..totalSalas-1)
+
 // ---------------------------------------------------------
 // criarSala()
 // Cria dinamicamente uma sala com nome e pista
@@ -32,6 +46,7 @@ Sala* criarSala(const char *nome, const char *pista) {
         exit(1);
     }
 
+    nova->id = totalSalas++;
     strcpy(nova->nome, nome);
     strcpy(nova->pista, pista);
     nova->esq = NULL;
@@ -40,14 +55,67 @@ Sala* criarSala(const char *nome, const char *pista) {
     return nova;
 }
 
+// ---------------------------------------------------------
+// Funções auxiliares de balanceamento (AVL)
+// ---------------------------------------------------------
+int altura(PistaNode *n) {
+    return n ? n->altura : 0;
+}
+
+void atualizarAltura(PistaNode *n) {
+    int he = altura(n->esq), hd = altura(n->dir);
+    n->altura = 1 + (he > hd ? he : hd);
+}
+
+PistaNode* rotacionarDireita(PistaNode *y) {
+    PistaNode *x = y->esq;
+    y->esq = x->dir;
+    x->dir = y;
+    atualizarAltura(y);
+    atualizarAltura(x);
+    return x;
+}
+
+PistaNode* rotacionarEsquerda(PistaNode *x) {
+    PistaNode *y = x->dir;
+    x->dir = y->esq;
+    y->esq = x;
+    atualizarAltura(x);
+    atualizarAltura(y);
+    return y;
+}
+
+PistaNode* balancear(PistaNode *n) {
+    atualizarAltura(n);
+    int fator = altura(n->esq) - altura(n->dir);
+
+    if (fator > 1) {
+        if (altura(n->esq->esq) < altura(n->esq->dir))
+            n->esq = rotacionarEsquerda(n->esq);
+        return rotacionarDireita(n);
+    }
+    if (fator < -1) {
+        if (altura(n->dir->dir) < altura(n->dir->esq))
+            n->dir = rotacionarDireita(n->dir);
+        return rotacionarEsquerda(n);
+    }
+    return n;
+}
+
 // ---------------------------------------------------------
 // inserirPista()
-// Insere uma pista coletada na BST de pistas
+// Insere uma pista coletada na BST de pistas, rebalanceando
+// para manter altura O(log n) mesmo com pistas em ordem
 // ---------------------------------------------------------
 PistaNode* inserirPista(PistaNode *raiz, const char *pista) {
     if (raiz == NULL) {
         PistaNode *novo = (PistaNode*) malloc(sizeof(PistaNode));
+        if (novo == NULL) {
+            printf("Erro ao alocar memória.\n");
+            exit(1);
+        }
         strcpy(novo->pista, pista);
+        novo->altura = 1;
         novo->esq = NULL;
         novo->dir = NULL;
         return novo;
@@ -58,7 +126,7 @@ PistaNode* inserirPista(PistaNode *raiz, const char *pista) {
     else
         raiz->dir = inserirPista(raiz->dir, pista);
 
-    return raiz;
+    return balancear(raiz);
 }
 
 // ---------------------------------------------------------
@@ -74,20 +142,44 @@ void exibirPistas(PistaNode *raiz) {
     exibirPistas(raiz->dir);
 }
 
+// ---------------------------------------------------------
+// marcarColetada()
+// Marca a pista da sala como coletada; retorna 1 se era nova
+// ---------------------------------------------------------
+int marcarColetada(Coletadas *c, const Sala *sala) {
+    unsigned char bit = (unsigned char)(1u << (sala->id % 8));
+    if (c->bits[sala->id / 8] & bit)
+        return 0;
+    c->bits[sala->id / 8] |= bit;
+    return 1;
+}
+
 // ---------------------------------------------------------
 // explorarSalasComPistas()
 // Permite ao jogador navegar pela mansão e coleta pistas
+// (cada sala contribui com sua pista uma única vez)
 // ---------------------------------------------------------
 void explorarSalasComPistas(Sala *atual, PistaNode **arvorePistas) {
+    Coletadas coletadas;
     char opc;
 
+    coletadas.bits = (unsigned char*) calloc((size_t)(totalSalas + 7) / 8, 1);
+    if (coletadas.bits == NULL) {
+        printf("Erro ao alocar memória.\n");
+        exit(1);
+    }
+
     while (1) {
         printf("\nVocê está em: %s\n", atual->nome);
 
         // Se a sala tiver pista, coletamos
         if (strlen(atual->pista) > 0) {
-            printf("Pista encontrada: \"%s\"\n", atual->pista);
-            *arvorePistas = inserirPista(*arvorePistas, atual->pista);
+            if (marcarColetada(&coletadas, atual)) {
+                printf("Pista encontrada: \"%s\"\n", atual->pista);
+                *arvorePistas = inserirPista(*arvorePistas, atual->pista);
+            } else {
+                printf("Pista já anotada: \"%s\"\n", atual->pista);
+            }
         } else {
             printf("Nenhuma pista nesta sala.\n");
         }
@@ -99,7 +191,8 @@ void explorarSalasComPistas(Sala *atual, PistaNode **arvorePistas) {
         printf(" (s) Sair da exploração\n");
 
         printf("Escolha: ");
-        scanf(" %c", &opc);
+        if (scanf(" %c", &opc) != 1)
+            opc = 's';            // fim da entrada (ex.: movimentos via pipe)
 
         if (opc == 'e' && atual->esq) {
             atual = atual->esq;
@@ -109,6 +202,7 @@ void explorarSalasComPistas(Sala *atual, PistaNode **arvorePistas) {
         }
         else if (opc == 's') {
             printf("\nEncerrando exploração...\n");
+            free(coletadas.bits);
             return;
         }
         else {